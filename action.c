@@ -0,0 +1,1076 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "action.h"
+#include "arena.h"
+#include "mem.h"
+#include "object.h"
+#include "player.h"
+#include "room.h"
+#include "tag.h"
+#include "tell.h"
+#include "utf8.h"
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define PROP_MAX	64
+#define PROP_NAME_MAX	32
+
+static char				 props[PROP_MAX][PROP_NAME_MAX] = {
+	"name"
+};
+static int				 nprops = 1;
+
+/*
+ * Id of property 'name', allocating one if needed, or -1. Property 0
+ * is the player's name, which cannot be set.
+ */
+int
+prop_intern(const char *name)
+{
+	const char			*p;
+	int				 i;
+
+	for (i = 0; i < nprops; i++)
+		if (strcasecmp(props[i], name) == 0)
+			return i;
+
+	if (*name == '\0' || strlen(name) >= PROP_NAME_MAX ||
+	    nprops == PROP_MAX)
+		return -1;
+	for (p = name; *p != '\0'; p++)
+		if (!CT(*p, CT_ALPHA | CT_DIGIT) && *p != '_' && *p != '-')
+			return -1;
+
+	snprintf(props[nprops], sizeof(props[0]), "%s", name);
+	return nprops++;
+}
+
+const char *
+prop_name(int i)
+{
+	if (i < 0 || i >= nprops)
+		return NULL;
+
+	return props[i];
+}
+
+/*
+ * Compiler state. Failed conditions jump to a single OP_FAIL at the
+ * end, so their jumps are patched once the end is known.
+ */
+struct comp {
+	struct actinsn			 code[ACT_MAX_INSNS];
+	size_t				 ncode;
+	uint64_t			 k[ACT_MAX_CONSTS];
+	size_t				 nk;
+	const char			*str[ACT_MAX_CONSTS];
+	size_t				 nstr;
+	size_t				 poollen;
+	uint16_t			 fails[ACT_MAX_INSNS];
+	size_t				 nfails;
+	const char			*errstr;
+};
+
+static int
+emit(struct comp *c, ActOp op, int a, int b, int cc, int k)
+{
+	struct actinsn			*in;
+
+	if (c->ncode == ACT_MAX_INSNS) {
+		c->errstr = "script is too long";
+		return -1;
+	}
+	in = &c->code[c->ncode++];
+	in->op = op;
+	in->a = a;
+	in->b = b;
+	in->c = cc;
+	in->k = k;
+	in->jmp = 0;
+	return 0;
+}
+
+static int
+emit_fail_jump(struct comp *c, ActOp op, int a, int b, int cc, int k)
+{
+	if (emit(c, op, a, b, cc, k) == -1)
+		return -1;
+	c->fails[c->nfails++] = c->ncode - 1;
+	return 0;
+}
+
+static int
+konst(struct comp *c, uint64_t v)
+{
+	size_t				 i;
+
+	for (i = 0; i < c->nk; i++)
+		if (c->k[i] == v)
+			return i;
+	if (c->nk == ACT_MAX_CONSTS) {
+		c->errstr = "too many constants";
+		return -1;
+	}
+	c->k[c->nk] = v;
+	return c->nk++;
+}
+
+static int
+string(struct comp *c, const char *s)
+{
+	size_t				 i;
+
+	for (i = 0; i < c->nstr; i++)
+		if (strcmp(c->str[i], s) == 0)
+			return i;
+	if (c->nstr == ACT_MAX_CONSTS) {
+		c->errstr = "too many texts";
+		return -1;
+	}
+	c->str[c->nstr] = s;
+	c->poollen += strlen(s) + 1;
+	return c->nstr++;
+}
+
+static int
+comp_tag_cond(struct comp *c, char *spec)
+{
+	TagSet				 req, forbid;
+	int				 kr, kf;
+
+	if (tag_parse_cond(spec, &req, &forbid, &c->errstr) == -1)
+		return -1;
+	if ((kr = konst(c, req)) == -1 || (kf = konst(c, forbid)) == -1)
+		return -1;
+	if (emit(c, OP_LDTAG, 0, SCOPE_VIEW, 0, 0) == -1 ||
+	    emit(c, OP_LDK, 1, 0, 0, kr) == -1 ||
+	    emit(c, OP_LDK, 2, 0, 0, kf) == -1)
+		return -1;
+	return emit_fail_jump(c, OP_JTAG, 0, 1, 2, 0);
+}
+
+/*
+ * One comparison of "prop:", e.g. str>5 or name="foobar".
+ */
+static int
+comp_prop_cmp(struct comp *c, char *spec)
+{
+	char				*op, *val, *ep, name[PROP_NAME_MAX];
+	long long			 n;
+	size_t				 len;
+	int				 id, cmp, k;
+
+	if ((op = strpbrk(spec, "=!<>")) == NULL || op == spec) {
+		c->errstr = "property comparison expected";
+		return -1;
+	}
+	if ((size_t) (op - spec) >= sizeof(name)) {
+		c->errstr = "bad property name";
+		return -1;
+	}
+	memcpy(name, spec, op - spec);
+	name[op - spec] = '\0';
+	if ((id = prop_intern(name)) == -1) {
+		c->errstr = "bad property name";
+		return -1;
+	}
+
+	if (op[0] == '=' && op[1] == '=')
+		cmp = CMP_EQ, val = op + 2;
+	else if (op[0] == '=')
+		cmp = CMP_EQ, val = op + 1;
+	else if (op[0] == '!' && op[1] == '=')
+		cmp = CMP_NE, val = op + 2;
+	else if (op[0] == '<' && op[1] == '=')
+		cmp = CMP_LE, val = op + 2;
+	else if (op[0] == '>' && op[1] == '=')
+		cmp = CMP_GE, val = op + 2;
+	else if (op[0] == '<')
+		cmp = CMP_LT, val = op + 1;
+	else if (op[0] == '>')
+		cmp = CMP_GT, val = op + 1;
+	else {
+		c->errstr = "bad comparison";
+		return -1;
+	}
+
+	len = strlen(val);
+	if (len >= 2 && val[0] == '"' && val[len - 1] == '"') {
+		val[len - 1] = '\0';
+		val++;
+	} else if (*val != '\0') {
+		n = strtoll(val, &ep, 10);
+		if (*ep == '\0') {
+			if ((k = konst(c, (uint64_t) n)) == -1 ||
+			    emit(c, OP_LDPROP, 0, 0, 0, id) == -1 ||
+			    emit(c, OP_LDK, 1, 0, 0, k) == -1)
+				return -1;
+			return emit_fail_jump(c, OP_JCMP, 0, 1, cmp, 0);
+		}
+	}
+
+	if (cmp != CMP_EQ && cmp != CMP_NE) {
+		c->errstr = "texts can only be compared for equality";
+		return -1;
+	}
+	if ((k = string(c, val)) == -1)
+		return -1;
+	return emit_fail_jump(c, OP_JSTR, id, 0, cmp, k);
+}
+
+static int
+comp_prop_cond(struct comp *c, char *spec)
+{
+	char				*p, *next;
+
+	for (p = spec; p != NULL; p = next) {
+		if ((next = strchr(p, ',')) != NULL)
+			*next++ = '\0';
+		if (*p != '\0' && comp_prop_cmp(c, p) == -1)
+			return -1;
+	}
+	return 0;
+}
+
+static int
+comp_tag_op(struct comp *c, const char *verb, const char *scope,
+    const char *name)
+{
+	int				 sc, bit, k;
+	ActOp				 op;
+
+	if ((sc = tag_scope_parse(scope)) == -1) {
+		c->errstr = "bad tag scope";
+		return -1;
+	}
+	if ((bit = tag_intern(name)) == -1) {
+		c->errstr = "bad tag name";
+		return -1;
+	}
+	if (strcmp(verb, "set") == 0)
+		op = OP_OR;
+	else if (strcmp(verb, "unset") == 0)
+		op = OP_ANDN;
+	else
+		op = OP_XOR;
+
+	if ((k = konst(c, TAG_BIT(bit))) == -1)
+		return -1;
+	if (emit(c, OP_LDTAG, 0, sc, 0, 0) == -1 ||
+	    emit(c, OP_LDK, 1, 0, 0, k) == -1 ||
+	    emit(c, op, 0, 1, 0, 0) == -1)
+		return -1;
+	return emit(c, OP_STTAG, 0, sc, 0, 0);
+}
+
+static int
+is_op_word(const char *w)
+{
+	return strcmp(w, "set") == 0 || strcmp(w, "unset") == 0 ||
+	    strcmp(w, "toggle") == 0;
+}
+
+static int
+is_scope_word(const char *w)
+{
+	return tag_scope_parse(w) != -1 || strcmp(w, "prop") == 0;
+}
+
+/*
+ * Whether a statement starts at words[i].
+ */
+static int
+is_statement(char **words, size_t n, size_t i)
+{
+	if (i >= n)
+		return 1;
+	if (strncmp(words[i], "tag:", 4) == 0 ||
+	    strncmp(words[i], "prop:", 5) == 0)
+		return 1;
+	if (is_op_word(words[i]) && i + 1 < n && is_scope_word(words[i + 1]))
+		return 1;
+	if (strcmp(words[i], "stop") == 0)
+		return is_statement(words, n, i + 1);
+	return 0;
+}
+
+/*
+ * Splits 'src' into words. Double quotes keep spaces in a word.
+ */
+static char **
+split_words(char *src, size_t *nwords)
+{
+	char				**words, *p;
+	size_t				 n, max;
+	int				 quoted;
+
+	max = strlen(src) / 2 + 1;
+	if ((words = arena_alloc(max * sizeof(*words))) == NULL)
+		return NULL;
+
+	n = 0;
+	for (p = src; *p != '\0';) {
+		while (CT(*p, CT_SPACE))
+			p++;
+		if (*p == '\0')
+			break;
+		words[n++] = p;
+		for (quoted = 0; *p != '\0' && (quoted || !CT(*p, CT_SPACE));
+		    p++)
+			if (*p == '"')
+				quoted = !quoted;
+		if (*p != '\0')
+			*p++ = '\0';
+	}
+
+	*nwords = n;
+	return words;
+}
+
+static int
+comp_words(struct comp *c, char **words, size_t n)
+{
+	char				*msg, *w;
+	size_t				 i, j, len;
+	int				 id, k;
+
+	for (i = 0; i < n;) {
+		w = words[i];
+		if (strncmp(w, "tag:", 4) == 0) {
+			if (comp_tag_cond(c, w + 4) == -1)
+				return -1;
+			i++;
+		} else if (strncmp(w, "prop:", 5) == 0) {
+			if (comp_prop_cond(c, w + 5) == -1)
+				return -1;
+			i++;
+		} else if (is_op_word(w) && i + 1 < n &&
+		    strcmp(words[i + 1], "prop") == 0) {
+			if (i + 2 >= n || (id = prop_intern(words[i + 2])) < 1) {
+				c->errstr = "bad property name";
+				return -1;
+			}
+			if (strcmp(w, "unset") == 0) {
+				if (emit(c, OP_UNSETPROP, id, 0, 0, 0) == -1)
+					return -1;
+				i += 3;
+			} else if (strcmp(w, "set") == 0 && i + 3 < n) {
+				if ((k = string(c, words[i + 3])) == -1 ||
+				    emit(c, OP_SETPROP, id, 0, 0, k) == -1)
+					return -1;
+				i += 4;
+			} else {
+				c->errstr = "properties are set or unset";
+				return -1;
+			}
+		} else if (is_op_word(w) && i + 1 < n &&
+		    is_scope_word(words[i + 1])) {
+			if (i + 2 >= n) {
+				c->errstr = "tag name expected";
+				return -1;
+			}
+			if (comp_tag_op(c, w, words[i + 1], words[i + 2]) == -1)
+				return -1;
+			i += 3;
+		} else if (strcmp(w, "stop") == 0 &&
+		    is_statement(words, n, i + 1)) {
+			if (emit(c, OP_STOP, 0, 0, 0, 0) == -1)
+				return -1;
+			i++;
+		} else {
+			/* Text up to the next statement. */
+			for (j = i, len = 0; j < n && !is_statement(words, n, j);
+			    j++)
+				len += strlen(words[j]) + 1;
+			if ((msg = arena_alloc(len)) == NULL) {
+				c->errstr = "out of memory";
+				return -1;
+			}
+			for (len = 0; i < j; i++) {
+				if (len > 0)
+					msg[len++] = ' ';
+				memcpy(&msg[len], words[i], strlen(words[i]));
+				len += strlen(words[i]);
+			}
+			msg[len] = '\0';
+			if ((k = string(c, msg)) == -1 ||
+			    emit(c, OP_MSG, 0, 0, 0, k) == -1)
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Packs the compiled program into a single allocation.
+ */
+static struct actprog *
+link_prog(struct comp *c)
+{
+	struct actprog			*prog;
+	struct actinsn			*code;
+	uint64_t			*k;
+	uint32_t			*stroff;
+	char				*pool;
+	size_t				 bytes, i, off;
+
+	bytes = sizeof(*prog) + c->ncode * sizeof(*code) +
+	    c->nk * sizeof(*k) + c->nstr * sizeof(*stroff) + c->poollen;
+	if ((prog = malloc(bytes)) == NULL) {
+		c->errstr = "out of memory";
+		return NULL;
+	}
+	mem_inc(MEM_DESC, bytes);
+
+	code = (struct actinsn *) (prog + 1);
+	k = (uint64_t *) (code + c->ncode);
+	stroff = (uint32_t *) (k + c->nk);
+	pool = (char *) (stroff + c->nstr);
+
+	memcpy(code, c->code, c->ncode * sizeof(*code));
+	memcpy(k, c->k, c->nk * sizeof(*k));
+	for (i = 0, off = 0; i < c->nstr; i++) {
+		stroff[i] = off;
+		memcpy(&pool[off], c->str[i], strlen(c->str[i]) + 1);
+		off += strlen(c->str[i]) + 1;
+	}
+
+	prog->bytes = bytes;
+	prog->ncode = c->ncode;
+	prog->nk = c->nk;
+	prog->nstr = c->nstr;
+	prog->code = code;
+	prog->k = k;
+	prog->stroff = stroff;
+	prog->pool = pool;
+	return prog;
+}
+
+/*
+ * Compiles the script 'src'. On error returns NULL and points
+ * '*errstr' at the reason.
+ */
+struct actprog *
+action_compile(const char *src, const char **errstr)
+{
+	struct actprog			*prog;
+	struct comp			*c;
+	ArenaMark			 mark;
+	char				*s, **words;
+	size_t				 nwords, i, fail;
+
+	if (strlen(src) >= ACT_SRC_MAX) {
+		*errstr = "script is too long";
+		return NULL;
+	}
+
+	prog = NULL;
+	mark = arena_mark();
+	if ((c = arena_alloc(sizeof(*c))) == NULL ||
+	    (s = arena_strdup(src)) == NULL ||
+	    (words = split_words(s, &nwords)) == NULL) {
+		*errstr = "out of memory";
+		goto out;
+	}
+	memset(c, 0, sizeof(*c));
+
+	if (comp_words(c, words, nwords) == -1 ||
+	    emit(c, OP_END, 0, 0, 0, 0) == -1 ||
+	    emit(c, OP_FAIL, 0, 0, 0, 0) == -1) {
+		*errstr = c->errstr;
+		goto out;
+	}
+	fail = c->ncode - 1;
+	for (i = 0; i < c->nfails; i++)
+		c->code[c->fails[i]].jmp = fail;
+
+	if ((prog = link_prog(c)) == NULL)
+		*errstr = c->errstr;
+out:
+	arena_release(mark);
+	return prog;
+}
+
+static void
+prog_free(struct actprog *prog)
+{
+	if (prog == NULL)
+		return;
+	mem_dec(MEM_DESC, prog->bytes);
+	free(prog);
+}
+
+static int
+compare(int64_t a, int64_t b, ActCmp cmp)
+{
+	switch (cmp) {
+	case CMP_EQ:
+		return a == b;
+	case CMP_NE:
+		return a != b;
+	case CMP_LT:
+		return a < b;
+	case CMP_LE:
+		return a <= b;
+	case CMP_GT:
+		return a > b;
+	case CMP_GE:
+		return a >= b;
+	}
+	return 0;
+}
+
+/*
+ * Runs 'prog' for 'plr'. A program that runs out of its instruction
+ * budget is stopped as if a condition had failed.
+ */
+ActResult
+action_exec(const struct actprog *prog, struct player *plr)
+{
+	const struct actinsn		*in;
+	const char			*s;
+	uint64_t			 r[ACT_REGS];
+	TagSet				*set;
+	int64_t				 n;
+	size_t				 pc;
+	int				 budget;
+
+	memset(r, 0, sizeof(r));
+	for (pc = 0, budget = ACT_BUDGET; pc < prog->ncode; ) {
+		if (budget-- == 0) {
+			warnx("action: instruction budget exceeded");
+			return ACT_FAILED;
+		}
+		in = &prog->code[pc++];
+		switch (in->op) {
+		case OP_END:
+			return ACT_DONE;
+		case OP_FAIL:
+			return ACT_FAILED;
+		case OP_STOP:
+			return ACT_STOPPED;
+		case OP_LDTAG:
+			if (in->b == SCOPE_VIEW)
+				r[in->a] = tag_view(plr);
+			else
+				r[in->a] = (set = tag_scope(in->b, plr)) != NULL ?
+				    *set : 0;
+			break;
+		case OP_STTAG:
+			if ((set = tag_scope(in->b, plr)) == NULL)
+				break;
+			*set = r[in->a];
+			if (in->b == TAG_ROOM)
+				player_env(plr)->flags |= ROOM_DIRTY;
+			break;
+		case OP_LDK:
+			r[in->a] = prog->k[in->k];
+			break;
+		case OP_OR:
+			r[in->a] |= r[in->b];
+			break;
+		case OP_ANDN:
+			r[in->a] &= ~r[in->b];
+			break;
+		case OP_XOR:
+			r[in->a] ^= r[in->b];
+			break;
+		case OP_JTAG:
+			if (!TAG_MATCH(r[in->a], r[in->b], r[in->c]))
+				pc = in->jmp;
+			break;
+		case OP_LDPROP:
+			player_prop(plr, in->k, &n);
+			r[in->a] = n;
+			break;
+		case OP_JCMP:
+			if (!compare(r[in->a], r[in->b], in->c))
+				pc = in->jmp;
+			break;
+		case OP_JSTR:
+			if ((s = player_prop(plr, in->a, &n)) == NULL)
+				s = "";
+			if ((strcasecmp(s, &prog->pool[prog->stroff[in->k]])
+			    == 0) != (in->c == CMP_EQ))
+				pc = in->jmp;
+			break;
+		case OP_MSG:
+			tellp(plr, &prog->pool[prog->stroff[in->k]]);
+			tellp(plr, "  ");
+			break;
+		case OP_SETPROP:
+			if (player_set_prop(plr, in->a,
+			    &prog->pool[prog->stroff[in->k]]) == -1)
+				warn("player_set_prop");
+			break;
+		case OP_UNSETPROP:
+			player_unset_prop(plr, in->a);
+			break;
+		default:
+			warnx("action: bad instruction %d", in->op);
+			return ACT_FAILED;
+		}
+	}
+
+	return ACT_DONE;
+}
+
+static struct action *
+find(struct object *obj, const char *name)
+{
+	size_t				 i;
+
+	if (obj->actions == NULL)
+		return NULL;
+	for (i = 0; i < obj->actions->n; i++)
+		if (strcasecmp(obj->actions->act[i].name, name) == 0)
+			return &obj->actions->act[i];
+	return NULL;
+}
+
+const struct action *
+action_find(struct object *obj, const char *name)
+{
+	return find(obj, name);
+}
+
+static int
+valid_name(const char *name)
+{
+	const char			*p;
+
+	if (*name == '\0' || strlen(name) >= ACT_NAME_MAX)
+		return 0;
+	for (p = name; *p != '\0'; p++)
+		if (!CT(*p, CT_ALPHA | CT_DIGIT) && *p != '_' && *p != '-')
+			return 0;
+	return 1;
+}
+
+static char *
+mem_strdup(const char *s)
+{
+	char				*p;
+
+	if ((p = strdup(s)) != NULL)
+		mem_inc(MEM_DESC, MEM_STR(p));
+	return p;
+}
+
+static void
+mem_free(char *s)
+{
+	mem_dec(MEM_DESC, MEM_STR(s));
+	free(s);
+}
+
+/*
+ * Compiles 'src' as the action 'name' of 'obj', replacing any action
+ * of that name.
+ */
+int
+action_set(struct object *obj, const char *name, const char *src,
+    const char **errstr)
+{
+	struct actset			*as;
+	struct action			*a, *na;
+	struct actprog			*prog;
+	char				*s;
+	size_t				 alloc;
+
+	if (!valid_name(name)) {
+		*errstr = "bad action name";
+		return -1;
+	}
+	if ((prog = action_compile(src, errstr)) == NULL)
+		return -1;
+	if ((s = mem_strdup(src)) == NULL) {
+		*errstr = "out of memory";
+		prog_free(prog);
+		return -1;
+	}
+
+	if ((a = find(obj, name)) != NULL) {
+		prog_free(a->prog);
+		mem_free(a->src);
+		a->prog = prog;
+		a->src = s;
+		return 0;
+	}
+
+	if (obj->actions == NULL) {
+		if ((obj->actions = calloc(1, sizeof(*as))) == NULL)
+			goto fail;
+		mem_inc(MEM_DESC, sizeof(*as));
+	}
+	as = obj->actions;
+	if (as->n == as->alloc) {
+		alloc = as->alloc == 0 ? 4 : as->alloc * 2;
+		if ((na = realloc(as->act, alloc * sizeof(*na))) == NULL)
+			goto fail;
+		if (as->alloc > 0)
+			mem_dec(MEM_DESC, as->alloc * sizeof(*na));
+		mem_inc(MEM_DESC, alloc * sizeof(*na));
+		as->act = na;
+		as->alloc = alloc;
+	}
+	a = &as->act[as->n];
+	if ((a->name = mem_strdup(name)) == NULL)
+		goto fail;
+	a->src = s;
+	a->prog = prog;
+	as->n++;
+	return 0;
+fail:
+	*errstr = "out of memory";
+	mem_free(s);
+	prog_free(prog);
+	return -1;
+}
+
+int
+action_remove(struct object *obj, const char *name)
+{
+	struct actset			*as = obj->actions;
+	struct action			*a;
+
+	if ((a = find(obj, name)) == NULL)
+		return -1;
+	mem_free(a->name);
+	mem_free(a->src);
+	prog_free(a->prog);
+	memmove(a, a + 1, (as->n - (a - as->act) - 1) * sizeof(*a));
+	as->n--;
+	return 0;
+}
+
+ActResult
+action_run(struct object *obj, const char *name, struct player *plr)
+{
+	struct action			*a;
+
+	if ((a = find(obj, name)) == NULL)
+		return ACT_NONE;
+	return action_exec(a->prog, plr);
+}
+
+/*
+ * Runs the action for a verb no command took: the environment's own
+ * or that of something lying in it.
+ */
+ActResult
+action_verb(struct player *plr, const char *verb)
+{
+	struct object			*env, *obj;
+	ActResult			 res;
+
+	if ((env = ENV(plr)) == NULL)
+		return ACT_NONE;
+	if ((res = action_run(env, verb, plr)) != ACT_NONE)
+		return res;
+	for (obj = object_next_child(env, NULL); obj != NULL;
+	    obj = object_next_child(env, obj))
+		if (IS_ITEM(obj) && obj->actions != NULL &&
+		    (res = action_run(obj, verb, plr)) != ACT_NONE)
+			return res;
+
+	return ACT_NONE;
+}
+
+void
+action_free_all(struct object *obj)
+{
+	struct actset			*as = obj->actions;
+
+	if (as == NULL)
+		return;
+	while (as->n > 0)
+		action_remove(obj, as->act[0].name);
+	if (as->alloc > 0)
+		mem_dec(MEM_DESC, as->alloc * sizeof(*as->act));
+	free(as->act);
+	mem_dec(MEM_DESC, sizeof(*as));
+	free(as);
+	obj->actions = NULL;
+}
+
+size_t
+action_bytes(struct object *obj)
+{
+	struct actset			*as = obj->actions;
+	size_t				 i, bytes;
+
+	if (as == NULL)
+		return 0;
+	bytes = sizeof(*as) + as->alloc * sizeof(*as->act);
+	for (i = 0; i < as->n; i++)
+		bytes += MEM_STR(as->act[i].name) + MEM_STR(as->act[i].src) +
+		    as->act[i].prog->bytes;
+	return bytes;
+}
+
+#ifdef TEST
+#include "event.h"
+#include "evsrc.h"
+
+#include <fcntl.h>
+
+/*
+ * Runs 'src' straight from its words, the way the compiled program is
+ * meant to behave, to check action_exec() against.
+ */
+static int
+naive_prop_cmp(struct player *plr, char *spec)
+{
+	char				*op, *val, *ep, name[PROP_NAME_MAX];
+	const char			*s;
+	long long			 want;
+	int64_t				 n;
+	size_t				 len;
+	int				 eq;
+
+	op = strpbrk(spec, "=!<>");
+	memcpy(name, spec, op - spec);
+	name[op - spec] = '\0';
+	s = player_prop(plr, prop_intern(name), &n);
+	val = op + strspn(op, "=!<>");
+
+	len = strlen(val);
+	if (len >= 2 && val[0] == '"' && val[len - 1] == '"') {
+		val[len - 1] = '\0';
+		val++;
+	} else if (*val != '\0') {
+		want = strtoll(val, &ep, 10);
+		if (*ep == '\0') {
+			if (strncmp(op, "==", 2) == 0 || op[0] == '=')
+				return n == want;
+			if (strncmp(op, "!=", 2) == 0)
+				return n != want;
+			if (strncmp(op, "<=", 2) == 0)
+				return n <= want;
+			if (strncmp(op, ">=", 2) == 0)
+				return n >= want;
+			if (op[0] == '<')
+				return n < want;
+			return n > want;
+		}
+	}
+	eq = strcasecmp(s != NULL ? s : "", val) == 0;
+	return op[0] == '!' ? !eq : eq;
+}
+
+static ActResult
+interpret(const char *src, struct player *plr)
+{
+	TagSet				 req, forbid, *set;
+	ArenaMark			 mark;
+	ActResult			 res;
+	const char			*errstr;
+	char				*s, **words, *w, *p, *next, *msg;
+	size_t				 n, i, j, len;
+
+	mark = arena_mark();
+	s = arena_strdup(src);
+	words = split_words(s, &n);
+	res = ACT_DONE;
+	for (i = 0; i < n && res == ACT_DONE;) {
+		w = words[i];
+		if (strncmp(w, "tag:", 4) == 0) {
+			tag_parse_cond(w + 4, &req, &forbid, &errstr);
+			if (!TAG_MATCH(tag_view(plr), req, forbid))
+				res = ACT_FAILED;
+			i++;
+		} else if (strncmp(w, "prop:", 5) == 0) {
+			for (p = w + 5; p != NULL; p = next) {
+				if ((next = strchr(p, ',')) != NULL)
+					*next++ = '\0';
+				if (*p != '\0' && !naive_prop_cmp(plr, p))
+					res = ACT_FAILED;
+			}
+			i++;
+		} else if (is_op_word(w) && i + 1 < n &&
+		    strcmp(words[i + 1], "prop") == 0) {
+			if (strcmp(w, "unset") == 0) {
+				player_unset_prop(plr,
+				    prop_intern(words[i + 2]));
+				i += 3;
+			} else {
+				player_set_prop(plr, prop_intern(words[i + 2]),
+				    words[i + 3]);
+				i += 4;
+			}
+		} else if (is_op_word(w) && i + 1 < n &&
+		    is_scope_word(words[i + 1])) {
+			set = tag_scope(tag_scope_parse(words[i + 1]), plr);
+			if (strcmp(w, "set") == 0)
+				*set |= TAG_BIT(tag_intern(words[i + 2]));
+			else if (strcmp(w, "unset") == 0)
+				*set &= ~TAG_BIT(tag_intern(words[i + 2]));
+			else
+				*set ^= TAG_BIT(tag_intern(words[i + 2]));
+			i += 3;
+		} else if (strcmp(w, "stop") == 0 &&
+		    is_statement(words, n, i + 1)) {
+			res = ACT_STOPPED;
+		} else {
+			for (j = i, len = 0; j < n && !is_statement(words, n, j);
+			    j++)
+				len += strlen(words[j]) + 1;
+			msg = arena_alloc(len);
+			for (len = 0; i < j; i++)
+				len += sprintf(&msg[len], "%s%s",
+				    len > 0 ? " " : "", words[i]);
+			tellp(plr, msg);
+			tellp(plr, "  ");
+		}
+	}
+	arena_release(mark);
+	return res;
+}
+
+static const char		*scripts[] = {
+	"tag:night It is dark.",
+	"tag:!night,cloudy prop:hp>3 set rtag night Night falls. stop",
+	"prop:name=\"guest1\" Hello you. set prop mood happy",
+	"toggle ptag cloudy toggle gtag night prop:hp<=2 "
+	    "unset prop hp Ouch.",
+	"prop:hp!=5,hp>=1 set prop hp 9 stop tag:night",
+	"prop:mood==\"happy\" Smile. unset atag cloudy",
+	"prop:mood!=sad Not sad.",
+	"The end is stop near",
+	"set gtag cloudy tag:cloudy,night Both. stop",
+	"unset prop mood prop:mood=\"\" Empty mood.",
+	"prop:hp<3,hp>0 Hurt. tag:!cloudy stop"
+};
+static const char		*hps[] = { NULL, "1", "2", "3", "5", "x" };
+static const char		*moods[] = { NULL, "happy", "SAD" };
+#define NHPS		(sizeof(hps) / sizeof(hps[0]))
+#define NMOODS		(sizeof(moods) / sizeof(moods[0]))
+
+struct state {
+	ActResult			 res;
+	TagSet				 tags[MAX_TAG_SCOPES];
+	char				 hp[16];
+	char				 mood[16];
+	struct fmtbuf			 fb;
+};
+
+/*
+ * Sets up case 'c', runs 'f' and notes where it left everything.
+ */
+static void
+run(struct player *plr, size_t c, ActResult (*f)(const void *,
+    struct player *), const void *arg, struct state *st)
+{
+	const char			*s;
+	int64_t				 n;
+	int				 night, cloudy, hp, mood, i;
+
+	night = tag_intern("night");
+	cloudy = tag_intern("cloudy");
+	hp = prop_intern("hp");
+	mood = prop_intern("mood");
+
+	*tag_scope(TAG_ROOM, plr) = c & 1 ? TAG_BIT(night) : 0;
+	*tag_scope(TAG_PLAYER, plr) = c & 2 ? TAG_BIT(cloudy) : 0;
+	*tag_scope(TAG_GLOBAL, plr) = (c & 4 ? TAG_BIT(night) : 0) |
+	    (c & 8 ? TAG_BIT(cloudy) : 0);
+	c /= 16;
+	player_unset_prop(plr, hp);
+	if (hps[c % NHPS] != NULL)
+		player_set_prop(plr, hp, hps[c % NHPS]);
+	c /= NHPS;
+	player_unset_prop(plr, mood);
+	if (moods[c % NMOODS] != NULL)
+		player_set_prop(plr, mood, moods[c % NMOODS]);
+	memset(&plr->fmtbuf, 0, sizeof(plr->fmtbuf));
+
+	st->res = f(arg, plr);
+	for (i = 0; i < MAX_TAG_SCOPES; i++)
+		st->tags[i] = *tag_scope(i, plr);
+	snprintf(st->hp, sizeof(st->hp), "%s",
+	    (s = player_prop(plr, hp, &n)) != NULL ? s : "(none)");
+	snprintf(st->mood, sizeof(st->mood), "%s",
+	    (s = player_prop(plr, mood, &n)) != NULL ? s : "(none)");
+	st->fb = plr->fmtbuf;
+}
+
+static ActResult
+run_vm(const void *prog, struct player *plr)
+{
+	return action_exec(prog, plr);
+}
+
+static ActResult
+run_naive(const void *src, struct player *plr)
+{
+	return interpret(src, plr);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct actprog			*prog;
+	struct player			*plr;
+	struct event			*ev;
+	struct state			 got, want;
+	const char			*errstr;
+	size_t				 i, c;
+	int				 fd;
+
+	if ((ev = event_create()) == NULL)
+		err(1, "event_create");
+	player_init();
+	if ((plr = player_create()) == NULL)
+		errx(1, "player_create");
+	if ((fd = open("/dev/null", O_RDWR)) == -1)
+		err(1, "/dev/null");
+	if ((plr->evsrc = evsrc_create_fd(fd, NULL, plr)) == NULL)
+		err(1, "evsrc_create_fd");
+	plr->evsrc->ev = ev;
+
+	for (i = 0; i < sizeof(scripts) / sizeof(scripts[0]); i++) {
+		if ((prog = action_compile(scripts[i], &errstr)) == NULL)
+			errx(1, "\"%s\": %s", scripts[i], errstr);
+		for (c = 0; c < 16 * NHPS * NMOODS; c++) {
+			run(plr, c, run_vm, prog, &got);
+			run(plr, c, run_naive, scripts[i], &want);
+			if (got.res != want.res || memcmp(got.tags,
+			    want.tags, sizeof(got.tags)) != 0 ||
+			    strcmp(got.hp, want.hp) != 0 ||
+			    strcmp(got.mood, want.mood) != 0 ||
+			    strcmp(got.fb.outbuf, want.fb.outbuf) != 0)
+				errx(1, "\"%s\", case %zu: got %d %s %s "
+				    "\"%s\", want %d %s %s \"%s\"", scripts[i],
+				    c, got.res, got.hp, got.mood,
+				    got.fb.outbuf, want.res, want.hp,
+				    want.mood, want.fb.outbuf);
+		}
+		prog_free(prog);
+	}
+
+	printf("ok\n");
+	return 0;
+}
+#endif
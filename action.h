@@ -0,0 +1,153 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ACTION_H
+#define ACTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct object;
+struct player;
+
+/*
+ * Action scripts are compiled once, when they are defined or loaded,
+ * into a short program for a small register machine. Running one is
+ * a loop over fixed size instructions with the tag bits, property ids
+ * and texts it needs already resolved.
+ *
+ * A script is a sequence of words; the here-document it comes from
+ * has been joined into a single line. These are recognized:
+ *
+ *   tag:COND			stop unless the tags satisfy COND
+ *   prop:NAME OP VALUE,...	stop unless the properties compare so
+ *   set|unset|toggle SCOPE TAG	change a tag, SCOPE as in 'set'
+ *   set prop NAME VALUE	set a property of the player
+ *   unset prop NAME
+ *   stop			do not do what was being done
+ *
+ * Anything else is text told to the player.
+ */
+#define ACT_REGS	8
+#define ACT_MAX_INSNS	512
+#define ACT_MAX_CONSTS	128
+#define ACT_BUDGET	1024	/* Instructions per invocation */
+#define ACT_NAME_MAX	32
+#define ACT_SRC_MAX	8192
+
+typedef enum act_op {
+	OP_END=0,	/* finish */
+	OP_FAIL,	/* finish, a condition did not hold */
+	OP_STOP,	/* finish, prevent the default */
+	OP_LDTAG,	/* r[a] = tags of scope b */
+	OP_STTAG,	/* tags of scope b = r[a] */
+	OP_LDK,		/* r[a] = k[k] */
+	OP_OR,		/* r[a] |= r[b] */
+	OP_ANDN,	/* r[a] &= ~r[b] */
+	OP_XOR,		/* r[a] ^= r[b] */
+	OP_JTAG,	/* unless TAG_MATCH(r[a], r[b], r[c]) jump */
+	OP_LDPROP,	/* r[a] = numeric value of property k */
+	OP_JCMP,	/* unless r[a] c r[b] jump */
+	OP_JSTR,	/* unless property a c string k jump */
+	OP_MSG,		/* tell string k */
+	OP_SETPROP,	/* property a = string k */
+	OP_UNSETPROP,	/* forget property a */
+	MAX_ACT_OPS
+} ActOp;
+
+typedef enum act_cmp {
+	CMP_EQ=0, CMP_NE, CMP_LT, CMP_LE, CMP_GT, CMP_GE
+} ActCmp;
+
+#define SCOPE_VIEW	0xff	/* OP_LDTAG: everything, see tag_view() */
+
+struct actinsn {
+	uint8_t				 op;
+	uint8_t				 a;
+	uint8_t				 b;
+	uint8_t				 c;
+	uint16_t			 k;
+	uint16_t			 jmp;
+};
+
+/*
+ * A compiled program is a single allocation: the instructions, then
+ * the constants, then the offsets and bytes of the strings.
+ */
+struct actprog {
+	size_t				 bytes;
+	uint16_t			 ncode;
+	uint16_t			 nk;
+	uint16_t			 nstr;
+	const struct actinsn		*code;
+	const uint64_t			*k;
+	const uint32_t			*stroff;
+	const char			*pool;
+};
+
+struct action {
+	char				*name;
+	char				*src;
+	struct actprog			*prog;
+};
+
+struct actset {
+	struct action			*act;
+	size_t				 n;
+	size_t				 alloc;
+};
+
+typedef enum act_result {
+	ACT_NONE=0,	/* there is no such action */
+	ACT_DONE,
+	ACT_FAILED,	/* a condition did not hold */
+	ACT_STOPPED
+} ActResult;
+
+struct actprog				*action_compile(
+					    const char *,
+					    const char **);
+ActResult				 action_exec(
+					    const struct actprog *,
+					    struct player *);
+int					 action_set(
+					    struct object *,
+					    const char *,
+					    const char *,
+					    const char **);
+int					 action_remove(
+					    struct object *,
+					    const char *);
+const struct action			*action_find(
+					    struct object *,
+					    const char *);
+ActResult				 action_run(
+					    struct object *,
+					    const char *,
+					    struct player *);
+ActResult				 action_verb(
+					    struct player *,
+					    const char *);
+void					 action_free_all(
+					    struct object *);
+size_t					 action_bytes(
+					    struct object *);
+int					 prop_intern(const char *);
+const char				*prop_name(int);
+
+#endif
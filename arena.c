@@ -0,0 +1,179 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "arena.h"
+#include "mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK	16384
+#define ARENA_ALIGN	16
+
+/*
+ * The blocks are a list. Blocks after the current one are not in use
+ * and are reused when the current one fills up again.
+ */
+struct arenablk {
+	struct arenablk			*next;
+	size_t				 size;
+	size_t				 off;
+	_Alignas(ARENA_ALIGN) char	 data[];
+};
+
+static struct arenablk			*_first;
+static struct arenablk			*_cur;
+
+static struct arenablk *
+blk_new(size_t size)
+{
+	struct arenablk			*b;
+
+	if (size < ARENA_BLOCK)
+		size = ARENA_BLOCK;
+	if ((b = malloc(sizeof(*b) + size)) == NULL)
+		return NULL;
+	mem_inc(MEM_INPUT, sizeof(*b) + size);
+	b->next = NULL;
+	b->size = size;
+	b->off = 0;
+	return b;
+}
+
+static void
+blk_free_list(struct arenablk *b)
+{
+	struct arenablk			*next;
+
+	for (; b != NULL; b = next) {
+		next = b->next;
+		mem_dec(MEM_INPUT, sizeof(*b) + b->size);
+		free(b);
+	}
+}
+
+ArenaMark
+arena_mark(void)
+{
+	ArenaMark			 m;
+
+	m.blk = _cur;
+	m.off = _cur != NULL ? _cur->off : 0;
+	return m;
+}
+
+/*
+ * Gives back everything allocated since 'm' was taken.
+ */
+void
+arena_release(ArenaMark m)
+{
+	if (m.blk == NULL) {
+		if ((_cur = _first) != NULL)
+			_cur->off = 0;
+		return;
+	}
+
+	_cur = m.blk;
+	_cur->off = m.off;
+}
+
+void *
+arena_alloc(size_t sz)
+{
+	struct arenablk			*b;
+	void				*p;
+
+	sz = (sz + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+	if (_cur == NULL || _cur->size - _cur->off < sz) {
+		if (_cur != NULL && _cur->next != NULL &&
+		    _cur->next->size >= sz) {
+			b = _cur->next;
+		} else {
+			if ((b = blk_new(sz)) == NULL)
+				return NULL;
+			if (_cur == NULL)
+				_first = b;
+			else {
+				/* Spares too small for this are let go. */
+				blk_free_list(_cur->next);
+				_cur->next = b;
+			}
+		}
+		b->off = 0;
+		_cur = b;
+	}
+
+	p = &_cur->data[_cur->off];
+	_cur->off += sz;
+	return p;
+}
+
+char *
+arena_strdup(const char *s)
+{
+	char				*p;
+	size_t				 len;
+
+	len = strlen(s) + 1;
+	if ((p = arena_alloc(len)) != NULL)
+		memcpy(p, s, len);
+	return p;
+}
+
+/*
+ * Formats into the arena, in place if it fits what is left of the
+ * current block.
+ */
+char *
+arena_vprintf(const char *fmt, va_list ap)
+{
+	va_list				 aq;
+	char				*p;
+	size_t				 left;
+	int				 n;
+
+	left = _cur != NULL ? _cur->size - _cur->off : 0;
+	va_copy(aq, ap);
+	n = vsnprintf(left > 0 ? &_cur->data[_cur->off] : NULL, left, fmt,
+	    aq);
+	va_end(aq);
+	if (n < 0)
+		return NULL;
+
+	if ((size_t) n < left)
+		return arena_alloc(n + 1);
+
+	if ((p = arena_alloc(n + 1)) == NULL)
+		return NULL;
+	vsnprintf(p, n + 1, fmt, ap);
+	return p;
+}
+
+char *
+arena_printf(const char *fmt, ...)
+{
+	va_list				 ap;
+	char				*p;
+
+	va_start(ap, fmt);
+	p = arena_vprintf(fmt, ap);
+	va_end(ap);
+	return p;
+}
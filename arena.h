@@ -0,0 +1,53 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+/*
+ * Scratch memory for the duration of a command. Allocations are bumps
+ * of a pointer in a block that is kept between commands, and they are
+ * all given back at once by returning to a mark taken earlier, so
+ * temporaries need no free() and nested commands, e.g. from aliases,
+ * can use the arena too.
+ */
+struct arenablk;
+
+typedef struct arena_mark {
+	struct arenablk			*blk;
+	size_t				 off;
+} ArenaMark;
+
+ArenaMark				 arena_mark(void);
+void					 arena_release(
+					    ArenaMark);
+void					*arena_alloc(
+					    size_t);
+char					*arena_strdup(
+					    const char *);
+char					*arena_printf(
+					    const char *,
+					    ...);
+char					*arena_vprintf(
+					    const char *,
+					    va_list);
+
+#endif
@@ -16,7 +16,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
-#include <ctype.h>
+#include "utf8.h"
+
 #include <string.h>
 
 /*
@@ -35,7 +36,7 @@ parse_args(char *p, char **argv, size_t limit)
 
 	argc = 0;
 	while (p != NULL && (argc+1) < limit && *p != '\0') {
-		while (isspace(*p))
+		while (CT(*p, CT_SPACE))
 			p++;
 		q = strchr(p, ' ');
 		if (q != NULL)
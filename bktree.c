@@ -0,0 +1,327 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "bktree.h"
+#include "match.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BK_CHUNK	64
+
+static int
+node_new(struct bktree *t, const char *word, size_t len, uint32_t mask,
+    int key)
+{
+	struct bknode			*p;
+	size_t				 alloc;
+
+	if (t->nnodes == UINT32_MAX)
+		return -1;
+	if (t->nnodes == t->alloc) {
+		alloc = t->alloc + BK_CHUNK;
+		if ((p = realloc(t->nodes, alloc * sizeof(*p))) == NULL)
+			return -1;
+		if (t->alloc > 0)
+			mem_dec(t->mt, t->alloc * sizeof(*p));
+		mem_inc(t->mt, alloc * sizeof(*p));
+		t->nodes = p;
+		t->alloc = alloc;
+	}
+
+	p = &t->nodes[t->nnodes];
+	memset(p, 0, sizeof(*p));
+	p->word = word;
+	p->len = len;
+	p->mask = mask;
+	p->key = key > UINT16_MAX ? UINT16_MAX : key;
+	t->nnodes++;
+	return 0;
+}
+
+/*
+ * Adds 'word'. A word already in the tree, compared without case,
+ * just gets 'mask' added to its own.
+ */
+int
+bktree_add(struct bktree *t, const char *word, uint32_t mask)
+{
+	struct matchpat			 pat;
+	struct bknode			*nd;
+	size_t				 len;
+	uint32_t			 n, k;
+	int				 d;
+
+	len = strlen(word);
+	if (t->nnodes == 0)
+		return node_new(t, word, len, mask, 0);
+
+	match_prepare(&pat, word, len);
+	for (n = 0;;) {
+		nd = &t->nodes[n];
+		d = match_distance(&pat, nd->word, nd->len, INT_MAX - 1);
+		if (d == 0) {
+			nd->mask |= mask;
+			return 0;
+		}
+		for (k = nd->kid; k != 0 && t->nodes[k].key != d;
+		    k = t->nodes[k].sib)
+			;
+		if (k == 0)
+			break;
+		n = k;
+	}
+
+	if (node_new(t, word, len, mask, d) == -1)
+		return -1;
+	k = t->nnodes - 1;
+	nd = &t->nodes[n];
+	t->nodes[k].sib = nd->kid;
+	nd->kid = k;
+	if (t->nodes[k].key > nd->maxkey)
+		nd->maxkey = t->nodes[k].key;
+	return 0;
+}
+
+/*
+ * Inserts a hit into 'hits', kept in order of distance and then
+ * alphabetically, unless the 'k' found so far are all better.
+ */
+static size_t
+add_hit(struct bkhit *hits, size_t nhits, size_t k, const char *word,
+    int d)
+{
+	size_t				 i;
+
+	for (i = nhits; i > 0; i--)
+		if (hits[i - 1].dist < d || (hits[i - 1].dist == d &&
+		    strcmp(hits[i - 1].word, word) <= 0))
+			break;
+	if (i == k)
+		return nhits;
+
+	if (nhits == k)
+		nhits--;
+	memmove(&hits[i + 1], &hits[i], (nhits - i) * sizeof(*hits));
+	hits[i].word = word;
+	hits[i].dist = d;
+	return nhits + 1;
+}
+
+/*
+ * Finds at most 'k' words within 'maxd' edits of 'word', the closest
+ * first. Once 'k' words are found the search radius shrinks to the
+ * worst of them. Returns the number of words put in 'hits'.
+ */
+size_t
+bktree_search(const struct bktree *t, const char *word, int maxd,
+    uint32_t mask, struct bkhit *hits, size_t k)
+{
+	struct matchpat			 pat;
+	const struct bknode		*nd;
+	uint32_t			*stack, n, c;
+	size_t				 sp, nhits;
+	int				 d, r, bound;
+
+	if (t->nnodes == 0 || k == 0 || maxd < 0)
+		return 0;
+	if ((stack = malloc(t->nnodes * sizeof(*stack))) == NULL)
+		return 0;
+
+	match_prepare(&pat, word, strlen(word));
+	nhits = 0;
+	r = maxd;
+	sp = 0;
+	stack[sp++] = 0;
+	while (sp > 0) {
+		nd = &t->nodes[stack[--sp]];
+		bound = r > INT_MAX - 1 - nd->maxkey ?
+		    INT_MAX - 1 : r + nd->maxkey;
+		if ((d = match_distance(&pat, nd->word, nd->len, bound)) >
+		    bound)
+			continue;
+
+		if (d <= r && (nd->mask & mask) != 0) {
+			nhits = add_hit(hits, nhits, k, nd->word, d);
+			if (nhits == k)
+				r = hits[k - 1].dist;
+		}
+
+		for (c = nd->kid; c != 0; c = t->nodes[c].sib) {
+			n = t->nodes[c].key;
+			if ((int) n >= d - r && (int) n <= d + r)
+				stack[sp++] = c;
+		}
+	}
+
+	free(stack);
+	return nhits;
+}
+
+void
+bktree_clear(struct bktree *t)
+{
+	if (t->alloc > 0)
+		mem_dec(t->mt, t->alloc * sizeof(*t->nodes));
+	free(t->nodes);
+	t->nodes = NULL;
+	t->nnodes = 0;
+	t->alloc = 0;
+}
+
+#ifdef TEST
+#include <ctype.h>
+#include <err.h>
+#include <stdio.h>
+
+#define NWORDS		2000
+#define NQUERIES	2000
+
+static char			 words[NWORDS][12];
+
+/*
+ * The whole dynamic programming matrix, to check the others against.
+ */
+static int
+naive_distance(const char *a, const char *b)
+{
+	size_t				 la, lb, i, j;
+	int				*m, d, x;
+
+	la = strlen(a);
+	lb = strlen(b);
+	if ((m = malloc((la + 1) * (lb + 1) * sizeof(*m))) == NULL)
+		err(1, "malloc");
+#define M(_i, _j)	m[(_i) * (lb + 1) + (_j)]
+	for (i = 0; i <= la; i++)
+		M(i, 0) = i;
+	for (j = 0; j <= lb; j++)
+		M(0, j) = j;
+	for (i = 1; i <= la; i++)
+		for (j = 1; j <= lb; j++) {
+			d = M(i - 1, j - 1) +
+			    (tolower((unsigned char) a[i - 1]) !=
+			    tolower((unsigned char) b[j - 1]));
+			if ((x = M(i - 1, j) + 1) < d)
+				d = x;
+			if ((x = M(i, j - 1) + 1) < d)
+				d = x;
+			M(i, j) = d;
+		}
+	d = M(la, lb);
+#undef M
+	free(m);
+	return d;
+}
+
+static void
+random_word(char *buf, size_t max, const char *alpha)
+{
+	size_t				 i, len;
+
+	len = rand() % max;
+	for (i = 0; i < len; i++)
+		buf[i] = alpha[rand() % strlen(alpha)];
+	buf[len] = '\0';
+}
+
+static int
+compare_hits(const void *a, const void *b)
+{
+	const struct bkhit		*x = a, *y = b;
+
+	if (x->dist != y->dist)
+		return x->dist - y->dist;
+	return strcmp(x->word, y->word);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct bktree			 t;
+	struct matchpat			 pat;
+	struct bkhit			 hits[8], *want;
+	char				 a[100], b[100];
+	uint32_t			 masks[NWORDS], mask;
+	size_t				 i, j, n, nwant, k;
+	int				 d, bound, maxd;
+
+	srand(1);
+
+	/* match_distance(), bit-parallel and for long patterns */
+	for (i = 0; i < 20000; i++) {
+		random_word(a, i % 2 ? 12 : 90, "abcAB");
+		random_word(b, i % 2 ? 12 : 90, "abcAB");
+		d = naive_distance(a, b);
+		bound = rand() % 12;
+		match_prepare(&pat, a, strlen(a));
+		if (match_distance(&pat, b, strlen(b), INT_MAX - 1) != d ||
+		    match_distance(&pat, b, strlen(b), bound) !=
+		    (d > bound ? bound + 1 : d))
+			errx(1, "distance \"%s\" \"%s\": want %d", a, b, d);
+	}
+
+	/* bktree_search() against a scan of every word */
+	memset(&t, 0, sizeof(t));
+	t.mt = MEM_INDEX;
+	for (n = 0; n < NWORDS; n++) {
+		do {
+			random_word(words[n], sizeof(words[n]), "abcde");
+			for (j = 0; j < n; j++)
+				if (strcmp(words[j], words[n]) == 0)
+					break;
+		} while (words[n][0] == '\0' || j < n);
+		masks[n] = 1 << (rand() % 3);
+		if (bktree_add(&t, words[n], masks[n]) == -1)
+			errx(1, "bktree_add");
+	}
+	if ((want = calloc(NWORDS, sizeof(*want))) == NULL)
+		err(1, "calloc");
+	for (i = 0; i < NQUERIES; i++) {
+		random_word(a, sizeof(words[0]), "abcdeAB");
+		maxd = rand() % 4;
+		mask = 1 + rand() % 7;
+		k = 1 + rand() % 8;
+		for (nwant = 0, j = 0; j < NWORDS; j++)
+			if ((masks[j] & mask) != 0 &&
+			    (d = naive_distance(a, words[j])) <= maxd) {
+				want[nwant].word = words[j];
+				want[nwant++].dist = d;
+			}
+		qsort(want, nwant, sizeof(*want), compare_hits);
+		if (nwant > k)
+			nwant = k;
+		n = bktree_search(&t, a, maxd, mask, hits, k);
+		if (n != nwant)
+			errx(1, "search \"%s\": %zu hits, want %zu", a, n,
+			    nwant);
+		for (j = 0; j < n; j++)
+			if (strcmp(hits[j].word, want[j].word) != 0 ||
+			    hits[j].dist != want[j].dist)
+				errx(1, "search \"%s\": hit %zu is %s/%d, "
+				    "want %s/%d", a, j, hits[j].word,
+				    hits[j].dist, want[j].word, want[j].dist);
+	}
+	free(want);
+	bktree_clear(&t);
+
+	printf("ok\n");
+	return 0;
+}
+#endif
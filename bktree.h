@@ -0,0 +1,74 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BKTREE_H
+#define BKTREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mem.h"
+
+/*
+ * A BK-tree over a vocabulary, for finding the words closest to a
+ * misspelt one by edit distance. Children are keyed by their distance
+ * to the parent, so by the triangle inequality a search within 'd' of
+ * the query only descends into children whose key is within 'd' of
+ * the parent's distance, and most of the tree is never compared.
+ *
+ * The words are not copied and must stay put while they are in the
+ * tree. Each word has a mask, and a search only considers words whose
+ * mask shares a bit with the one searched with.
+ */
+struct bknode {
+	const char			*word;
+	uint32_t			 len;
+	uint32_t			 mask;
+	uint32_t			 kid;		/* First child, or 0 */
+	uint32_t			 sib;		/* Next sibling, or 0 */
+	uint16_t			 key;		/* Distance to parent */
+	uint16_t			 maxkey;	/* Largest child key */
+};
+
+struct bktree {
+	struct bknode			*nodes;
+	size_t				 nnodes;
+	size_t				 alloc;
+	MemType				 mt;
+};
+
+struct bkhit {
+	const char			*word;
+	int				 dist;
+};
+
+int					 bktree_add(
+					    struct bktree *,
+					    const char *,
+					    uint32_t);
+size_t					 bktree_search(
+					    const struct bktree *,
+					    const char *,
+					    int,
+					    uint32_t,
+					    struct bkhit *,
+					    size_t);
+void					 bktree_clear(
+					    struct bktree *);
+
+#endif
@@ -0,0 +1,209 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "channel.h"
+#include "player.h"
+#include "tell.h"
+#include "mem.h"
+#include "arena.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define CHANNEL_HASH_SZ		256
+#define MEMBER_CHUNK		8
+
+static struct channel			*_chans[CHANNEL_HASH_SZ];
+
+static void				 channel_free(struct channel *);
+
+static size_t
+chan_hash(const char *name)
+{
+	size_t				 k;
+
+	for (k = 0; *name != '\0'; name++)
+		k = tolower((unsigned char) *name) + (k << 6) + (k << 16) - k;
+
+	return k % CHANNEL_HASH_SZ;
+}
+
+struct channel *
+channel_find(const char *name)
+{
+	struct channel			*ch;
+
+	for (ch = _chans[chan_hash(name)]; ch != NULL; ch = ch->next_hash)
+		if (strcasecmp(ch->name, name) == 0)
+			return ch;
+
+	return NULL;
+}
+
+int
+channel_is_member(struct channel *ch, struct player *plr)
+{
+	size_t				 i;
+
+	for (i = 0; i < plr->nchans; i++)
+		if (plr->chans[i] == ch)
+			return 1;
+
+	return 0;
+}
+
+static int
+grow(void *pp, size_t *alloc, size_t n, size_t sz)
+{
+	void				*p;
+
+	if (n < *alloc)
+		return 0;
+	if ((p = realloc(*(void **) pp, (*alloc + MEMBER_CHUNK) * sz)) == NULL)
+		return -1;
+	if (*alloc > 0)
+		mem_dec(MEM_INDEX, *alloc * sz);
+	mem_inc(MEM_INDEX, (*alloc + MEMBER_CHUNK) * sz);
+	*(void **) pp = p;
+	*alloc += MEMBER_CHUNK;
+	return 0;
+}
+
+/*
+ * Subscribes 'plr' to channel 'name', creating the channel if needed.
+ */
+int
+channel_join(struct player *plr, const char *name)
+{
+	struct channel			*ch, **chans;
+	const char			*p;
+	size_t				 k;
+
+	if (*name == '\0' || strlen(name) >= CHANNEL_NAME_MAX)
+		return -1;
+	for (p = name; *p != '\0'; p++)
+		if (!isalnum((unsigned char) *p) && *p != '_' && *p != '-')
+			return -1;
+
+	if ((ch = channel_find(name)) == NULL) {
+		if ((ch = calloc(1, sizeof(*ch))) == NULL)
+			return -1;
+		mem_inc(MEM_INDEX, sizeof(*ch));
+		snprintf(ch->name, sizeof(ch->name), "%s", name);
+		k = chan_hash(name);
+		ch->next_hash = _chans[k];
+		_chans[k] = ch;
+	} else if (channel_is_member(ch, plr))
+		return 0;
+
+	if (grow(&ch->members, &ch->alloc, ch->n, sizeof(*ch->members)) == -1)
+		goto fail;
+	chans = realloc(plr->chans, (plr->nchans + 1) * sizeof(*chans));
+	if (chans == NULL)
+		goto fail;
+	plr->chans = chans;
+	ch->members[ch->n++] = plr;
+	plr->chans[plr->nchans++] = ch;
+	return 0;
+fail:
+	/* A channel just created would be left without members */
+	if (ch->n == 0)
+		channel_free(ch);
+	return -1;
+}
+
+static void
+channel_free(struct channel *ch)
+{
+	struct channel			**cp;
+
+	for (cp = &_chans[chan_hash(ch->name)]; *cp != NULL;
+	    cp = &(*cp)->next_hash)
+		if (*cp == ch) {
+			*cp = ch->next_hash;
+			break;
+		}
+	if (ch->alloc > 0)
+		mem_dec(MEM_INDEX, ch->alloc * sizeof(*ch->members));
+	mem_dec(MEM_INDEX, sizeof(*ch));
+	free(ch->members);
+	free(ch);
+}
+
+static void
+remove_member(struct channel *ch, struct player *plr)
+{
+	size_t				 i;
+
+	for (i = 0; i < ch->n; i++)
+		if (ch->members[i] == plr) {
+			ch->members[i] = ch->members[--ch->n];
+			break;
+		}
+	if (ch->n == 0)
+		channel_free(ch);
+}
+
+int
+channel_leave(struct player *plr, const char *name)
+{
+	struct channel			*ch;
+	size_t				 i;
+
+	if ((ch = channel_find(name)) == NULL)
+		return -1;
+
+	for (i = 0; i < plr->nchans; i++)
+		if (plr->chans[i] == ch) {
+			plr->chans[i] = plr->chans[--plr->nchans];
+			remove_member(ch, plr);
+			return 0;
+		}
+
+	return -1;
+}
+
+void
+channel_leave_all(struct player *plr)
+{
+	while (plr->nchans > 0)
+		remove_member(plr->chans[--plr->nchans], plr);
+
+	free(plr->chans);
+	plr->chans = NULL;
+}
+
+/*
+ * Every subscriber, the speaker included, gets the same rendered
+ * message.
+ */
+void
+channel_send(struct channel *ch, struct player *plr, const char *text)
+{
+	ArenaMark			 mark;
+	char				*buf;
+
+	mark = arena_mark();
+	if ((buf = arena_printf("[%s] %s: %s", ch->name, player_name(plr),
+	    text)) != NULL)
+		tellpm(ch->members, ch->n, buf);
+	arena_release(mark);
+}
@@ -0,0 +1,60 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <stddef.h>
+
+struct player;
+
+#define CHANNEL_NAME_MAX	24
+
+/*
+ * Chat channels. A channel exists as long as it has subscribers and
+ * is found by name through a hash; each player keeps the list of
+ * channels it is on, so leaving everything on disconnect does not
+ * search.
+ */
+struct channel {
+	char				 name[CHANNEL_NAME_MAX];
+	struct player			**members;
+	size_t				 n;
+	size_t				 alloc;
+	struct channel			*next_hash;
+};
+
+struct channel				*channel_find(
+					    const char *);
+int					 channel_join(
+					    struct player *,
+					    const char *);
+int					 channel_leave(
+					    struct player *,
+					    const char *);
+void					 channel_leave_all(
+					    struct player *);
+int					 channel_is_member(
+					    struct channel *,
+					    struct player *);
+void					 channel_send(
+					    struct channel *,
+					    struct player *,
+					    const char *);
+
+#endif
@@ -0,0 +1,330 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "cmdtrie.h"
+#include "utf8.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TRIE_CHUNK	32
+
+static char *
+str_dup(MemType mt, const char *s)
+{
+	char				*p;
+
+	if (s == NULL)
+		return NULL;
+	if ((p = strdup(s)) != NULL)
+		mem_inc(mt, MEM_STR(p));
+	return p;
+}
+
+static void
+str_free(MemType mt, char *s)
+{
+	if (s == NULL)
+		return;
+	mem_dec(mt, MEM_STR(s));
+	free(s);
+}
+
+static int
+grow(struct cmdtrie *t, void *pp, size_t *alloc, size_t n, size_t sz)
+{
+	void				*p;
+
+	if (n < *alloc)
+		return 0;
+	if ((p = realloc(*(void **) pp, (*alloc + TRIE_CHUNK) * sz)) == NULL)
+		return -1;
+	if (*alloc > 0)
+		mem_dec(t->mt, *alloc * sz);
+	mem_inc(t->mt, (*alloc + TRIE_CHUNK) * sz);
+	*(void **) pp = p;
+	*alloc += TRIE_CHUNK;
+	return 0;
+}
+
+static size_t
+node_new(struct cmdtrie *t, char c)
+{
+	struct cmdnode			*nd;
+
+	if (t->nnodes == UINT16_MAX ||
+	    grow(t, &t->nodes, &t->alloc, t->nnodes, sizeof(*nd)) == -1)
+		return 0;
+	nd = &t->nodes[t->nnodes];
+	memset(nd, 0, sizeof(*nd));
+	nd->c = c;
+	nd->ent = -1;
+	return t->nnodes++;
+}
+
+/*
+ * The child of 'n' for 'c', or 0 if there is none.
+ */
+static size_t
+lookup(const struct cmdtrie *t, size_t n, char c)
+{
+	size_t				 k;
+
+	for (k = t->nodes[n].kid; k != 0 && t->nodes[k].c < c;
+	    k = t->nodes[k].sib)
+		;
+	return k != 0 && t->nodes[k].c == c ? k : 0;
+}
+
+/*
+ * Like lookup(), creating the child in order if it is missing.
+ */
+static size_t
+child(struct cmdtrie *t, size_t n, char c)
+{
+	size_t				 k, prev, nk;
+
+	for (prev = 0, k = t->nodes[n].kid; k != 0 && t->nodes[k].c < c;
+	    prev = k, k = t->nodes[k].sib)
+		;
+	if (k != 0 && t->nodes[k].c == c)
+		return k;
+	if ((nk = node_new(t, c)) == 0)
+		return 0;
+
+	t->nodes[nk].sib = k;
+	if (prev == 0)
+		t->nodes[n].kid = nk;
+	else
+		t->nodes[prev].sib = nk;
+	return nk;
+}
+
+/*
+ * Counts what is available below 'n' in each environment.
+ */
+static void
+recount(struct cmdtrie *t, size_t n)
+{
+	struct cmdnode			*nd, *kd;
+	struct cmdent			*e;
+	size_t				 k;
+	int				 env;
+
+	nd = &t->nodes[n];
+	for (env = 0; env < MAX_OBJ_TYPE; env++) {
+		nd->count[env] = 0;
+		nd->only[env] = -1;
+	}
+
+	if (nd->ent >= 0 && !(e = &t->ents[nd->ent])->exact)
+		for (env = 0; env < MAX_OBJ_TYPE; env++)
+			if (e->envmask & (1 << env)) {
+				nd->count[env] = 1;
+				nd->only[env] = nd->ent;
+			}
+
+	for (k = nd->kid; k != 0; k = t->nodes[k].sib) {
+		recount(t, k);
+		nd = &t->nodes[n];
+		kd = &t->nodes[k];
+		for (env = 0; env < MAX_OBJ_TYPE; env++) {
+			if (kd->count[env] == 0)
+				continue;
+			if (nd->count[env] == 0)
+				nd->only[env] = kd->only[env];
+			nd->count[env] += kd->count[env];
+		}
+	}
+}
+
+static size_t
+find(const struct cmdtrie *t, const char *word)
+{
+	size_t				 n;
+
+	if (t->nnodes == 0)
+		return 0;
+	for (n = 0; *word != '\0'; word++)
+		if ((n = lookup(t, n, CT_TOLOWER(*word))) == 0)
+			return 0;
+
+	return n;
+}
+
+/*
+ * Adds or replaces 'word', either a verb with index 'cmd' or, if
+ * 'expand' is set, an alias for that command line. 'envmask' has bit
+ * (1 << type) set for every environment type it is available in.
+ */
+int
+cmdtrie_add(struct cmdtrie *t, const char *word, const char *expand,
+    int cmd, unsigned envmask, int exact)
+{
+	struct cmdent			*e;
+	size_t				 n, i;
+
+	if (*word == '\0')
+		return -1;
+	if (t->nnodes == 0) {
+		/* The root; node_new() can't tell it from a failure */
+		if (grow(t, &t->nodes, &t->alloc, 0, sizeof(*t->nodes)) == -1)
+			return -1;
+		memset(&t->nodes[0], 0, sizeof(t->nodes[0]));
+		t->nodes[0].ent = -1;
+		t->nnodes = 1;
+	}
+
+	n = 0;
+	for (i = 0; word[i] != '\0'; i++)
+		if ((n = child(t, n, CT_TOLOWER(word[i]))) == 0)
+			return -1;
+
+	if (t->nodes[n].ent >= 0) {
+		e = &t->ents[t->nodes[n].ent];
+		str_free(t->mt, e->word);
+		str_free(t->mt, e->expand);
+	} else {
+		for (i = 0; i < t->nents && t->ents[i].word != NULL; i++)
+			;
+		if (i == t->nents) {
+			if (t->nents == INT16_MAX || grow(t, &t->ents,
+			    &t->aents, t->nents, sizeof(*e)) == -1)
+				return -1;
+			t->nents++;
+		}
+		t->nodes[n].ent = i;
+		e = &t->ents[i];
+	}
+
+	e->word = str_dup(t->mt, word);
+	e->expand = str_dup(t->mt, expand);
+	e->cmd = cmd;
+	e->envmask = envmask;
+	e->exact = exact;
+	recount(t, 0);
+	return 0;
+}
+
+int
+cmdtrie_del(struct cmdtrie *t, const char *word)
+{
+	struct cmdent			*e;
+	size_t				 n;
+
+	if ((n = find(t, word)) == 0 || t->nodes[n].ent < 0)
+		return -1;
+
+	e = &t->ents[t->nodes[n].ent];
+	str_free(t->mt, e->word);
+	str_free(t->mt, e->expand);
+	e->word = e->expand = NULL;
+	t->nodes[n].ent = -1;
+	recount(t, 0);
+	return 0;
+}
+
+/*
+ * Looks up what 'word' means in environment 'env'. A word typed in
+ * full wins over longer ones it is a prefix of; otherwise a prefix
+ * must leave only one choice. For CMD_AMBIGUOUS and CMD_LIST,
+ * '*node' is where cmdtrie_walk() finds the choices.
+ */
+CmdMatch
+cmdtrie_match(const struct cmdtrie *t, const char *word, ObjType env,
+    const struct cmdent **ent, size_t *node)
+{
+	const struct cmdnode		*nd;
+	size_t				 n;
+
+	*ent = NULL;
+	*node = 0;
+	if (t->nnodes == 0 || *word == '\0' || env >= MAX_OBJ_TYPE)
+		return CMD_MISS;
+
+	for (n = 0; *word != '\0' && *word != '?'; word++)
+		if ((n = lookup(t, n, CT_TOLOWER(*word))) == 0)
+			return CMD_MISS;
+
+	nd = &t->nodes[n];
+	*node = n;
+	if (*word == '?')
+		return nd->count[env] > 0 ? CMD_LIST : CMD_MISS;
+
+	if (n != 0 && nd->ent >= 0 &&
+	    (t->ents[nd->ent].envmask & (1 << env))) {
+		*ent = &t->ents[nd->ent];
+		return CMD_UNIQUE;
+	}
+	if (nd->count[env] == 1) {
+		*ent = &t->ents[nd->only[env]];
+		return CMD_UNIQUE;
+	}
+
+	return nd->count[env] > 1 ? CMD_AMBIGUOUS : CMD_MISS;
+}
+
+static void
+walk(const struct cmdtrie *t, size_t n, ObjType env,
+    void (*fn)(const struct cmdent *, void *), void *arg)
+{
+	const struct cmdnode		*nd;
+	const struct cmdent		*e;
+	size_t				 k;
+
+	nd = &t->nodes[n];
+	if (nd->count[env] == 0)
+		return;
+	if (nd->ent >= 0 && !(e = &t->ents[nd->ent])->exact &&
+	    (e->envmask & (1 << env)))
+		fn(e, arg);
+	for (k = nd->kid; k != 0; k = t->nodes[k].sib)
+		walk(t, k, env, fn, arg);
+}
+
+/*
+ * Calls 'fn' for the words below 'node' available in 'env', in
+ * alphabetical order.
+ */
+void
+cmdtrie_walk(const struct cmdtrie *t, size_t node, ObjType env,
+    void (*fn)(const struct cmdent *, void *), void *arg)
+{
+	if (node < t->nnodes && env < MAX_OBJ_TYPE)
+		walk(t, node, env, fn, arg);
+}
+
+void
+cmdtrie_clear(struct cmdtrie *t)
+{
+	size_t				 i;
+
+	for (i = 0; i < t->nents; i++) {
+		str_free(t->mt, t->ents[i].word);
+		str_free(t->mt, t->ents[i].expand);
+	}
+	if (t->alloc > 0)
+		mem_dec(t->mt, t->alloc * sizeof(*t->nodes));
+	if (t->aents > 0)
+		mem_dec(t->mt, t->aents * sizeof(*t->ents));
+	free(t->nodes);
+	free(t->ents);
+	t->nodes = NULL;
+	t->ents = NULL;
+	t->nnodes = t->alloc = t->nents = t->aents = 0;
+}
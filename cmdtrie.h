@@ -0,0 +1,99 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef CMDTRIE_H
+#define CMDTRIE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "object.h"
+#include "mem.h"
+
+/*
+ * Command words compiled into a prefix trie. Each node knows, for
+ * every environment a player can be in, how many words below it are
+ * available there and which one if there is only one, so completing
+ * a typed prefix is a single walk down the trie.
+ *
+ * An entry is either a verb, an index to the caller's command table,
+ * or an alias that stands for a command line. Exact entries are not
+ * completed from a prefix; aliases are typically exact.
+ */
+struct cmdent {
+	char				*word;
+	char				*expand;	/* Alias: command line */
+	int				 cmd;		/* Verb: command index */
+	uint8_t				 envmask;	/* 1 << ObjType */
+	uint8_t				 exact;
+};
+
+struct cmdnode {
+	char				 c;
+	uint16_t			 kid;		/* First child, or 0 */
+	uint16_t			 sib;		/* Next sibling, or 0 */
+	int16_t				 ent;		/* Entry, or -1 */
+	uint16_t			 count[MAX_OBJ_TYPE];
+	int16_t				 only[MAX_OBJ_TYPE];
+};
+
+struct cmdtrie {
+	struct cmdnode			*nodes;
+	size_t				 nnodes;
+	size_t				 alloc;
+	struct cmdent			*ents;
+	size_t				 nents;
+	size_t				 aents;
+	MemType				 mt;
+};
+
+#define CMD_ENV_ANY	((1 << MAX_OBJ_TYPE) - 1)
+
+typedef enum cmd_match {
+	CMD_MISS=0,
+	CMD_UNIQUE,
+	CMD_AMBIGUOUS,
+	CMD_LIST		/* The word ended in '?' */
+} CmdMatch;
+
+int					 cmdtrie_add(
+					    struct cmdtrie *,
+					    const char *,
+					    const char *,
+					    int,
+					    unsigned,
+					    int);
+int					 cmdtrie_del(
+					    struct cmdtrie *,
+					    const char *);
+CmdMatch				 cmdtrie_match(
+					    const struct cmdtrie *,
+					    const char *,
+					    ObjType,
+					    const struct cmdent **,
+					    size_t *);
+void					 cmdtrie_walk(
+					    const struct cmdtrie *,
+					    size_t,
+					    ObjType,
+					    void (*)(const struct cmdent *, void *),
+					    void *);
+void					 cmdtrie_clear(
+					    struct cmdtrie *);
+
+#endif
@@ -34,5 +34,20 @@ void		 go_main(struct player *, char *);
 void		 clear_main(struct player *, char *);
 void		 goto_main(struct player *, char *);
 void		 objects_main(struct player *, char *);
+void		 memory_main(struct player *, char *);
+void		 set_main(struct player *, char *);
+void		 unset_main(struct player *, char *);
+void		 toggle_main(struct player *, char *);
+void		 travel_main(struct player *, char *);
+void		 where_main(struct player *, char *);
+void		 who_main(struct player *, char *);
+void		 tell_main(struct player *, char *);
+void		 name_main(struct player *, char *);
+void		 channel_main(struct player *, char *);
+void		 alias_main(struct player *, char *);
+void		 unalias_main(struct player *, char *);
+void		 pace_main(struct player *, char *);
+void		 action_main(struct player *, char *);
+void		 stats_main(struct player *, char *);
 
 #endif
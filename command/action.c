@@ -0,0 +1,82 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "../command.h"
+#include "../action.h"
+#include "../object.h"
+#include "../player.h"
+#include "../room.h"
+#include "../tell.h"
+
+#include <string.h>
+
+/*
+ * action [NAME [SCRIPT | -]]
+ *
+ * Actions belong to the environment. An action named after an exit
+ * runs when somebody goes that way; any other runs when somebody here
+ * uses its name as a verb. Without a script the action is shown, and
+ * with "-" it is removed.
+ */
+void
+action_main(struct player *plr, char *str)
+{
+	struct object			*env = ENV(plr);
+	const struct action		*a;
+	const char			*errstr;
+	char				*v[2];
+	size_t				 argc, i;
+
+	if ((argc = parse_args(str, v, 2)) < 1 || *v[0] == '\0') {
+		if (env->actions == NULL || env->actions->n == 0) {
+			tellp(plr, "There are no actions here.");
+			return;
+		}
+		for (i = 0; i < env->actions->n; i++)
+			tellpf(plr, "Action %s.", env->actions->act[i].name);
+		return;
+	}
+
+	if (argc < 2 || *v[1] == '\0') {
+		if ((a = action_find(env, v[0])) == NULL)
+			tellpf(plr, "There is no action %s here.", v[0]);
+		else {
+			tellpf(plr, "Action %s:", a->name);
+			end_fmtbuf(&plr->fmtbuf);
+			tellp_raw(plr, a->src);
+			tellp_raw(plr, "\n");
+		}
+		return;
+	}
+
+	if (strcmp(v[1], "-") == 0) {
+		if (action_remove(env, v[0]) == -1) {
+			tellpf(plr, "There is no action %s here.", v[0]);
+			return;
+		}
+		tellpf(plr, "Action %s removed.", v[0]);
+	} else {
+		if (action_set(env, v[0], v[1], &errstr) == -1) {
+			tellpf(plr, "Cannot make the action: %s.", errstr);
+			return;
+		}
+		tellpf(plr, "Action %s set.", v[0]);
+	}
+	if (IS_ROOM(env))
+		ROOM(env)->flags |= ROOM_DIRTY;
+}
@@ -0,0 +1,120 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "../command.h"
+#include "../cmdtrie.h"
+#include "../player.h"
+#include "../tell.h"
+#include "../utf8.h"
+
+#include <string.h>
+
+#define ALIAS_NAME_MAX	16
+
+static int
+valid_alias(const char *name)
+{
+	size_t				 i;
+
+	for (i = 0; name[i] != '\0'; i++)
+		if (!CT(name[i], CT_ALPHA | CT_DIGIT) &&
+		    name[i] != '_' && name[i] != '-')
+			return 0;
+
+	return i > 0 && i <= ALIAS_NAME_MAX &&
+	    strcmp(name, "alias") != 0 && strcmp(name, "unalias") != 0;
+}
+
+/*
+ * alias [NAME [COMMAND...]]
+ *
+ * Without arguments lists the player's aliases. Whatever follows
+ * the alias when it is used is added to the end of COMMAND.
+ */
+void
+alias_main(struct player *plr, char *str)
+{
+	const struct cmdent		*e;
+	char				*p;
+	size_t				 i, n;
+
+	if (str == NULL || *str == '\0') {
+		n = 0;
+		if (plr->aliases != NULL)
+			for (i = 0; i < plr->aliases->nents; i++) {
+				e = &plr->aliases->ents[i];
+				if (e->word == NULL)
+					continue;
+				tellpf(plr, "%s: %s\n", e->word, e->expand);
+				n++;
+			}
+		if (n == 0)
+			tellp(plr, "You have no aliases.\n");
+		return;
+	}
+
+	if ((p = strchr(str, ' ')) != NULL)
+		*p++ = '\0';
+	while (p != NULL && *p == ' ')
+		p++;
+
+	if (!valid_alias(str)) {
+		tellpf(plr, "Can't use %s as an alias.", str);
+		return;
+	}
+
+	if (p == NULL || *p == '\0') {
+		if (plr->aliases != NULL)
+			for (i = 0; i < plr->aliases->nents; i++) {
+				e = &plr->aliases->ents[i];
+				if (e->word != NULL && strcmp(e->word, str) == 0) {
+					tellpf(plr, "%s: %s\n", e->word,
+					    e->expand);
+					return;
+				}
+			}
+		tellpf(plr, "No alias %s.", str);
+		return;
+	}
+
+	if (player_alias(plr, str, p) == -1) {
+		tellp(plr, "Can't add the alias.\n");
+		return;
+	}
+	tellpf(plr, "Alias %s set.", str);
+}
+
+/*
+ * unalias NAME
+ */
+void
+unalias_main(struct player *plr, char *str)
+{
+	char				*v[1];
+
+	if (parse_args(str, v, 1) != 1 || *v[0] == '\0') {
+		tellp(plr, "Unalias what?\n");
+		return;
+	}
+
+	if (player_alias(plr, v[0], NULL) == -1) {
+		tellpf(plr, "No alias %s.", v[0]);
+		return;
+	}
+	tellpf(plr, "Alias %s removed.", v[0]);
+}
@@ -0,0 +1,76 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "../command.h"
+#include "../channel.h"
+#include "../player.h"
+#include "../tell.h"
+
+#include <string.h>
+
+/*
+ * channel
+ * channel join NAME
+ * channel leave NAME
+ * channel NAME message
+ */
+void
+channel_main(struct player *plr, char *str)
+{
+	struct channel			*ch;
+	char				*v[2];
+	size_t				 argc, i;
+
+	argc = parse_args(str, v, 2);
+	if (argc == 0 || *v[0] == '\0') {
+		if (plr->nchans == 0) {
+			tellp(plr, "You are not on any channel.\n");
+			return;
+		}
+		for (i = 0; i < plr->nchans; i++)
+			tellpf(plr, "  %s, %zu member(s)\n",
+			    plr->chans[i]->name, plr->chans[i]->n);
+		return;
+	}
+
+	if (argc == 2 && strcmp(v[0], "join") == 0) {
+		if (channel_join(plr, v[1]) == -1)
+			tellpf(plr, "Can't join %s.", v[1]);
+		else
+			tellpf(plr, "You join %s.", v[1]);
+		return;
+	}
+	if (argc == 2 && strcmp(v[0], "leave") == 0) {
+		if (channel_leave(plr, v[1]) == -1)
+			tellpf(plr, "You are not on %s.", v[1]);
+		else
+			tellpf(plr, "You leave %s.", v[1]);
+		return;
+	}
+
+	if ((ch = channel_find(v[0])) == NULL || !channel_is_member(ch, plr)) {
+		tellpf(plr, "You are not on %s.", v[0]);
+		return;
+	}
+	if (argc != 2 || *v[1] == '\0') {
+		tellp(plr, "Say what?\n");
+		return;
+	}
+
+	channel_send(ch, plr, v[1]);
+}
@@ -22,6 +22,10 @@
 #include "../match.h"
 #include "../message.h"
 #include "../object.h"
+#include "../store.h"
+#include "../snapshot.h"
+#include "../tag.h"
+#include "../arena.h"
 
 #include <stddef.h>
 #include <stdio.h>
@@ -36,6 +40,32 @@ enum target_types {
 	TARGET_NONE=0, TARGET_DIR, TARGET_DETAIL
 };
 
+/*
+ * Splits off a leading "tag:night,!cloudy" condition from '*str'.
+ * Returns 1 if there was one, 0 if not and -1 on error.
+ */
+static int
+parse_cond(struct player *plr, char **str, TagSet *req, TagSet *forbid)
+{
+	const char	*errstr;
+	char		*p;
+
+	if (*str == NULL || strncmp(*str, "tag:", 4) != 0)
+		return 0;
+	if ((p = strchr(*str, ' ')) != NULL)
+		*p++ = '\0';
+	if (tag_parse_cond(*str + 4, req, forbid, &errstr) == -1) {
+		tellpf(plr, "Bad condition: %s.", errstr);
+		return -1;
+	}
+	if (*req == 0 && *forbid == 0) {
+		tellp(plr, "Empty condition.");
+		return -1;
+	}
+	*str = p;
+	return 1;
+}
+
 void
 describe_main(struct player *plr, char *str)
 {
@@ -46,9 +76,10 @@ describe_main(struct player *plr, char *str)
 		TARGET_DIR, TARGET_DIR, TARGET_DIR, TARGET_DIR,
 		TARGET_NONE, TARGET_DETAIL, TARGET_NONE
 	};
-	int m, i;
+	int m, i, cond = 0;
 	size_t argc;
 	char *v1[2], *v2[2];
+	TagSet req, forbid;
 
 	argc = parse_args(str, v1, 2);
 	if (argc < 1) {
@@ -67,28 +98,71 @@ describe_main(struct player *plr, char *str)
 			return;
 		}
 		argc = parse_args(v1[1], v2, 2);
-		i = match_input(plr, NULL, v2[0],
-		    (const char **) player_env(plr)->exit_keys,
-		    player_env(plr)->nexits);
+		{
+			struct room *room = player_env(plr);
+			const char **keys;
+
+			if ((keys = arena_alloc((room->nexits + 1) *
+			    sizeof(*keys))) == NULL)
+				return;
+			room_exit_keys(room, keys);
+			i = match_input(plr, NULL, v2[0], keys, room->nexits);
+		}
 		if (i == -1)
 			return;
 		if (argc < 2) {
 			tellp(plr, "And the description please?\n");
 			return;
 		}
+		if ((cond = parse_cond(plr, &v2[1], &req, &forbid)) == -1)
+			return;
+		if (v2[1] == NULL) {
+			tellp(plr, "And the description please?\n");
+			return;
+		}
+
+		if (cond && (m == DESC_ENTER || m == DESC_EXIT)) {
+			struct room *room = player_env(plr);
 
-		if (m == DESC_ENTER)
+			room_set_variant(room, m, room->exits[i].key, req,
+			    forbid, v2[1]);
+		} else if (m == DESC_ENTER)
 			set_travel_desc(player_env(plr), v2[0], v2[1]);
 		else if (m == DESC_EXIT)
 			set_exit_desc(player_env(plr), v2[0], v2[1]);
 		tellp(plr, "Description updated.");
 	} else if (strcmp(desc_types[m], "save") == 0) {
-		FILE *fp = fopen("rooms.txt", "w");
-		object_save_all(fp, "room/*");
-		fclose(fp);
+		if (store_active()) {
+			if (store_save() == -1) {
+				tellp(plr, "Saving failed.");
+				return;
+			}
+		} else if (snapshot_active()) {
+			if (snapshot_save() == -1) {
+				tellp(plr, "Saving failed.");
+				return;
+			}
+		} else {
+			FILE *fp = fopen("rooms.txt", "w");
+			object_save_all(fp, "room/*");
+			fclose(fp);
+		}
 		tellp(plr, "Saved.");
 	} else if (strcmp(desc_types[m], "title") == 0) {
-		set_title(PPARENT(plr), v1[1]);
+		if (argc < 2 || (cond = parse_cond(plr, &v1[1], &req,
+		    &forbid)) == -1 || v1[1] == NULL) {
+			if (cond != -1)
+				tellp(plr, "And the title please?\n");
+			return;
+		}
+		if (cond && !IS_ROOM(PPARENT(plr))) {
+			tellp(plr, "Only rooms have titles that depend on tags.");
+			return;
+		} else if (cond)
+			room_set_variant(player_env(plr), DESC_TITLE, NULL,
+			    req, forbid, v1[1]);
+		else
+			set_title(PPARENT(plr), v1[1]);
 		tellp(plr, "Title updated.");
 	}
 }
@@ -22,9 +22,11 @@
 #include "../tell.h"
 #include "../args.h"
 #include "../object.h"
+#include "../store.h"
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
 
 /*
  * dig [to:3] KEY [reverse]
@@ -38,61 +40,13 @@
  *   dig to:area/3 inn out
  */
 
-#ifndef ARRLEN
-#define ARRLEN(_x) sizeof((_x)) / sizeof((_x)[0])
-#endif
-
-#include <stdio.h>
-static const char *
-reverse_dir(const char *dir)
-{
-	static const struct {
-		const char *dir;
-		const char *reverse;
-	} reverse[] = {
-		{ "north", "south" },
-		{ "up", "down" },
-		{ "down", "up" },
-		{ "west", "east" },
-		{ "south", "north" },
-		{ "east", "west" },
-		{ "northwest", "southeast" },
-		{ "northeast", "southwest" },
-		{ "southwest", "northeast" },
-		{ "southeast", "northwest" }
-	};
-	size_t				 i;
-
-	for (i = 0; i < ARRLEN(reverse); i++) {
-		if (strcmp(dir, reverse[i].dir) == 0)
-			return reverse[i].reverse;
-	}
-
-	return NULL;
-}
-
 void
 dig_main(struct player *plr, char *str)
 {
-	static const struct {
-		const char *alias;
-		char *str;
-	} aliases[] = {
-		{ "n", "north" },
-		{ "u", "up" },
-		{ "d", "down" },
-		{ "w", "west" },
-		{ "s", "south" },
-		{ "e", "east" },
-		{ "nw", "northwest" },
-		{ "ne", "northeast" },
-		{ "sw", "southwest" },
-		{ "se", "southeast" }
-	};
-
-	size_t				 argc, i, j, k;
+	size_t				 argc, j, k;
 	char				*v[3];
 	const char			*rev;
+	Direction			 dir;
 	struct object			*dest = NULL;
 
 	if (!IS_ROOM(ENV(plr))) {
@@ -115,6 +69,10 @@ dig_main(struct player *plr, char *str)
 			tellp(plr, "Room ID.");
 			return;
 		}
+		if (!store_key_ok(&v[j][3])) {
+			tellp(plr, "Room ID too long.");
+			return;
+		}
 		dest = object_find(&v[j][3]);
 		j++;
 		argc--;
@@ -137,16 +95,12 @@ dig_main(struct player *plr, char *str)
 	} else if (argc == 2)
 		rev = v[j+1];
 
-	for (k = 0; k < argc; k++) {
-		for (i = 0; i < ARRLEN(aliases); i++) {
-			if (strcmp(v[j+k], aliases[i].alias) == 0) {
-				v[j+k] = aliases[i].str;
-				break;
-			}
-		}
-	}
+	for (k = 0; k < argc; k++)
+		if ((dir = dir_parse(v[j+k])) != DIR_CUSTOM)
+			v[j+k] = (char *) dir_name(dir);
 
-	if (rev == NULL && (rev = reverse_dir(v[j])) == NULL) {
+	if (rev == NULL &&
+	    (rev = dir_name(dir_reverse(dir_parse(v[j])))) == NULL) {
 		tellp(plr, "No reverse direction.");
 	}
 	if (rev != NULL && *rev == '-')
@@ -23,6 +23,10 @@
 #include "../object.h"
 #include "../args.h"
 #include "../match.h"
+#include "../store.h"
+#include "../tag.h"
+#include "../action.h"
+#include "../arena.h"
 
 void
 go_main(struct player *plr, char *str)
@@ -31,8 +35,13 @@ go_main(struct player *plr, char *str)
 	char				*v[1];
 	int				 m;
 	size_t				 i;
-	const char			*key, *target;
-	struct object			*prev;
+	Direction			 dir;
+	struct object			*dest;
+	ObjHandle			 prev;
+	struct room			*room;
+	struct exit			*e;
+	const char			*text, **keys;
+	TagSet				 have;
 
 	if (!IS_ROOM(ENV(plr))) {
 		tellpf(plr, "You cannot go anywhere here.");
@@ -44,34 +53,55 @@ go_main(struct player *plr, char *str)
 		tellp(plr, "Go where?\n");
 		return;
 	}
-	m = match_input(plr, NULL, v[0],
-	    (const char **) player_env(plr)->exit_keys,
-	    player_env(plr)->nexits);
-	if (m == -1)
-		return;
-	key = player_env(plr)->exit_keys[m];
+	room = player_env(plr);
+
+	/*
+	 * Directions are resolved from the direction table, anything
+	 * else goes through the usual matching against the exit names.
+	 */
+	dir = dir_parse(v[0]);
+	if (dir != DIR_CUSTOM && HAS_DIR(room, dir))
+		m = room->dir_exit[dir];
+	else {
+		if ((keys = arena_alloc((room->nexits + 1) *
+		    sizeof(*keys))) == NULL)
+			return;
+		room_exit_keys(room, keys);
+		m = match_input(plr, NULL, v[0], keys, room->nexits);
+		if (m == -1)
+			return;
+	}
+	e = &room->exits[m];
 
-	target = room_exit_target(ROOM(PPARENT(plr)), key);
-	if (target == NULL) {
+	dest = room_exit_object(room, m);
+	if (dest == NULL) {
 		tellp(plr, "Cannot go that way here.\n");
 		return;
 	}
-	tellpf(plr, "%s  ", travel_desc(ROOM(PPARENT(plr)), key));
+	if (action_run(ENV(plr), e->key, plr) == ACT_STOPPED)
+		return;
+	if ((text = exit_travel_text(room, m, tag_view(plr))) != NULL) {
+		tellp_text(plr, text);
+		tellp(plr, "  ");
+	}
 
-	tellrf(ENV(plr), plr, "%s leaves to %s.", OBJ(plr)->key, key);
+	tellrf(ENV(plr), plr, "%s leaves to %s.", player_name(plr), e->key);
 
-	prev = PPARENT(plr);
-	object_reparent(OBJ(plr), object_find(target));
+	prev = object_handle(PPARENT(plr));
+	object_reparent(OBJ(plr), dest);
 
-	tellrf(ENV(plr), plr, "%s arrives.", OBJ(plr)->key);
+	tellrf(ENV(plr), plr, "%s arrives.", player_name(plr));
 
-	highlight(&plr->fmtbuf, (const char **) player_env(plr)->exit_keys,
-	    player_env(plr)->nexits);
-	for (i = 0; i < player_env(plr)->nexits; i++) {
-		if (prev == object_find(player_env(plr)->exit_targets[i]))
+	room = player_env(plr);
+	store_prefetch(room);
+	have = tag_view(plr);
+	highlight(&plr->fmtbuf, room_highlight(room));
+	for (i = 0; i < room->nexits; i++) {
+		if (prev == object_handle(room_exit_object(room, i)) ||
+		    (text = exit_text(room, i, have)) == NULL)
 			continue;
-		tellpf(plr, "%s  ", exit_desc(ROOM(PPARENT(plr)),
-		    player_env(plr)->exit_keys[i]));
+		tellp_text(plr, text);
+		tellp(plr, "  ");
 	}
-	highlight(&plr->fmtbuf, NULL, 0);
+	highlight(&plr->fmtbuf, NULL);
 }
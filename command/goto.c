@@ -21,6 +21,8 @@
 #include "../args.h"
 #include "../player.h"
 #include "../tell.h"
+#include "../room.h"
+#include "../store.h"
 
 void
 goto_main(struct player *plr, char *str)
@@ -34,15 +36,22 @@ goto_main(struct player *plr, char *str)
 		tellp(plr, "Goto where?\n");
 		return;
 	}
+	if (!store_key_ok(v[0])) {
+		tellp(plr, "Room ID too long.");
+		return;
+	}
 
 	obj = object_find(v[0]);
 
 	tellrf(ENV(plr), plr, "%s disappears in a puff of smoke.",
-	    OBJ(plr)->key);
+	    player_name(plr));
 
 	object_reparent(OBJ(plr), object_find(v[0]));
 
-	tellrf(ENV(plr), plr, "%s appears in a puff of smoke.", OBJ(plr)->key);
+	tellrf(ENV(plr), plr, "%s appears in a puff of smoke.",
+	    player_name(plr));
+	if (IS_ROOM(ENV(plr)))
+		store_prefetch(player_env(plr));
 
 	tellpf(plr, "You are now in %s.", obj->key);
 }
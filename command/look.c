@@ -21,12 +21,15 @@
 #include "../message.h"
 #include "../tell.h"
 #include "../object.h"
+#include "../tag.h"
 
 void
 look_main(struct player *plr, const char *str)
 {
 	struct object *obj;
+	struct room *room;
 	size_t i;
+	TagSet have;
 
 	if (!IS_ROOM(ENV(plr))) {
 		tellpf(plr, "This location: %s.", ENV(plr)->key);
@@ -36,29 +39,25 @@ look_main(struct player *plr, const char *str)
 #if 0
 	tellpf(plr, "This location: %s\n", PPARENT(plr)->key);
 #endif
-	if (title(PPARENT(plr)) != NULL)
-		tellpf(plr, "%s", title(PPARENT(plr)));
-
-	highlight(&plr->fmtbuf, (const char **) player_env(plr)->exit_keys,
-	    player_env(plr)->nexits);
-	for (i = 0; i < player_env(plr)->nexits; i++) {
+	room = player_env(plr);
+	have = tag_view(plr);
+	highlight(&plr->fmtbuf, room_highlight(room));
+	tellp_text(plr, room_title(room, have));
+	for (i = 0; i < room->nexits; i++) {
 #if 0
 		tellpf(plr, "Travel: %s -> %s\n",
-		    player_env(plr)->exit_keys[i],
-		    travel_desc(player_env(plr),
-		    player_env(plr)->exit_keys[i]));
+		    room->exits[i].key, room->exits[i].travel_desc);
 #endif
-		tellpf(plr, "%s",
-		    exit_desc(player_env(plr), player_env(plr)->exit_keys[i]));
+		tellp_text(plr, exit_text(room, i, have));
 #if 0
-		tellpf(plr, "Exit: %s -> %s\n", player_env(plr)->exit_keys[i],
-		    player_env(plr)->exit_targets[i]);
+		tellpf(plr, "Exit: %s -> %s\n", room->exits[i].key,
+		    room->exits[i].target);
 #endif
 	}
-	highlight(&plr->fmtbuf, NULL, 0);
+	highlight(&plr->fmtbuf, NULL);
 
 	obj = NULL;
-	while ((obj = object_next_child(OBJ(player_env(plr)), obj)) != NULL) {
+	while ((obj = object_next_child(OBJ(room), obj)) != NULL) {
 		if (obj == OBJ(plr))
 			continue;
 		tellpf(plr, "There is %s here.", obj->key);
@@ -0,0 +1,117 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "../command.h"
+#include "../object.h"
+#include "../text.h"
+#include "../player.h"
+#include "../tell.h"
+#include "../mem.h"
+#include "../args.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * memory [dump]
+ *
+ * Shows the running totals of heap memory per subsystem, and the
+ * memory held by the objects of each type counted by walking through
+ * all objects. A difference between the two points to a leak.
+ *
+ * 'memory dump' writes the same in a machine readable form to
+ * memory.txt, one record per line:
+ *   subsystem NAME BYTES BLOCKS
+ *   type NAME BYTES OBJECTS
+ *   total BYTES
+ */
+
+#define MEMORY_DUMP	"memory.txt"
+
+void
+memory_main(struct player *plr, char *str)
+{
+	size_t			 argc, total;
+	size_t			 bytes[MAX_OBJ_TYPE], count[MAX_OBJ_TYPE];
+	char			*v[1], buf[128];
+	struct object		*obj;
+	FILE			*fp = NULL;
+	int			 i;
+
+	argc = parse_args(str, v, 1);
+	if (argc == 1 && strcmp(v[0], "dump") == 0) {
+		if ((fp = fopen(MEMORY_DUMP, "w")) == NULL) {
+			tellp(plr, "Cannot write the memory dump.");
+			return;
+		}
+	} else if (argc == 1) {
+		tellp(plr, "Usage: memory [dump]");
+		return;
+	}
+
+	memset(bytes, 0, sizeof(bytes));
+	memset(count, 0, sizeof(count));
+	obj = NULL;
+	while ((obj = object_next(obj)) != NULL) {
+		if (obj->type >= MAX_OBJ_TYPE)
+			continue;
+		bytes[obj->type] += object_bytes(obj);
+		count[obj->type]++;
+	}
+
+	total = 0;
+	if (fp == NULL)
+		tellp_raw(plr, "Subsystem            Bytes     Blocks\n");
+	for (i = 0; i < MAX_MEM_TYPES; i++) {
+		total += mem_bytes(i);
+		if (fp != NULL) {
+			fprintf(fp, "subsystem %s %zu %zu\n", mem_name(i),
+			    mem_bytes(i), mem_count(i));
+			continue;
+		}
+		snprintf(buf, sizeof(buf), "%-14s %12zu %10zu\n",
+		    mem_name(i), mem_bytes(i), mem_count(i));
+		tellp_raw(plr, buf);
+	}
+
+	if (fp == NULL)
+		tellp_raw(plr, "\nObject type          Bytes    Objects\n");
+	for (i = 0; i < MAX_OBJ_TYPE; i++) {
+		if (fp != NULL) {
+			fprintf(fp, "type %s %zu %zu\n", object_type_name(i),
+			    bytes[i], count[i]);
+			continue;
+		}
+		snprintf(buf, sizeof(buf), "%-14s %12zu %10zu\n",
+		    object_type_name(i), bytes[i], count[i]);
+		tellp_raw(plr, buf);
+	}
+
+	if (fp != NULL) {
+		fprintf(fp, "texts %zu\n", text_count());
+		fprintf(fp, "total %zu\n", total);
+		fclose(fp);
+		snprintf(buf, sizeof(buf), "Memory usage written to %s.\n",
+		    MEMORY_DUMP);
+		tellp_raw(plr, buf);
+	} else {
+		snprintf(buf, sizeof(buf), "\n%-14s %12zu\n%-14s %12zu\n",
+		    "total", total, "shared texts", text_count());
+		tellp_raw(plr, buf);
+	}
+}
@@ -0,0 +1,53 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "../command.h"
+#include "../object.h"
+#include "../player.h"
+#include "../tell.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * name NEW
+ *
+ * Names start with a letter and may have letters, digits, '_' and
+ * '-'; they are unique without regard to case.
+ */
+void
+name_main(struct player *plr, char *str)
+{
+	char				 old[PLAYER_NAME_MAX];
+	char				*v[1];
+
+	if (parse_args(str, v, 1) != 1 || *v[0] == '\0') {
+		tellpf(plr, "You are %s.", player_name(plr));
+		return;
+	}
+
+	snprintf(old, sizeof(old), "%s", player_name(plr));
+	if (player_set_name(plr, v[0]) == -1) {
+		tellpf(plr, "Can't use the name %s.", v[0]);
+		return;
+	}
+
+	tellpf(plr, "You are now %s.", player_name(plr));
+	tellrf(ENV(plr), plr, "%s is now known as %s.", old,
+	    player_name(plr));
+}
@@ -18,14 +18,31 @@
 
 #include "../tell.h"
 #include "../object.h"
+#include "../query.h"
 
+static void
+list_one(struct object *obj, void *plr)
+{
+	tellpf(plr, "%s.", obj->key);
+}
+
+/*
+ * objects [type=T] [in=NAMESPACE] [parent=KEY] [key=PATTERN]
+ *         [exits<N] [children>N] ...
+ */
 void
 objects_main(struct player *plr, char *str)
 {
-	struct object *obj;
+	struct query			 q;
+	const char			*errstr;
+	size_t				 n;
 
-	obj = NULL;
-	while ((obj = object_next(obj)) != NULL) {
-		tellpf(plr, "%s.", obj->key);
+	if (query_parse(&q, str, &errstr) == -1) {
+		tellpf(plr, "Bad query: %s.", errstr);
+		return;
 	}
+
+	n = query_run(&q, list_one, plr);
+	tellpf(plr, "%zu object%s, using the %s index.", n,
+	    n == 1 ? "" : "s", q.plan);
 }
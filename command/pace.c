@@ -0,0 +1,64 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "../command.h"
+#include "../player.h"
+#include "../sched.h"
+#include "../tell.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * pace [MS | off]
+ *
+ * Runs the player's commands no faster than one per MS milliseconds,
+ * e.g. for walking a long way at a readable speed.
+ */
+void
+pace_main(struct player *plr, char *str)
+{
+	char				*v[1], *ep;
+	long				 ms;
+
+	if (parse_args(str, v, 1) != 1 || *v[0] == '\0') {
+		if (plr->cmdq.pace == 0)
+			tellp(plr, "Your commands are run as they come.");
+		else
+			tellpf(plr, "Your commands are run every %d ms.",
+			    plr->cmdq.pace);
+		return;
+	}
+
+	if (strcmp(v[0], "off") == 0)
+		ms = 0;
+	else {
+		ms = strtol(v[0], &ep, 10);
+		if (*ep != '\0' || ms < 0 || ms > PACE_MAX) {
+			tellpf(plr, "Pace is from 0 to %d ms.", PACE_MAX);
+			return;
+		}
+	}
+
+	plr->cmdq.pace = ms;
+	plr->cmdq.next_at = 0;
+	if (ms == 0)
+		tellp(plr, "Your commands are run as they come.");
+	else
+		tellpf(plr, "Your commands are run every %ld ms.", ms);
+}
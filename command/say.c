@@ -40,5 +40,5 @@ say_main(struct player *plr, char *str)
 	else
 		tellpf(plr, "You say, \"%s\"", str);
 
-	tellrf(ENV(plr), plr, "%s says: %s", OBJ(plr)->key, str);
+	tellrfc(ENV(plr), plr, MSG_DIRECTED, "%s says: %s", player_name(plr), str);
 }
@@ -0,0 +1,109 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "../command.h"
+#include "../player.h"
+#include "../tell.h"
+#include "../stats.h"
+#include "../args.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+/*
+ * stats [dump]
+ *
+ * Shows, for each command that has been run, how often it ran, the
+ * CPU time its handler took and the bytes of output it queued, and
+ * its latency from reading the line to writing the last byte of the
+ * output. Times are in microseconds; the percentiles are the upper
+ * ends of power of two buckets, so read them as "no more than".
+ *
+ * 'stats dump' writes all of it to stats.txt, one record per command
+ * and measure:
+ *   MEASURE COMMAND COUNT SUM P50 P99 MAX
+ * where MEASURE is one of cpu, bytes or latency.
+ */
+
+#define STATS_DUMP	"stats.txt"
+
+static void
+dump_hist(FILE *fp, const char *what, const char *name,
+    const struct hist *h)
+{
+	fprintf(fp, "%s %s %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64
+	    " %" PRIu64 "\n", what, name, (uint64_t) h->n, (uint64_t) h->sum,
+	    hist_quantile(h, 0.5), hist_quantile(h, 0.99), (uint64_t) h->max);
+}
+
+void
+stats_main(struct player *plr, char *str)
+{
+	const struct cmdstats	*s;
+	size_t			 argc, i;
+	char			*v[1], buf[128];
+	FILE			*fp = NULL;
+
+	argc = parse_args(str, v, 1);
+	if (argc == 1 && strcmp(v[0], "dump") == 0) {
+		if ((fp = fopen(STATS_DUMP, "w")) == NULL) {
+			tellp(plr, "Cannot write the stats dump.");
+			return;
+		}
+	} else if (argc == 1) {
+		tellp(plr, "Usage: stats [dump]");
+		return;
+	}
+
+	if (fp == NULL)
+		tellp_raw(plr, "                  "
+		    "CPU (us)         Output      Latency (us)\n"
+		    "Command    Count   p50   p99    max   p50   p99"
+		    "    p50    p99     max\n");
+	for (i = 0; i < stats_count(); i++) {
+		s = stats_get(i);
+		if (fp != NULL) {
+			dump_hist(fp, "cpu", stats_name(i), &s->cpu);
+			dump_hist(fp, "bytes", stats_name(i), &s->bytes);
+			dump_hist(fp, "latency", stats_name(i), &s->latency);
+			continue;
+		}
+		if (s->cpu.n == 0)
+			continue;
+		snprintf(buf, sizeof(buf), "%-9s %6" PRIu64 " %5" PRIu64
+		    " %5" PRIu64 " %6" PRIu64 " %5" PRIu64 " %5" PRIu64
+		    " %6" PRIu64 " %6" PRIu64 " %7" PRIu64 "\n",
+		    stats_name(i), (uint64_t) s->cpu.n,
+		    hist_quantile(&s->cpu, 0.5), hist_quantile(&s->cpu, 0.99),
+		    (uint64_t) s->cpu.max,
+		    hist_quantile(&s->bytes, 0.5),
+		    hist_quantile(&s->bytes, 0.99),
+		    hist_quantile(&s->latency, 0.5),
+		    hist_quantile(&s->latency, 0.99),
+		    (uint64_t) s->latency.max);
+		tellp_raw(plr, buf);
+	}
+
+	if (fp != NULL) {
+		fclose(fp);
+		snprintf(buf, sizeof(buf), "Command stats written to %s.\n",
+		    STATS_DUMP);
+		tellp_raw(plr, buf);
+	}
+}
@@ -0,0 +1,121 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "../command.h"
+#include "../player.h"
+#include "../room.h"
+#include "../tell.h"
+#include "../tag.h"
+
+#include <string.h>
+
+enum tag_op {
+	TAG_SET=0, TAG_UNSET, TAG_TOGGLE
+};
+
+static void
+list_tags(struct player *plr)
+{
+	TagSet				*set;
+	TagScope			 scope;
+	int				 i, n;
+
+	n = 0;
+	for (scope = 0; scope < MAX_TAG_SCOPES; scope++) {
+		if ((set = tag_scope(scope, plr)) == NULL)
+			continue;
+		for (i = 0; i < MAX_TAGS; i++)
+			if (*set & TAG_BIT(i)) {
+				tellpf(plr, "%s %s.", tag_scope_name(scope),
+				    tag_name(i));
+				n++;
+			}
+	}
+	if (n == 0)
+		tellp(plr, "No tags are set.");
+}
+
+/*
+ * set|unset|toggle rtag|ptag|atag|gtag NAME
+ */
+static void
+tag_main(struct player *plr, char *str, enum tag_op op)
+{
+	char				*v[2];
+	TagSet				*set;
+	int				 scope, i;
+
+	if (parse_args(str, v, 2) < 2) {
+		if (op == TAG_SET && str == NULL)
+			list_tags(plr);
+		else
+			tellp(plr, "Usage: set|unset|toggle rtag|ptag|gtag NAME");
+		return;
+	}
+	if ((scope = tag_scope_parse(v[0])) == -1) {
+		tellp(plr, "Tag scope is one of rtag, ptag or gtag.");
+		return;
+	}
+	if ((set = tag_scope(scope, plr)) == NULL) {
+		tellp(plr, "There is no room here to tag.");
+		return;
+	}
+
+	if (op == TAG_UNSET)
+		i = tag_find(v[1]);
+	else if ((i = tag_intern(v[1])) == -1) {
+		tellp(plr, "Cannot make such a tag.");
+		return;
+	}
+	if (i == -1)
+		return;
+
+	switch (op) {
+	case TAG_SET:
+		*set |= TAG_BIT(i);
+		break;
+	case TAG_UNSET:
+		*set &= ~TAG_BIT(i);
+		break;
+	case TAG_TOGGLE:
+		*set ^= TAG_BIT(i);
+		break;
+	}
+	if (scope == TAG_ROOM)
+		player_env(plr)->flags |= ROOM_DIRTY;
+	tellpf(plr, "%s %s is %s.", tag_scope_name(scope), v[1],
+	    (*set & TAG_BIT(i)) ? "set" : "unset");
+}
+
+void
+set_main(struct player *plr, char *str)
+{
+	tag_main(plr, str, TAG_SET);
+}
+
+void
+unset_main(struct player *plr, char *str)
+{
+	tag_main(plr, str, TAG_UNSET);
+}
+
+void
+toggle_main(struct player *plr, char *str)
+{
+	tag_main(plr, str, TAG_TOGGLE);
+}
@@ -0,0 +1,53 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "../command.h"
+#include "../player.h"
+#include "../tell.h"
+#include "../arena.h"
+
+#include <stdio.h>
+
+/*
+ * tell NAME message
+ */
+void
+tell_main(struct player *plr, char *str)
+{
+	struct player			*to;
+	char				*v[2], *buf;
+
+	if (parse_args(str, v, 2) != 2 || *v[1] == '\0') {
+		tellp(plr, "Tell whom what?\n");
+		return;
+	}
+
+	if ((to = player_find(v[0])) == NULL) {
+		tellpf(plr, "Nobody called %s is here.", v[0]);
+		player_suggest(plr, v[0]);
+		return;
+	}
+
+	/* Rendered as a whole paragraph since 'to' is not the one typing. */
+	if ((buf = arena_printf("%s tells you: %s", player_name(plr),
+	    v[1])) == NULL)
+		return;
+	tellpm(&to, 1, buf);
+	if (to != plr)
+		tellpf(plr, "You tell %s: %s", player_name(to), v[1]);
+}
@@ -0,0 +1,139 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "../command.h"
+#include "../object.h"
+#include "../player.h"
+#include "../room.h"
+#include "../route.h"
+#include "../sched.h"
+#include "../tell.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Room that 'key' is in, or is. Only resident objects are considered.
+ */
+static struct object *
+locate(const char *key)
+{
+	struct object			*obj;
+
+	if ((obj = object_lookup(key)) == NULL)
+		return NULL;
+	while (obj != NULL && !IS_ROOM(obj))
+		obj = obj->parent;
+
+	return obj;
+}
+
+/*
+ * travel [to] KEY
+ */
+void
+travel_main(struct player *plr, char *str)
+{
+	char				*v[2], buf[256];
+	struct object			*dest, *at;
+	const ObjHandle			*path;
+	ObjHandle			 next;
+	const char			*key;
+	size_t				 argc, len;
+
+	argc = parse_args(str, v, 2);
+	if (argc == 2 && strcmp(v[0], "to") == 0)
+		v[0] = v[1];
+	else if (argc != 1) {
+		tellp(plr, "Travel to where?");
+		return;
+	}
+
+	if (!IS_ROOM(ENV(plr))) {
+		tellp(plr, "You cannot travel from here.");
+		return;
+	}
+	if ((dest = locate(v[0])) == NULL ||
+	    route_find(ENV(plr), dest, &path, &len) == -1) {
+		tellp(plr, "You do not know the way there.");
+		return;
+	}
+	if (len == 0) {
+		tellp(plr, "You are already there.");
+		return;
+	}
+
+	/*
+	 * One step at a time: the rest of the way is queued as a new
+	 * travel, which is run at the player's pace and in turn with
+	 * everybody else's commands. Moving may drop the cached route,
+	 * so what is needed of it is taken first.
+	 */
+	at = ENV(plr);
+	next = path[0];
+	if ((key = route_exit(ROOM(at), next)) == NULL) {
+		tellp(plr, "The way is lost.");
+		return;
+	}
+	snprintf(buf, sizeof(buf), "%s", key);
+	go_main(plr, buf);
+	if (object_handle(ENV(plr)) != next || len == 1)
+		return;
+
+	snprintf(buf, sizeof(buf), "travel to %s", v[0]);
+	sched_push_front(plr, buf);
+}
+
+/*
+ * where [is] KEY
+ */
+void
+where_main(struct player *plr, char *str)
+{
+	char				*v[2];
+	struct object			*dest;
+	const ObjHandle			*path;
+	const char			*key;
+	size_t				 argc, len;
+
+	argc = parse_args(str, v, 2);
+	if (argc == 2 && strcmp(v[0], "is") == 0)
+		v[0] = v[1];
+	else if (argc != 1) {
+		tellp(plr, "Where is what?");
+		return;
+	}
+
+	if ((dest = locate(v[0])) == NULL) {
+		tellpf(plr, "Nobody knows where %s is.", v[0]);
+		return;
+	}
+	if (dest == ENV(plr)) {
+		tellpf(plr, "%s is right here.", v[0]);
+		return;
+	}
+	if (!IS_ROOM(ENV(plr)) ||
+	    route_find(ENV(plr), dest, &path, &len) == -1 ||
+	    (key = route_exit(player_env(plr), path[0])) == NULL) {
+		tellpf(plr, "%s is in %s, but you do not know the way.",
+		    v[0], dest->key);
+		return;
+	}
+	tellpf(plr, "%s is %zu step%s away, %s from here.", v[0], len,
+	    len == 1 ? "" : "s", key);
+}
@@ -26,6 +26,6 @@ struct event		*event_create();
 void			 event_free(struct event *);
 
 int			 event_add_evsrc(struct event *, struct evsrc *);
-int			 event_dispatch(struct event *);
+int			 event_dispatch(struct event *, int);
 
 #endif
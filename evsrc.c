@@ -17,6 +17,7 @@
  */
 
 #include "evsrc.h"
+#include "mem.h"
 
 #include <stdlib.h>
 
@@ -51,6 +52,7 @@ evsrc_create(EvSrcType type, int value,
 
 	evsrc = calloc(1, sizeof(struct evsrc));
 	if (evsrc != NULL) {
+		mem_inc(MEM_EVSRC, sizeof(struct evsrc));
 		evsrc->type = type;
 		evsrc->value = value;
 		evsrc->readcb = readcb;
@@ -63,5 +65,7 @@ evsrc_create(EvSrcType type, int value,
 void
 evsrc_free(struct evsrc *evsrc)
 {
+	if (evsrc != NULL)
+		mem_dec(MEM_EVSRC, sizeof(struct evsrc));
 	free(evsrc);
 }
@@ -17,23 +17,82 @@
  */
 
 #include "fmtbuf.h"
+#include "mem.h"
+#include "utf8.h"
 
-#include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 
-#define sentence_end(_x) \
-	((_x) == '?' || (_x) == '!' || (_x) == '.')
-#define punct(_x) \
-	((_x) == ',' || (_x) == ';' || (_x) == ':')
-#define word_end(_x) \
-	(sentence_end((_x)) || isspace((_x)) || punct((_x)))
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define sentence_end(_x)	CT((_x), CT_SENT)
+#define punct(_x)		CT((_x), CT_PUNCT)
+#define word_end(_x)		CT((_x), CT_SENT | CT_SPACE | CT_PUNCT)
+
+#define HL_ON		"\033[1;31m"
+#define HL_ON_LEN	(sizeof(HL_ON) - 1)
+#define HL_OFF		"\033[0m"
+#define HL_OFF_LEN	(sizeof(HL_OFF) - 1)
+
+/*
+ * The word scanner reads whole aligned blocks, which may run past the
+ * terminating NUL but never into the next page.
+ */
+#if defined(__SANITIZE_ADDRESS__)
+#define NO_ASAN	__attribute__((no_sanitize_address))
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define NO_ASAN	__attribute__((no_sanitize_address))
+#endif
+#endif
+#ifndef NO_ASAN
+#define NO_ASAN
+#endif
+
+/*
+ * Formatted output of long lived texts such as descriptions. The
+ * output depends on the text and on the formatting state it is added
+ * in, so all of that is the key. There is one entry per slot and the
+ * slot depends only on the text, which makes invalidating a text
+ * exact.
+ */
+#define FMTCACHE_SZ	4096
+#define FMTCACHE_MAX	2048
+
+struct fmtcache {
+	const char			*text;
+	size_t				 width;
+	int				 nocolor;
+	uint32_t			 hlkey;
+	size_t				 len_in;
+	int				 state_in;
+	int				 upper_in;
+
+	char				*out;
+	size_t				 alloc;
+	size_t				 outlen;
+	size_t				 len_out;
+	int				 state_out;
+	int				 upper_out;
+	size_t				 rewind_off;
+	int				 rewind_set;
+};
+
+static struct fmtcache			 fmtcache[FMTCACHE_SZ];
+
+static void				 dump(struct fmtbuf *, const char *,
+					    size_t, int);
 
 void
 end_fmtbuf(struct fmtbuf *fb)
 {
-	fb->outbuf[fb->j++] = '\n';
-	fb->outbuf[fb->j++] = '\n';
-	fb->outbuf[fb->j] = '\0';
+	/* Flush a word left hanging at the end of the last message */
+	if (fb->state == IN_WORD)
+		add_fmtbuf(fb, " ");
+
+	dump(fb, "\n\n", 2, 0);
 	fb->state = BEGIN_WORD;
 	fb->upper = 0;
 	fb->len = 0;
@@ -41,42 +100,188 @@ end_fmtbuf(struct fmtbuf *fb)
 	fb->wordlen = 0;
 }
 
-void
+/*
+ * Appends 'outlen' bytes, cut short if the buffer is full. 'len' is
+ * the width of the line after the last newline in display columns,
+ * not counting the bytes at all if 'nolen' is set.
+ */
+static void
 dump(struct fmtbuf *fb, const char *out, size_t outlen, int nolen)
 {
 	size_t i;
 
-	for (i = 0; i < outlen; i++) {
-		if (out[i] == '\n')
-			fb->len = 0;
-		else if (!nolen)
-			fb->len++;
-		fb->outbuf[fb->j++] = out[i];
-	}
+	if (outlen > sizeof(fb->outbuf) - fb->j - 1)
+		outlen = sizeof(fb->outbuf) - fb->j - 1;
+
+	memcpy(&fb->outbuf[fb->j], out, outlen);
+	fb->j += outlen;
 	fb->outbuf[fb->j] = '\0';
+
+	for (i = outlen; i > 0 && out[i-1] != '\n'; i--)
+		;
+	if (i > 0)
+		fb->len = nolen ? 0 : utf8_columns(&out[i], outlen - i);
+	else if (!nolen)
+		fb->len += utf8_columns(out, outlen);
 }
 
-#include <stdio.h>
+#ifdef __SSE2__
+/*
+ * Bit i set if byte i of 'b' ends a word: NUL, white space, sentence
+ * end or punctuation.
+ */
+static inline unsigned
+word_end_mask(__m128i b)
+{
+	__m128i				 m, t;
+
+	/* '\t' to '\r' moved to the bottom of the signed range */
+	t = _mm_add_epi8(b, _mm_set1_epi8((char) (0x80 - '\t')));
+	m = _mm_cmplt_epi8(t, _mm_set1_epi8((char) (0x80 + '\r' - '\t' + 1)));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(b, _mm_setzero_si128()));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(b, _mm_set1_epi8(' ')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(b, _mm_set1_epi8('.')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(b, _mm_set1_epi8('?')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(b, _mm_set1_epi8('!')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(b, _mm_set1_epi8(',')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(b, _mm_set1_epi8(';')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(b, _mm_set1_epi8(':')));
+
+	return (unsigned) _mm_movemask_epi8(m);
+}
+#endif
+
+/*
+ * Number of bytes in 's' before the first one that ends a word or the
+ * terminating NUL, looked for 16 bytes at a time where possible.
+ */
+static NO_ASAN size_t
+word_run(const char *s)
+{
+#ifdef __SSE2__
+	const __m128i			*blk;
+	unsigned			 mask;
+	size_t				 off, n;
+
+	off = (uintptr_t) s & 15;
+	blk = (const __m128i *) (s - off);
+	if ((mask = word_end_mask(_mm_load_si128(blk)) >> off) != 0)
+		return __builtin_ctz(mask);
+
+	for (n = 16 - off, blk++; ; n += 16, blk++)
+		if ((mask = word_end_mask(_mm_load_si128(blk))) != 0)
+			return n + __builtin_ctz(mask);
+#else
+	const char			*p;
+
+	for (p = s; *p != '\0' && !word_end(*p); p++)
+		;
+	return p - s;
+#endif
+}
+
+/*
+ * Highlights the phrases of 'hl' in what is added from now on, or
+ * stops highlighting if 'hl' is NULL. The set must not be freed while
+ * it is in use.
+ */
 void
-highlight(struct fmtbuf *fb, const char **words, size_t nwords)
+highlight(struct fmtbuf *fb, const struct hlset *hl)
 {
-	fb->words = words;
-	fb->nwords = nwords;
+	fb->hl = hl;
+	fb->hlkey = hl != NULL ? hl->id : 0;
+	fb->hlstate = 0;
+	fb->hlpending = 0;
+}
 
-	{
-		size_t i;
-		for (i = 0; i < fb->nwords; i++) {
-			printf("Highlight %s\n", fb->words[i]);
-		}
+static void
+insert(struct fmtbuf *fb, size_t at, const char *s, size_t len)
+{
+	memmove(&fb->outbuf[at + len], &fb->outbuf[at], fb->j - at + 1);
+	memcpy(&fb->outbuf[at], s, len);
+	fb->j += len;
+}
+
+/*
+ * Where the output at 'pos' moved to when the pending match was
+ * colored.
+ */
+static size_t
+hl_shift(struct fmtbuf *fb, size_t pos)
+{
+	if (pos >= fb->hlend)
+		return pos + HL_ON_LEN + HL_OFF_LEN;
+	else if (pos >= fb->hlstart)
+		return pos + HL_ON_LEN;
+	else
+		return pos;
+}
+
+/*
+ * Colors the pending match now that it is known not to grow. The
+ * escapes take no room on the line, so the text already wrapped stays
+ * as it is. Returns 0 if there was no room for them.
+ */
+static int
+hl_color(struct fmtbuf *fb)
+{
+	size_t				 i;
+
+	fb->hlpending = 0;
+	if (fb->j + HL_ON_LEN + HL_OFF_LEN >= sizeof(fb->outbuf))
+		return 0;
+
+	insert(fb, fb->hlend, HL_OFF, HL_OFF_LEN);
+	insert(fb, fb->hlstart, HL_ON, HL_ON_LEN);
+
+	for (i = 0; i < HL_MAX_WORDS; i++)
+		fb->hlpos[i] = hl_shift(fb, fb->hlpos[i]);
+	if (fb->rewind_j != SIZE_MAX)
+		fb->rewind_j = hl_shift(fb, fb->rewind_j);
+	return 1;
+}
+
+/*
+ * Feeds the word just written to outbuf between 'start' and 'end' to
+ * the highlighter. A match is held back for as long as a longer
+ * phrase could still grow out of it.
+ */
+static void
+hl_word(struct fmtbuf *fb, size_t start, size_t end)
+{
+	size_t				 k, m, first;
+
+	k = fb->hlcount++;
+	fb->hlpos[k % HL_MAX_WORDS] = start;
+	fb->hlstate = hlset_step(fb->hl, fb->hlstate, fb->word, fb->wordlen,
+	    &m);
+
+	if (fb->hlpending &&
+	    fb->hl->nodes[fb->hlstate].depth < k - fb->hlfirst + 1 &&
+	    hl_color(fb))
+		end = hl_shift(fb, end);
+
+	if (m == 0)
+		return;
+	first = k + 1 - m;
+	if (!fb->hlpending || first <= fb->hlfirst) {
+		fb->hlpending = 1;
+		fb->hlfirst = first;
+		fb->hlstart = fb->hlpos[first % HL_MAX_WORDS];
+		fb->hlend = end;
 	}
 }
 
 void
 add_fmtbuf_raw(struct fmtbuf *fb, const char *src)
 {
-	while (*src != '\0') {
-		fb->outbuf[fb->j++] = *src++;
-	}
+	size_t				 n;
+
+	n = strlen(src);
+	if (n > sizeof(fb->outbuf) - fb->j - 1)
+		n = sizeof(fb->outbuf) - fb->j - 1;
+	memcpy(&fb->outbuf[fb->j], src, n);
+	fb->j += n;
 	fb->outbuf[fb->j] = '\0';
 }
 
@@ -84,18 +289,24 @@ void
 add_fmtbuf(struct fmtbuf *fb, const char *src)
 {
 	const char			*p;
-	char				 tmp[3], *out;
-	size_t				 outlen, i;
-	int				 split, end;
-	int				 match;
+	char				 tmp[3], delim;
+	char				 run[sizeof(fb->word) + 4];
+	size_t				 outlen, n, rewind, wstart, wlen;
+	uint32_t			 cp;
+	int				 end;
 
-	if (fb->len == 0) {
+	/* A word in progress has been indented already */
+	if (fb->len == 0 && fb->state != IN_WORD) {
 		dump(fb, "     ", 5, 1);
 	}
 
+	/* Phrases are matched within one add */
+	fb->hlstate = 0;
+	fb->hlcount = 0;
+	fb->hlpending = 0;
+
 	for (p = src; *p != '\0'; ) {
 		outlen = 0;
-		out = tmp;
 		switch (fb->state) {
 		case BEGIN_WORD:
 			if (*p == '\"' || *p == '\'') {
@@ -103,76 +314,89 @@ add_fmtbuf(struct fmtbuf *fb, const char *src)
 				p++;
 				break;
 			}
-			if (isspace(*p)) {
-				p++;
+			if (CT(*p, CT_SPACE)) {
+				while (CT(*++p, CT_SPACE))
+					;
 				break;
 			}
 			fb->state = IN_WORD;
 			fb->wordlen = 0;
 			/* FALLTHROUGH */
 		case IN_WORD:
-			if (!word_end(*p) && fb->wordlen + 1 <
-			    sizeof(fb->word)) {
-				fb->word[fb->wordlen++] = *p++;
-				break;
+			/* Take the rest of the word in one go */
+			n = word_run(p);
+			if (n > sizeof(fb->word) - 1 - fb->wordlen) {
+				n = sizeof(fb->word) - 1 - fb->wordlen;
+				/* Not in the middle of a character */
+				while (n > 0 && ((unsigned char) p[n] & 0xc0) == 0x80)
+					n--;
 			}
-			split = 0;
-			if (fb->len + fb->wordlen >= 65) {
+			memcpy(&fb->word[fb->wordlen], p, n);
+			fb->wordlen += n;
+			p += n;
+			if (*p == '\0')
+				break;
+			if (fb->len + utf8_columns(fb->word, fb->wordlen) >=
+			    FB_WIDTH(fb)) {
 				tmp[0] = '\n';
 				outlen = 1;
-				split = 1;
 				dump(fb, tmp, outlen, 0);
 				dump(fb, "     ", 5, 1);
 			}
 			fb->word[fb->wordlen] = '\0';
+
+			/*
+			 * The word, the character that ended it and the
+			 * spacing after it go out in one piece.
+			 */
+			outlen = 0;
+			n = 0;
 			if (fb->word[0] != '\0' && fb->upper) {
-				fb->word[0] = toupper(fb->word[0]);
+				n = utf8_decode(fb->word, fb->wordlen, &cp);
+				if (n != 0)
+					outlen = utf8_encode(utf8_toupper(cp),
+					    run);
 				fb->upper = 0;
 			}
-
-			match = 0;
-			if (fb->words != NULL && fb->nwords > 0) {
-				for (i = 0; i < fb->nwords; i++) {
-					if (strcmp(fb->words[i],
-					    fb->word) == 0) {
-						match = 1;
-						break;
-					}
-				}
+			memcpy(&run[outlen], &fb->word[n], fb->wordlen - n);
+			outlen += fb->wordlen - n;
+			wstart = fb->j;
+			wlen = outlen;
+			if ((unsigned char) *p >= 0x80) {
+				/* Too long a word; the rest is another */
+				dump(fb, run, outlen, 0);
+				fb->wordlen = 0;
+				break;
 			}
-			if (match)
-				dump(fb, "\033[1;31m", 4 + 3, 1);
+			delim = *p;
+			run[outlen++] = delim;
+			rewind = fb->j + outlen - (*p == ' ');
 
-			dump(fb, fb->word, fb->wordlen, 0);
-			if (match)
-				dump(fb, "\033[0m", 4, 1);
-
-			tmp[0] = *p;
-			outlen = 1;
-			dump(fb, tmp, outlen, 0);
-			if (fb->j > 0 && fb->outbuf[fb->j-1] == ' ')
-				fb->rewind_j = fb->j-1;
-			else
-				fb->rewind_j = fb->j;
-
-			outlen = 0;
 			end = sentence_end(*p);
 			if (end)
 				fb->upper = 1;
 			if (*(p+1) != '\0' &&
 				(*(p+1) == '\"' || *(p+1) == '\'')) {
 				if (end) {
-					tmp[outlen++] = *++p;
-					tmp[outlen++] = ' ';
-					tmp[outlen++] = ' ';
+					run[outlen++] = *++p;
+					run[outlen++] = ' ';
+					run[outlen++] = ' ';
 				}
 			} else if (end) {
-				tmp[outlen++] = ' ';
-				tmp[outlen++] = ' ';
-			} else if (!isspace(*p)) {
-				tmp[outlen++] = ' ';
+				run[outlen++] = ' ';
+				run[outlen++] = ' ';
+			} else if (!CT(*p, CT_SPACE)) {
+				run[outlen++] = ' ';
+			}
+			dump(fb, run, outlen, 0);
+			fb->rewind_j = rewind < fb->j ? rewind : fb->j;
+			if (fb->hl != NULL && !fb->nocolor) {
+				hl_word(fb, wstart, wstart + wlen < fb->j ?
+				    wstart + wlen : fb->j);
+				/* Phrases don't run over punctuation */
+				if (end || punct(delim))
+					fb->hlstate = 0;
 			}
-			dump(fb, tmp, outlen, 0);
 			fb->state = AFTER_WORD;
 			p++;
 			break;
@@ -185,4 +409,167 @@ add_fmtbuf(struct fmtbuf *fb, const char *src)
 			break;
 		}
 	}
+
+	if (fb->hlpending)
+		hl_color(fb);
+}
+
+static struct fmtcache *
+fmtcache_slot(const char *text)
+{
+	uintptr_t			 k;
+
+	k = (uintptr_t) text;
+	k ^= k >> 17;
+	k *= 0x9e3779b1U;
+	return &fmtcache[(k >> 8) % FMTCACHE_SZ];
+}
+
+/*
+ * Like add_fmtbuf(), for texts that stay unchanged at the same address
+ * until passed to fmtcache_invalidate(). Repeated adds in the same
+ * formatting state are a copy of the earlier output.
+ */
+void
+add_fmtbuf_text(struct fmtbuf *fb, const char *text)
+{
+	struct fmtcache			*c;
+	size_t				 j0, len_in, outlen, rewind_j;
+	int				 state_in, upper_in;
+	char				*out;
+
+	/* A half-done word would continue into the text */
+	if (fb->state == IN_WORD) {
+		add_fmtbuf(fb, text);
+		return;
+	}
+
+	c = fmtcache_slot(text);
+	if (c->text == text && c->width == FB_WIDTH(fb) &&
+	    c->nocolor == fb->nocolor && c->hlkey == fb->hlkey && c->len_in == fb->len &&
+	    c->state_in == fb->state && c->upper_in == fb->upper &&
+	    fb->j + c->outlen < sizeof(fb->outbuf)) {
+		memcpy(&fb->outbuf[fb->j], c->out, c->outlen);
+		if (c->rewind_set)
+			fb->rewind_j = fb->j + c->rewind_off;
+		fb->j += c->outlen;
+		fb->outbuf[fb->j] = '\0';
+		fb->len = c->len_out;
+		fb->state = c->state_out;
+		fb->upper = c->upper_out;
+		return;
+	}
+
+	j0 = fb->j;
+	len_in = fb->len;
+	state_in = fb->state;
+	upper_in = fb->upper;
+	rewind_j = fb->rewind_j;
+	fb->rewind_j = SIZE_MAX;
+	add_fmtbuf(fb, text);
+	c->rewind_set = fb->rewind_j != SIZE_MAX;
+	if (!c->rewind_set)
+		fb->rewind_j = rewind_j;
+
+	/* Output cut short by a full buffer is not the whole text */
+	outlen = fb->j - j0;
+	if (fb->state == IN_WORD || outlen > FMTCACHE_MAX ||
+	    fb->j >= sizeof(fb->outbuf) - 1) {
+		c->text = NULL;
+		return;
+	}
+	if (outlen > c->alloc) {
+		if ((out = realloc(c->out, outlen)) == NULL) {
+			c->text = NULL;
+			return;
+		}
+		if (c->alloc != 0)
+			mem_dec(MEM_OUTPUT, c->alloc);
+		mem_inc(MEM_OUTPUT, outlen);
+		c->out = out;
+		c->alloc = outlen;
+	}
+	memcpy(c->out, &fb->outbuf[j0], outlen);
+	c->text = text;
+	c->width = FB_WIDTH(fb);
+	c->nocolor = fb->nocolor;
+	c->hlkey = fb->hlkey;
+	c->len_in = len_in;
+	c->state_in = state_in;
+	c->upper_in = upper_in;
+	c->outlen = outlen;
+	c->len_out = fb->len;
+	c->state_out = fb->state;
+	c->upper_out = fb->upper;
+	c->rewind_off = c->rewind_set ? fb->rewind_j - j0 : 0;
+}
+
+/*
+ * Must be called before a text given to add_fmtbuf_text() is changed
+ * or freed.
+ */
+void
+fmtcache_invalidate(const char *text)
+{
+	struct fmtcache			*c;
+
+	if (text == NULL)
+		return;
+
+	c = fmtcache_slot(text);
+	if (c->text == text)
+		c->text = NULL;
+}
+
+/*
+ * Likewise for all the texts in the 'len' bytes at 'base'.
+ */
+void
+fmtcache_invalidate_range(const char *base, size_t len)
+{
+	size_t				 i;
+
+	for (i = 0; i < FMTCACHE_SZ; i++)
+		if (fmtcache[i].text >= base &&
+		    fmtcache[i].text < base + len)
+			fmtcache[i].text = NULL;
+}
+
+#ifdef TEST
+#include <err.h>
+#include <stdio.h>
+
+static const char *text = "A narrow passage leads north between "
+    "walls of rough granite.  Water drips from the ceiling and gathers "
+    "in shallow pools on the stone floor, and the air smells of moss.";
+
+int
+main(int argc, char *argv[])
+{
+	static struct fmtbuf		 a, b, c;
+	char				 fill[8097];
+
+	/* Nearly full, so that the text is cut short */
+	memset(fill, 'x', sizeof(fill) - 1);
+	fill[sizeof(fill) - 1] = '\0';
+	add_fmtbuf_raw(&a, fill);
+	add_fmtbuf_text(&a, text);
+	if (a.j != sizeof(a.outbuf) - 1)
+		errx(1, "not cut short: %zu", a.j);
+
+	/* A later empty buffer must get all of it */
+	add_fmtbuf_text(&b, text);
+	add_fmtbuf(&c, text);
+	if (b.j != c.j || strcmp(b.outbuf, c.outbuf) != 0)
+		errx(1, "cut short output served: \"%s\"", b.outbuf);
+
+	/* And the whole output is cached for the next one */
+	memset(&b, 0, sizeof(b));
+	add_fmtbuf_text(&b, text);
+	if (b.j != c.j || strcmp(b.outbuf, c.outbuf) != 0)
+		errx(1, "cached output differs: \"%s\"", b.outbuf);
+
+	printf("ok\n");
+	return 0;
 }
+#endif
@@ -20,6 +20,13 @@
 #define FMTBUF_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+#include "hlset.h"
+
+#define FMT_WIDTH	65
+#define FB_WIDTH(_fb) \
+	((_fb)->width != 0 ? (_fb)->width : FMT_WIDTH)
 
 enum fmtbuf_state {
 	BEGIN_WORD=0, IN_WORD, AFTER_WORD
@@ -34,18 +41,33 @@ struct fmtbuf {
 	size_t				 len;
 	int				 state;
 	int				 upper;
-	const char			**words;
-	size_t				 nwords;
+	const struct hlset		*hl;
+	uint32_t			 hlkey;		/* Id of 'hl' */
+	uint32_t			 hlstate;
+	size_t				 hlcount;	/* Words matched */
+	size_t				 hlpos[HL_MAX_WORDS];	/* Their starts */
+	size_t				 hlfirst;	/* Pending match */
+	size_t				 hlstart;
+	size_t				 hlend;
+	int				 hlpending;
+	size_t				 width;		/* 0 for FMT_WIDTH */
+	int				 nocolor;
 };
 
 void
-highlight(struct fmtbuf *fb, const char **words, size_t nwords);
+highlight(struct fmtbuf *fb, const struct hlset *hl);
 
 void add_fmtbuf_raw(struct fmtbuf *fb, const char *src);
 
 void
 add_fmtbuf(struct fmtbuf *fb, const char *src);
 void
+add_fmtbuf_text(struct fmtbuf *fb, const char *text);
+void
+fmtcache_invalidate(const char *text);
+void
+fmtcache_invalidate_range(const char *base, size_t len);
+void
 end_fmtbuf(struct fmtbuf *fb);
 
 #endif
@@ -0,0 +1,387 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "hlset.h"
+#include "mem.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HL_WORD_MAX	63	/* As formatted by add_fmtbuf() */
+#define HL_NONE		UINT32_MAX
+
+static uint32_t				 _next_id;
+
+static uint32_t
+fold_hash(const char *s, size_t len)
+{
+	uint32_t			 h;
+	size_t				 i;
+
+	h = 2166136261U;
+	for (i = 0; i < len; i++)
+		h = (h ^ (unsigned char) tolower((unsigned char) s[i])) *
+		    16777619U;
+	return h;
+}
+
+static uint32_t
+edge_hash(uint32_t from, uint32_t wid)
+{
+	uint32_t			 h;
+
+	h = from * 0x9e3779b1U ^ wid * 0x85ebca6bU;
+	return h ^ (h >> 15);
+}
+
+static uint32_t
+word_find(const struct hlset *hl, const char *s, size_t len)
+{
+	const struct hlword		*w;
+	const char			*p;
+	uint32_t			 h;
+	size_t				 k, i;
+
+	h = fold_hash(s, len);
+	for (k = h & hl->wmask; (w = &hl->words[k])->len != 0;
+	    k = (k + 1) & hl->wmask) {
+		if (w->hash != h || w->len != len)
+			continue;
+		p = &hl->pool[w->off];
+		for (i = 0; i < len; i++)
+			if (p[i] != tolower((unsigned char) s[i]))
+				break;
+		if (i == len)
+			return k;
+	}
+
+	return HL_NONE;
+}
+
+static uint32_t
+word_intern(struct hlset *hl, const char *s, size_t len)
+{
+	struct hlword			*w;
+	uint32_t			 k;
+	size_t				 i;
+
+	if ((k = word_find(hl, s, len)) != HL_NONE)
+		return k;
+
+	for (k = fold_hash(s, len) & hl->wmask; hl->words[k].len != 0;
+	    k = (k + 1) & hl->wmask)
+		;
+	w = &hl->words[k];
+	w->hash = fold_hash(s, len);
+	w->off = hl->poollen;
+	w->len = len;
+	for (i = 0; i < len; i++)
+		hl->pool[hl->poollen++] = tolower((unsigned char) s[i]);
+
+	return k;
+}
+
+static uint32_t
+edge_find(const struct hlset *hl, uint32_t from, uint32_t wid)
+{
+	const struct hledge		*e;
+	size_t				 k;
+
+	for (k = edge_hash(from, wid) & hl->emask;
+	    (e = &hl->edges[k])->to != 0; k = (k + 1) & hl->emask)
+		if (e->from == from && e->wid == wid)
+			return e->to;
+
+	return 0;
+}
+
+static void
+edge_add(struct hlset *hl, uint32_t from, uint32_t wid, uint32_t to)
+{
+	size_t				 k;
+
+	for (k = edge_hash(from, wid) & hl->emask; hl->edges[k].to != 0;
+	    k = (k + 1) & hl->emask)
+		;
+	hl->edges[k].from = from;
+	hl->edges[k].wid = wid;
+	hl->edges[k].to = to;
+}
+
+/*
+ * Number of words in 'phrase' and their total length in '*chars'.
+ * Returns 0 if the phrase can never match because it has too many or
+ * too long words.
+ */
+static size_t
+phrase_words(const char *phrase, size_t *chars)
+{
+	const char			*p, *q;
+	size_t				 n;
+
+	*chars = 0;
+	for (n = 0, p = phrase; ; p = q) {
+		while (isspace((unsigned char) *p))
+			p++;
+		if (*p == '\0')
+			break;
+		for (q = p; *q != '\0' && !isspace((unsigned char) *q); q++)
+			;
+		if (q - p > HL_WORD_MAX || ++n > HL_MAX_WORDS)
+			return 0;
+		*chars += q - p;
+	}
+
+	return n;
+}
+
+static size_t
+table_size(size_t n)
+{
+	size_t				 sz;
+
+	for (sz = 8; sz < n * 2; sz *= 2)
+		;
+	return sz;
+}
+
+/*
+ * Compiles the 'n' phrases in 'phrases'. Words in a phrase are
+ * separated by white space.
+ */
+struct hlset *
+hlset_new(const char **phrases, size_t n)
+{
+	struct hlset			*hl;
+	struct hlnode			*nd;
+	struct hledge			*e;
+	const char			*p, *q;
+	uint32_t			 cur, to, wid, f, g;
+	size_t				 i, k, nw, chars, total, bytes, d;
+
+	for (i = 0, nw = 0, bytes = 0; i < n; i++)
+		if (phrases[i] != NULL) {
+			nw += phrase_words(phrases[i], &chars);
+			bytes += chars;
+		}
+
+	if ((hl = calloc(1, sizeof(*hl))) == NULL)
+		return NULL;
+	hl->wmask = table_size(nw) - 1;
+	hl->emask = table_size(nw) - 1;
+	hl->words = calloc(hl->wmask + 1, sizeof(*hl->words));
+	hl->edges = calloc(hl->emask + 1, sizeof(*hl->edges));
+	hl->nodes = calloc(nw + 1, sizeof(*hl->nodes));
+	hl->pool = malloc(bytes + 1);
+	if (hl->words == NULL || hl->edges == NULL || hl->nodes == NULL ||
+	    hl->pool == NULL) {
+		free(hl->words);
+		free(hl->edges);
+		free(hl->nodes);
+		free(hl->pool);
+		free(hl);
+		return NULL;
+	}
+	if (++_next_id == 0)
+		_next_id = 1;
+	hl->id = _next_id;
+	hl->nnodes = 1;
+
+	/* The trie */
+	for (i = 0; i < n; i++) {
+		if (phrases[i] == NULL || phrase_words(phrases[i], &chars) == 0)
+			continue;
+		cur = 0;
+		for (p = phrases[i]; ; p = q) {
+			while (isspace((unsigned char) *p))
+				p++;
+			if (*p == '\0')
+				break;
+			for (q = p; *q != '\0' && !isspace((unsigned char) *q);
+			    q++)
+				;
+			wid = word_intern(hl, p, q - p);
+			if ((to = edge_find(hl, cur, wid)) == 0) {
+				to = hl->nnodes++;
+				hl->nodes[to].depth = hl->nodes[cur].depth + 1;
+				edge_add(hl, cur, wid, to);
+			}
+			cur = to;
+		}
+		hl->nodes[cur].out = hl->nodes[cur].depth;
+	}
+
+	/*
+	 * Failure links, shallowest nodes first so that the link of a
+	 * node's parent is always done.
+	 */
+	for (d = 1; d <= HL_MAX_WORDS; d++)
+		for (k = 0; k <= hl->emask; k++) {
+			e = &hl->edges[k];
+			if (e->to == 0 || hl->nodes[e->to].depth != d)
+				continue;
+			nd = &hl->nodes[e->to];
+			g = 0;
+			if (e->from != 0) {
+				for (f = hl->nodes[e->from].fail;
+				    (g = edge_find(hl, f, e->wid)) == 0 && f != 0;
+				    f = hl->nodes[f].fail)
+					;
+			}
+			nd->fail = g;
+			if (hl->nodes[g].out > nd->out)
+				nd->out = hl->nodes[g].out;
+		}
+
+	total = sizeof(*hl) + (hl->wmask + 1) * sizeof(*hl->words) +
+	    (hl->emask + 1) * sizeof(*hl->edges) +
+	    (nw + 1) * sizeof(*hl->nodes) + bytes + 1;
+	mem_inc(MEM_INDEX, total);
+	hl->bytes = total;
+	return hl;
+}
+
+void
+hlset_free(struct hlset *hl)
+{
+	if (hl == NULL)
+		return;
+
+	mem_dec(MEM_INDEX, hl->bytes);
+	free(hl->words);
+	free(hl->edges);
+	free(hl->nodes);
+	free(hl->pool);
+	free(hl);
+}
+
+/*
+ * Moves from 'state' on the next word of the text. '*match' is set to
+ * the number of words in the longest phrase ending at the word, or 0.
+ */
+uint32_t
+hlset_step(const struct hlset *hl, uint32_t state, const char *word,
+    size_t len, size_t *match)
+{
+	uint32_t			 wid, to;
+
+	*match = 0;
+	if ((wid = word_find(hl, word, len)) == HL_NONE)
+		return 0;
+
+	while ((to = edge_find(hl, state, wid)) == 0 && state != 0)
+		state = hl->nodes[state].fail;
+
+	*match = hl->nodes[to].out;
+	return to;
+}
+
+#ifdef TEST
+#include <err.h>
+#include <stdio.h>
+#include <strings.h>
+
+#define NPHRASES	12
+#define NTEXT		64
+
+static const char		*vocab[] = {
+	"north", "Door", "old", "oak", "x", "the", "zzz"
+};
+#define NVOCAB		(sizeof(vocab) / sizeof(vocab[0]))
+
+/*
+ * Words in the longest phrase that ends at text word 'i', found by
+ * comparing every phrase there.
+ */
+static size_t
+naive_match(char phr[][HL_MAX_WORDS][8], size_t *nphr, size_t nphrases,
+    char text[][8], size_t i)
+{
+	size_t				 p, j, n, best;
+
+	best = 0;
+	for (p = 0; p < nphrases; p++) {
+		if ((n = nphr[p]) == 0 || n > i + 1 || n <= best)
+			continue;
+		for (j = 0; j < n; j++)
+			if (strcasecmp(phr[p][j], text[i + 1 - n + j]) != 0)
+				break;
+		if (j == n)
+			best = n;
+	}
+	return best;
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct hlset			*hl;
+	char				 phr[NPHRASES][HL_MAX_WORDS][8];
+	char				 text[NTEXT][8];
+	char				 buf[NPHRASES][128];
+	const char			*phrases[NPHRASES];
+	size_t				 nphr[NPHRASES], i, j, k, round, m;
+	size_t				 len;
+	uint32_t			 state;
+
+	srand(1);
+	for (round = 0; round < 2000; round++) {
+		/* Phrases of the vocabulary but its last word */
+		for (i = 0; i < NPHRASES; i++) {
+			nphr[i] = rand() % 5;
+			for (j = 0, len = 0; j < nphr[i]; j++) {
+				snprintf(phr[i][j], sizeof(phr[i][j]), "%s",
+				    vocab[rand() % (NVOCAB - 1)]);
+				len += snprintf(buf[i] + len,
+				    sizeof(buf[i]) - len, "%s%s",
+				    j == 0 ? "" : rand() % 2 ? " " : "  \t",
+				    phr[i][j]);
+			}
+			buf[i][len] = '\0';
+			phrases[i] = rand() % 8 == 0 ? NULL : buf[i];
+			if (phrases[i] == NULL)
+				nphr[i] = 0;
+		}
+		if ((hl = hlset_new(phrases, NPHRASES)) == NULL)
+			errx(1, "hlset_new");
+
+		for (i = 0; i < NTEXT; i++) {
+			snprintf(text[i], sizeof(text[i]), "%s",
+			    vocab[rand() % NVOCAB]);
+			for (k = 0; text[i][k] != '\0'; k++)
+				if (rand() % 3 == 0)
+					text[i][k] = toupper(
+					    (unsigned char) text[i][k]);
+		}
+		state = 0;
+		for (i = 0; i < NTEXT; i++) {
+			state = hlset_step(hl, state, text[i],
+			    strlen(text[i]), &m);
+			if (m != naive_match(phr, nphr, NPHRASES, text, i))
+				errx(1, "round %zu, word %zu (%s): match %zu, "
+				    "want %zu", round, i, text[i], m,
+				    naive_match(phr, nphr, NPHRASES, text, i));
+		}
+		hlset_free(hl);
+	}
+
+	printf("ok\n");
+	return 0;
+}
+#endif
@@ -0,0 +1,77 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef HLSET_H
+#define HLSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HL_MAX_WORDS	8	/* Words in the longest phrase */
+
+/*
+ * A compiled set of phrases to highlight, matched a word at a time
+ * without regard to case. It is an Aho-Corasick automaton over words:
+ * every distinct word gets an id, and the trie edges and words are
+ * found by hashing, so each step costs the same however many phrases
+ * there are.
+ */
+struct hlword {
+	uint32_t			 hash;
+	uint32_t			 off;		/* In 'pool' */
+	uint32_t			 len;		/* 0 if free */
+};
+
+struct hledge {
+	uint32_t			 from;
+	uint32_t			 wid;
+	uint32_t			 to;		/* 0 if free */
+};
+
+struct hlnode {
+	uint32_t			 fail;
+	uint16_t			 depth;
+	uint16_t			 out;		/* Longest match, in words */
+};
+
+struct hlset {
+	uint32_t			 id;
+	struct hlword			*words;
+	size_t				 wmask;
+	struct hledge			*edges;
+	size_t				 emask;
+	struct hlnode			*nodes;
+	size_t				 nnodes;
+	char				*pool;
+	size_t				 poollen;
+	size_t				 bytes;		/* Memory used */
+};
+
+struct hlset				*hlset_new(
+					    const char **,
+					    size_t);
+void					 hlset_free(
+					    struct hlset *);
+uint32_t				 hlset_step(
+					    const struct hlset *,
+					    uint32_t,
+					    const char *,
+					    size_t,
+					    size_t *);
+
+#endif
@@ -90,15 +90,23 @@ event_add_evsrc(struct event *ev, struct evsrc *evsrc)
 	return 0;
 }
 
+/*
+ * Waits at most 'timeout' milliseconds for events, or until there is
+ * one if 'timeout' is negative.
+ */
 int
-event_dispatch(struct event *ev)
+event_dispatch(struct event *ev, int timeout)
 {
 	struct kevent event[QUEUE_DEPTH];
 	struct kevent *evp;
+	struct timespec ts;
 	int i, nevents;
 	struct evsrc *evsrc;
 
-	nevents = kevent(ev->kq, NULL, 0, event, QUEUE_DEPTH, NULL);
+	ts.tv_sec = timeout / 1000;
+	ts.tv_nsec = (timeout % 1000) * 1000000L;
+	nevents = kevent(ev->kq, NULL, 0, event, QUEUE_DEPTH,
+	    timeout >= 0 ? &ts : NULL);
 	if (nevents == -1)
 		return -1;
 
@@ -155,7 +163,7 @@ main(int argc, char *argv[])
 		err(1, "event_add_evsrc");
 
 	for (;;)
-		if (event_dispatch(ev) == -1)
+		if (event_dispatch(ev, -1) == -1)
 			err(1, "event_dispatch");
 	
 	event_free(ev);
@@ -0,0 +1,541 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Loads the world from files in the format room_save() writes. Each
+ * file is read through mmap(2) and parsed into a list of records, and
+ * when there are several files they are parsed in parallel. The
+ * records are then applied in file order in the main thread, as
+ * nothing else of the world is safe to touch from others, and nobody
+ * is told of the changes. Last the exits are resolved, which creates
+ * the rooms they lead to that no file described.
+ *
+ * A line the parser does not know is run as a command by a digger
+ * player standing in the current room, as every line once was.
+ */
+
+#include "loader.h"
+#include "object.h"
+#include "player.h"
+#include "room.h"
+#include "action.h"
+#include "tag.h"
+#include "args.h"
+#include "utf8.h"
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <err.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NOARG		SIZE_MAX
+
+enum rec_type {
+	REC_GOTO,		/* key */
+	REC_RTAG,		/* tag */
+	REC_EXIT,		/* key, target */
+	REC_TITLE,		/* text */
+	REC_TEXT,		/* exit key, text */
+	REC_VARIANT,		/* exit key or NOARG, condition, text */
+	REC_ACTION,		/* name, source */
+	REC_COMMAND		/* line */
+};
+
+/*
+ * Arguments are offsets to the string pool of the file, as the pool
+ * moves while it grows.
+ */
+struct rec {
+	enum rec_type			 type;
+	DescType			 desc;
+	size_t				 line;
+	size_t				 arg[3];
+};
+
+struct wfile {
+	const char			*path;
+	struct rec			*recs;
+	size_t				 nrecs;
+	size_t				 alloc;
+	char				*pool;
+	size_t				 poolsz;
+	size_t				 poolalloc;
+	char				*cmd;		/* Line being built */
+	size_t				 cmdlen;
+	size_t				 cmdalloc;
+	int				 error;
+};
+
+struct loader {
+	struct wfile			*files;
+	size_t				 nfiles;
+	_Atomic size_t			 next;		/* File to parse */
+	ObjHandle			 room;		/* Current room */
+	ObjHandle			*dug;		/* Rooms with new exits */
+	size_t				 ndug;
+	size_t				 dugalloc;
+	struct player			*digger;
+};
+
+static int
+grow(void *pp, size_t *alloc, size_t want, size_t size)
+{
+	void				*p;
+	size_t				 n;
+
+	if (want <= *alloc)
+		return 0;
+	for (n = *alloc == 0 ? 64 : *alloc; n < want; n *= 2)
+		;
+	if ((p = realloc(*(void **) pp, n * size)) == NULL)
+		return -1;
+	*(void **) pp = p;
+	*alloc = n;
+	return 0;
+}
+
+static int
+cmd_append(struct wfile *f, const char *s, size_t len)
+{
+	if (grow(&f->cmd, &f->cmdalloc, f->cmdlen + len + 1, 1) == -1)
+		return -1;
+	memcpy(&f->cmd[f->cmdlen], s, len);
+	f->cmdlen += len;
+	f->cmd[f->cmdlen] = '\0';
+	return 0;
+}
+
+static size_t
+off(struct wfile *f, const char *s)
+{
+	return s != NULL ? (size_t) (s - f->pool) : NOARG;
+}
+
+/*
+ * Splits off a leading "tag:COND" from 's' like describe does; returns
+ * the condition and points '*rest' past it, or NULL if there is none.
+ */
+static char *
+split_cond(char *s, char **rest)
+{
+	char				*p;
+
+	*rest = s;
+	if (s == NULL || strncmp(s, "tag:", 4) != 0)
+		return NULL;
+	if ((p = strchr(s, ' ')) != NULL)
+		*p++ = '\0';
+	*rest = p;
+	return s + 4;
+}
+
+/*
+ * Recognizes the lines room_save() writes in 's', a copy of the line
+ * in the pool, the way the commands would take them apart. Anything
+ * else is left to be run as a command.
+ */
+static enum rec_type
+classify(struct wfile *f, char *s, struct rec *r)
+{
+	char				*v[3], *verb, *cond, *text;
+	size_t				 argc;
+
+	r->arg[0] = r->arg[1] = r->arg[2] = NOARG;
+	verb = s;
+	if ((s = strchr(s, ' ')) == NULL)
+		return REC_COMMAND;
+	*s++ = '\0';
+
+	if (strcmp(verb, "goto") == 0) {
+		r->arg[0] = off(f, s);
+		return REC_GOTO;
+	} else if (strcmp(verb, "set") == 0) {
+		if (parse_args(s, v, 2) < 2 || strcmp(v[0], "rtag") != 0)
+			return REC_COMMAND;
+		r->arg[0] = off(f, v[1]);
+		return REC_RTAG;
+	} else if (strcmp(verb, "dig") == 0) {
+		if (parse_args(s, v, 3) < 3 || strncmp(v[0], "to:", 3) != 0 ||
+		    strchr(v[0], '?') != NULL || strchr(v[1], '?') != NULL ||
+		    *v[1] == '\0' || *v[2] != '-')
+			return REC_COMMAND;
+		r->arg[0] = off(f, v[1]);
+		r->arg[1] = off(f, &v[0][3]);
+		return REC_EXIT;
+	} else if (strcmp(verb, "action") == 0) {
+		if (parse_args(s, v, 2) < 2 || *v[0] == '\0' ||
+		    *v[1] == '\0' || strcmp(v[1], "-") == 0)
+			return REC_COMMAND;
+		r->arg[0] = off(f, v[0]);
+		r->arg[1] = off(f, v[1]);
+		return REC_ACTION;
+	} else if (strcmp(verb, "describe") != 0)
+		return REC_COMMAND;
+
+	if (parse_args(s, v, 2) < 2)
+		return REC_COMMAND;
+	if (strcmp(v[0], "title") == 0) {
+		cond = split_cond(v[1], &text);
+		if (text == NULL)
+			return REC_COMMAND;
+		r->desc = DESC_TITLE;
+		if (cond == NULL) {
+			r->arg[0] = off(f, text);
+			return REC_TITLE;
+		}
+		r->arg[1] = off(f, cond);
+		r->arg[2] = off(f, text);
+		return REC_VARIANT;
+	}
+	if (strcmp(v[0], "travel") == 0)
+		r->desc = DESC_ENTER;
+	else if (strcmp(v[0], "exit") == 0)
+		r->desc = DESC_EXIT;
+	else
+		return REC_COMMAND;
+	argc = parse_args(v[1], &v[1], 2);
+	if (argc < 2)
+		return REC_COMMAND;
+	cond = split_cond(v[2], &text);
+	if (text == NULL)
+		return REC_COMMAND;
+	r->arg[0] = off(f, v[1]);
+	if (cond == NULL) {
+		r->arg[1] = off(f, text);
+		return REC_TEXT;
+	}
+	r->arg[1] = off(f, cond);
+	r->arg[2] = off(f, text);
+	return REC_VARIANT;
+}
+
+/*
+ * Adds a record of the command built in f->cmd.
+ */
+static int
+add_record(struct wfile *f, size_t line)
+{
+	struct rec			*r;
+	size_t				 o;
+
+	if (grow(&f->recs, &f->alloc, f->nrecs + 1, sizeof(*r)) == -1 ||
+	    grow(&f->pool, &f->poolalloc, f->poolsz + f->cmdlen + 1,
+	    1) == -1)
+		return -1;
+	o = f->poolsz;
+	memcpy(&f->pool[o], f->cmd, f->cmdlen + 1);
+	f->poolsz += f->cmdlen + 1;
+
+	r = &f->recs[f->nrecs++];
+	r->line = line;
+	if ((r->type = classify(f, &f->pool[o], r)) == REC_COMMAND) {
+		memcpy(&f->pool[o], f->cmd, f->cmdlen + 1);
+		r->arg[0] = o;
+	}
+	return 0;
+}
+
+/*
+ * Goes through the lines as player_input() would, here-documents
+ * included, but with no limit on the length of a line.
+ */
+static int
+parse(struct wfile *f, const char *p, const char *end)
+{
+	const char			*eol, *s;
+	size_t				 len, line, start, nhere;
+	int				 here = 0;
+
+	start = nhere = 0;
+	for (line = 1; p < end; line++, p = eol + 1) {
+		if ((eol = memchr(p, '\n', end - p)) == NULL)
+			eol = end;
+		for (s = p; s < eol && CT(*s, CT_SPACE); s++)
+			;
+		len = eol - s;
+		if (len > 0 && s[len-1] == '\r')
+			len--;
+
+		if (len >= 2 && s[len-1] == '<' && s[len-2] == ' ') {
+			f->cmdlen = 0;
+			if (cmd_append(f, s, len - 1) == -1)
+				return -1;
+			here = 1;
+			nhere = 0;
+			start = line;
+		} else if (here && len == 1 && *s == '.') {
+			here = 0;
+			if (add_record(f, start) == -1)
+				return -1;
+		} else if (here) {
+			if ((nhere++ > 0 && cmd_append(f, " ", 1) == -1) ||
+			    cmd_append(f, s, len) == -1)
+				return -1;
+		} else if (len > 0) {
+			f->cmdlen = 0;
+			if (cmd_append(f, s, len) == -1 ||
+			    add_record(f, line) == -1)
+				return -1;
+		}
+	}
+	if (here)
+		warnx("%s:%zu: here-document not ended", f->path, start);
+	return 0;
+}
+
+static void
+parse_file(struct wfile *f)
+{
+	struct stat			 st;
+	void				*base;
+	int				 fd;
+
+	if ((fd = open(f->path, O_RDONLY)) == -1) {
+		warn("%s", f->path);
+		f->error = 1;
+		return;
+	}
+	if (fstat(fd, &st) == -1) {
+		warn("%s", f->path);
+		f->error = 1;
+	} else if (st.st_size > 0) {
+		base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (base == MAP_FAILED) {
+			warn("%s", f->path);
+			f->error = 1;
+		} else {
+			posix_madvise(base, st.st_size, POSIX_MADV_SEQUENTIAL);
+			if (parse(f, base, (char *) base + st.st_size) == -1) {
+				warn("%s", f->path);
+				f->error = 1;
+			}
+			munmap(base, st.st_size);
+		}
+	}
+	close(fd);
+}
+
+static void *
+parse_thread(void *arg)
+{
+	struct loader			*ld = arg;
+	size_t				 i;
+
+	while ((i = atomic_fetch_add(&ld->next, 1)) < ld->nfiles)
+		parse_file(&ld->files[i]);
+	return NULL;
+}
+
+static struct room *
+current_room(struct loader *ld)
+{
+	struct object			*obj;
+
+	if ((obj = object_deref(ld->room)) == NULL) {
+		obj = object_find("room/1");
+		ld->room = object_handle(obj);
+	}
+	return obj != NULL && IS_ROOM(obj) ? ROOM(obj) : NULL;
+}
+
+/*
+ * Looks up the target of every exit added so far, which creates the
+ * rooms that do not exist yet.
+ */
+static void
+resolve(struct loader *ld)
+{
+	struct object			*obj;
+	size_t				 i, j;
+
+	for (i = 0; i < ld->ndug; i++) {
+		if ((obj = object_deref(ld->dug[i])) == NULL ||
+		    !IS_ROOM(obj))
+			continue;
+		for (j = 0; j < ROOM(obj)->nexits; j++)
+			room_exit_object(ROOM(obj), j);
+	}
+	ld->ndug = 0;
+}
+
+/*
+ * Runs 'line' as a command of the digger. Exits are resolved first, so
+ * that the rooms they lead to are taken when new ones are numbered.
+ */
+static void
+run_command(struct loader *ld, char *line)
+{
+	struct object			*env;
+
+	resolve(ld);
+	if (ld->digger == NULL &&
+	    (ld->digger = player_new(object_create("player/digger"))) == NULL)
+		err(1, "player_new");
+	if ((env = object_deref(ld->room)) == NULL)
+		env = object_find("room/1");
+	if (PPARENT(ld->digger) != env)
+		object_reparent(OBJ(ld->digger), env);
+	player_input(ld->digger, line);
+	ld->room = object_handle(PPARENT(ld->digger));
+}
+
+static void
+apply(struct loader *ld, struct wfile *f, struct rec *r)
+{
+	struct object			*obj;
+	struct room			*room;
+	const char			*a[3], *errstr;
+	TagSet				 req, forbid;
+	Direction			 dir;
+	int				 i;
+
+	for (i = 0; i < 3; i++)
+		a[i] = r->arg[i] != NOARG ? &f->pool[r->arg[i]] : NULL;
+
+	if (r->type == REC_COMMAND) {
+		run_command(ld, &f->pool[r->arg[0]]);
+		return;
+	} else if (r->type == REC_GOTO) {
+		if ((obj = object_find(a[0])) == NULL || !IS_ROOM(obj))
+			warnx("%s:%zu: %s is not a room", f->path, r->line,
+			    a[0]);
+		else
+			ld->room = object_handle(obj);
+		return;
+	}
+
+	if ((room = current_room(ld)) == NULL) {
+		warnx("%s:%zu: not in a room", f->path, r->line);
+		return;
+	}
+	switch (r->type) {
+	case REC_RTAG:
+		if ((i = tag_intern(a[0])) == -1) {
+			warnx("%s:%zu: bad tag %s", f->path, r->line, a[0]);
+			break;
+		}
+		room->tags |= TAG_BIT(i);
+		room->flags |= ROOM_DIRTY;
+		break;
+	case REC_EXIT:
+		if ((dir = dir_parse(a[0])) != DIR_CUSTOM)
+			a[0] = dir_name(dir);
+		if (room_load_exit(room, a[0], a[1]) == -1) {
+			warnx("%s:%zu: cannot add exit %s", f->path, r->line,
+			    a[0]);
+			break;
+		}
+		if (grow(&ld->dug, &ld->dugalloc, ld->ndug + 1,
+		    sizeof(*ld->dug)) == -1)
+			err(1, "loader");
+		ld->dug[ld->ndug++] = object_handle(OBJ(room));
+		break;
+	case REC_TITLE:
+		set_title(OBJ(room), a[0]);
+		break;
+	case REC_TEXT:
+		if (room_load_text(room, r->desc, a[0], a[1]) == -1)
+			warnx("%s:%zu: no exit %s", f->path, r->line, a[0]);
+		break;
+	case REC_VARIANT:
+		if (tag_parse_cond(&f->pool[r->arg[1]], &req, &forbid,
+		    &errstr) == -1 || (req == 0 && forbid == 0)) {
+			warnx("%s:%zu: bad condition", f->path, r->line);
+			break;
+		}
+		if (a[0] != NULL && room_find_exit(room, a[0]) ==
+		    room->nexits) {
+			warnx("%s:%zu: no exit %s", f->path, r->line, a[0]);
+			break;
+		}
+		if (room_load_variant(room, r->desc, a[0], req, forbid,
+		    a[2]) == -1)
+			warnx("%s:%zu: cannot add description", f->path,
+			    r->line);
+		break;
+	case REC_ACTION:
+		if (action_set(OBJ(room), a[0], a[1], &errstr) == -1) {
+			warnx("%s:%zu: action %s: %s", f->path, r->line, a[0],
+			    errstr);
+			break;
+		}
+		room->flags |= ROOM_DIRTY;
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Loads the 'n' world files in 'paths'. Returns -1 if any of them
+ * could not be read, but loads the rest all the same.
+ */
+int
+loader_load(const char **paths, size_t n)
+{
+	struct loader			 ld;
+	pthread_t			 tid[LOADER_THREADS];
+	struct object			*obj;
+	size_t				 i, j, nthreads;
+	int				 rv = 0;
+
+	memset(&ld, 0, sizeof(ld));
+	if ((ld.files = calloc(n, sizeof(*ld.files))) == NULL)
+		err(1, "loader");
+	ld.nfiles = n;
+	for (i = 0; i < n; i++)
+		ld.files[i].path = paths[i];
+
+	/* This thread is one of the parsers as well. */
+	nthreads = n < LOADER_THREADS ? n : LOADER_THREADS;
+	for (i = 0; i + 1 < nthreads; i++)
+		if (pthread_create(&tid[i], NULL, parse_thread, &ld) != 0)
+			break;
+	parse_thread(&ld);
+	for (j = 0; j < i; j++)
+		pthread_join(tid[j], NULL);
+
+	ld.room = OBJ_HANDLE_NONE;
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < ld.files[i].nrecs; j++)
+			apply(&ld, &ld.files[i], &ld.files[i].recs[j]);
+		if (ld.files[i].error)
+			rv = -1;
+		free(ld.files[i].recs);
+		free(ld.files[i].pool);
+		free(ld.files[i].cmd);
+	}
+	resolve(&ld);
+
+	if (ld.digger != NULL) {
+		obj = OBJ(ld.digger);
+		object_free(obj);
+		player_free(ld.digger);
+	}
+	free(ld.dug);
+	free(ld.files);
+	return rv;
+}
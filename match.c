@@ -17,14 +17,61 @@
  */
 
 #include "match.h"
+#include "bktree.h"
 #include "player.h"
 #include "message.h"
+#include "utf8.h"
 
+#include <limits.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
 
+static int				 levenshtein_distance(const char *,
+					    size_t, const char *, size_t, int);
+
+/*
+ * How many characters of 'str' prefix 'opt', or 0 if it does not.
+ * A '?' ends 'str' and asks for a list.
+ */
+static int
+prefix_matches(const char *str, const char *opt, int *want_list)
+{
+	const char			*p, *q;
+	int				 matches;
+
+	if (opt == NULL)
+		return 0;
+
+	matches = 0;
+	for (p = str, q = opt; *p != '\0' && *q != '\0';) {
+		if (*p == '?') {
+			*want_list = 1;
+			break;
+		} else if (tolower(*q++) == tolower(*p++))
+			matches++;
+		else
+			return 0;
+	}
+
+	/*
+	 * If we typed longer word than expected...
+	 */
+	if (*q == '\0' && *p != '\0')
+		return 0;
+	return matches;
+}
+
+static int
+compare_strings(const void *_a, const void *_b)
+{
+	const char * const		*a = _a;
+	const char * const		*b = _b;
+
+	return strcmp(*a, *b);
+}
+
 /*
  * match_input:
  *   Match player input with available options that can be used for
@@ -47,168 +94,256 @@
  *     match_input(plr, NULL, "loak", { "look", "who", NULL }, 2);
  *     == 'Did you mean 'look?'"
  */
-struct match_result {
-	const char	*candidate;
-	int		 matches;
-	int		 dist;
-};
-
-static int				 levenshtein_distance(const char *,
-					    size_t, const char *, size_t);
-
-static int
-compare_matches(const void *_a, const void *_b)
-{
-	const struct match_result	*a = _a;
-	const struct match_result	*b = _b;
-
-	if (a->matches < b->matches)
-		return 1;
-	else if (a->matches == b->matches) {
-		if (a->candidate != NULL && b->candidate != NULL)
-			return strcmp(a->candidate, b->candidate);
-		else
-			return 0;
-	} else
-		return -1;
-}
-
-static int
-compare_levenshtein(const void *_a, const void *_b)
-{
-	const struct match_result	*a = _a;
-	const struct match_result	*b = _b;
-
-	if (a->dist > b->dist)
-		return 1;
-	else if (a->dist == b->dist) {
-		if (a->candidate != NULL && b->candidate != NULL)
-			return strcmp(a->candidate, b->candidate);
-		else
-			return 0;
-	} else
-		return -1;
-}
-
 int
 match_input(struct player *plr, const char *lstr, char *str,
     const char **opt, size_t nopt)
 {
-	struct match_result		 res[nopt];
-	size_t				 i;
-	const char			*p, *q;
-	int				 want_list;
+	const char			**ties;
+	size_t				 i, n, ntie, first;
+	int				 want_list, m, best;
 	size_t				 len;
 
 	len = strlen(str);
 	if (len == 0 || nopt == 0)
 		return -1;
 
+	/*
+	 * Only the best matches are of interest, so rather than
+	 * sorting the options just find how good the best are and
+	 * how many there are of them.
+	 */
 	want_list = 0;
+	best = 0;
+	ntie = 0;
+	first = 0;
 	for (i = 0; i < nopt; i++) {
-		p = str;
-		q = opt[i];
-		res[i].candidate = q;
-		res[i].matches = 0;
-		if (q == NULL)
-			continue;
-		while (*p != '\0' && *q != '\0') {
-			if (*p == '?') {
-				want_list = 1;
-				break;
-			} else if (tolower(*q++) == tolower(*p++)) {
-				res[i].matches++;
-			} else {
-				res[i].matches = 0;
-				break;
-			}
+		if ((m = prefix_matches(str, opt[i], &want_list)) > best) {
+			best = m;
+			ntie = 0;
 		}
-
-		/*
-		 * If we typed longer word than expected...
-		 */
-		if (*q == '\0' && *p != '\0')
-			res[i].matches = 0;
+		if (m == best && opt[i] != NULL && ntie++ == 0)
+			first = i;
 	}
 
-	qsort(res, nopt, sizeof(*res), compare_matches);
-
 	/*
-	 * Check for non-ambiguous.
+	 * Check for non-ambiguous: the only one, or the one that was
+	 * typed in full.
 	 */
-	if (!want_list && res[0].matches > 0 &&
-	    (nopt <= 1 || res[1].matches != res[0].matches ||
-	    (res[0].candidate != NULL &&
-	    (int) strlen(res[0].candidate) == res[0].matches)))
-		for (i = 0; i < nopt; i++)
-			if (res[0].candidate == opt[i])
+	if (!want_list && best > 0) {
+		if (ntie == 1)
+			return first;
+		for (i = first; i < nopt; i++)
+			if (opt[i] != NULL && (int) strlen(opt[i]) == best &&
+			    prefix_matches(str, opt[i], &want_list) == best)
 				return i;
+	}
+
+	if (!want_list && best == 0) {
+		match_suggest(plr, str, opt, nopt);
+		return -1;
+	}
 
 	/*
-	 * List ambiguous.
+	 * List ambiguous, alphabetically.
 	 */
-	if (want_list || res[0].matches > 0) {
-		for (i = 0; i < nopt; i++) {
-			if (res[0].matches == res[i].matches &&
-			    res[i].candidate != NULL)
-				tellpf(plr, "%c%s%s",
-				    toupper(res[i].candidate[0]),
-				    &res[i].candidate[1],
-				    want_list ? ".\n" : "?\n");
-		}
-	} else {
-		if (len > 10) {
-			str[0] = toupper(str[0]);
-			tellpf(plr, "%s?\n", str);
-		} else {
-			for (i = 0; i < nopt; i++) {
-				if (res[i].candidate == NULL)
-					res[i].dist = 10000;
-				else
-					res[i].dist = levenshtein_distance(
-					    res[i].candidate,
-					    strlen(res[i].candidate), str,
-					    len);
-			}
+	if ((ties = malloc(ntie * sizeof(*ties))) == NULL)
+		return -1;
+	for (i = first, n = 0; i < nopt && n < ntie; i++)
+		if (opt[i] != NULL &&
+		    prefix_matches(str, opt[i], &want_list) == best)
+			ties[n++] = opt[i];
+	qsort(ties, n, sizeof(*ties), compare_strings);
+	for (i = 0; i < n; i++)
+		tellpf(plr, "%c%s%s", toupper(ties[i][0]), &ties[i][1],
+		    want_list ? ".\n" : "?\n");
+	free(ties);
+
+	return -1;
+}
+
+/*
+ * Tells the player the word back if it is too long to be a typo.
+ */
+static int
+too_long(struct player *plr, char *str)
+{
+	if (strlen(str) <= 10)
+		return 0;
+
+	str[0] = toupper(str[0]);
+	tellpf(plr, "%s?\n", str);
+	return 1;
+}
+
+/*
+ * Tells the player what they might have meant by 'str', which matched
+ * none of 'opt': the closest option by edit distance, or just the
+ * word back if it is too long to be a typo.
+ */
+void
+match_suggest(struct player *plr, char *str, const char **opt, size_t nopt)
+{
+	struct matchpat			 pat;
+	const char			*best;
+	size_t				 i;
+	int				 d, bestd;
 
-			qsort(res, nopt, sizeof(*res), compare_levenshtein);
-			tellpf(plr, "Try %s?\n", res[0].candidate);
+	if (too_long(plr, str))
+		return;
+
+	match_prepare(&pat, str, strlen(str));
+	best = NULL;
+	bestd = INT_MAX - 1;
+	for (i = 0; i < nopt; i++) {
+		if (opt[i] == NULL)
+			continue;
+		d = match_distance(&pat, opt[i], strlen(opt[i]), bestd);
+		if (d < bestd || (d == bestd &&
+		    (best == NULL || strcmp(opt[i], best) < 0))) {
+			best = opt[i];
+			bestd = d;
 		}
 	}
+	if (best != NULL)
+		tellpf(plr, "Try %s?\n", best);
+}
 
-	return -1;
+/*
+ * Like match_suggest(), for a vocabulary indexed in 'bk'. Only words
+ * with a bit of 'mask' are suggested.
+ */
+void
+match_suggest_tree(struct player *plr, char *str, const struct bktree *bk,
+    uint32_t mask)
+{
+	struct bkhit			 hit;
+
+	if (too_long(plr, str))
+		return;
+
+	if (bktree_search(bk, str, INT_MAX - 1, mask, &hit, 1) == 1)
+		tellpf(plr, "Try %s?\n", hit.word);
 }
 
+void
+match_prepare(struct matchpat *pat, const char *str, size_t len)
+{
+	unsigned char			 c;
+	size_t				 i;
+
+	memset(pat->peq, 0, sizeof(pat->peq));
+	pat->str = str;
+	pat->len = len;
+	if (len > MATCH_PAT_MAX)
+		return;
+
+	for (i = 0; i < len; i++) {
+		c = str[i];
+		pat->peq[CT_TOLOWER(c)] |= (uint64_t) 1 << i;
+		pat->peq[CT_TOUPPER(c)] |= (uint64_t) 1 << i;
+	}
+}
+
+/*
+ * Edit distance between the prepared pattern and 'str', without regard
+ * to case, or 'bound' + 1 if it is more than 'bound'.
+ *
+ * This is Myers' bit-parallel algorithm: a column of the dynamic
+ * programming matrix is kept as bit vectors of the vertical deltas
+ * between its cells, so each character of 'str' costs a handful of
+ * word operations. Only the distance of the whole pattern is tracked,
+ * and as each character can lower it by at most one, the computation
+ * ends as soon as the rest of 'str' could not bring it within
+ * 'bound'.
+ */
+int
+match_distance(const struct matchpat *pat, const char *str, size_t len,
+    int bound)
+{
+	uint64_t			 pv, mv, ph, mh, xv, xh, eq, hb;
+	size_t				 i, m;
+	int				 score;
+
+	m = pat->len;
+	if ((m > len ? m - len : len - m) > (size_t) bound)
+		return bound + 1;
+	if (m == 0)
+		return len;
+	if (m > MATCH_PAT_MAX)
+		return levenshtein_distance(pat->str, m, str, len, bound);
+
+	hb = (uint64_t) 1 << (m - 1);
+	pv = ~(uint64_t) 0;
+	mv = 0;
+	score = m;
+	for (i = 0; i < len; i++) {
+		eq = pat->peq[(unsigned char) str[i]];
+		xv = eq | mv;
+		xh = (((eq & pv) + pv) ^ pv) | eq;
+		ph = mv | ~(xh | pv);
+		mh = pv & xh;
+		if (ph & hb)
+			score++;
+		else if (mh & hb)
+			score--;
+		ph = (ph << 1) | 1;
+		mh <<= 1;
+		pv = mh | ~(xv | ph);
+		mv = ph & xv;
+
+		if (score - (int) (len - i - 1) > bound)
+			return bound + 1;
+	}
+
+	return score > bound ? bound + 1 : score;
+}
+
+/*
+ * The plain dynamic programming edit distance, a row at a time, for
+ * patterns too long for match_distance().
+ */
 static int
-levenshtein_distance(const char *s1, size_t len1, const char *s2, size_t len2)
+levenshtein_distance(const char *s1, size_t len1, const char *s2, size_t len2,
+    int bound)
 {
-	size_t			 matrix[len1 + 1][len2 + 1];
+	size_t			*row;
 	size_t			 i, j;
-	size_t			 del, ins, sub, min;
-	char			 c1, c2;
+	size_t			 diag, up, min, rowmin;
+	unsigned char		 c1, c2;
 
-	for (i = 0; i <= len1; i++)
-		matrix[i][0] = i;
-	for (i = 0; i <= len2; i++)
-		matrix[0][i] = i;
+	if ((row = malloc((len2 + 1) * sizeof(*row))) == NULL)
+		return bound + 1;
+
+	for (j = 0; j <= len2; j++)
+		row[j] = j;
 	for (i = 1; i <= len1; i++) {
-		c1 = s1[i-1];
+		c1 = CT_TOLOWER((unsigned char) s1[i-1]);
+		diag = row[0];
+		row[0] = rowmin = i;
 		for (j = 1; j <= len2; j++) {
-			c2 = s2[j-1];
+			c2 = CT_TOLOWER((unsigned char) s2[j-1]);
+			up = row[j];
 			if (c1 == c2)
-				matrix[i][j] = matrix[i-1][j-1];
+				min = diag;
 			else {
-				del = matrix[i-1][j] + 1;
-				ins = matrix[i][j-1] + 1;
-				sub = matrix[i-1][j-1] + 1;
-				min = del;
-				if (ins < min)
-					min = ins;
-				if (sub < min)
-					min = sub;
-				matrix[i][j] = min;
+				min = diag + 1;
+				if (up + 1 < min)
+					min = up + 1;
+				if (row[j-1] + 1 < min)
+					min = row[j-1] + 1;
 			}
+			diag = up;
+			row[j] = min;
+			if (min < rowmin)
+				rowmin = min;
+		}
+		if (rowmin > (size_t) bound) {
+			free(row);
+			return bound + 1;
 		}
 	}
-	return matrix[len1][len2];
+
+	min = row[len2];
+	free(row);
+	return min > (size_t) bound ? bound + 1 : (int) min;
 }
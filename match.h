@@ -20,11 +20,33 @@
 #define MATCH_H
 
 #include <stddef.h>
+#include <stdint.h>
 
+struct bktree;
 struct player;
 
+#define MATCH_PAT_MAX	64	/* Longest pattern done bit-parallel */
+
+/*
+ * A word prepared for computing its edit distance to many others:
+ * 'peq' has, for each byte, the bits of the positions it is at.
+ */
+struct matchpat {
+	uint64_t			 peq[256];
+	const char			*str;
+	size_t				 len;
+};
+
 int				match_input(struct player *,
 				    const char *, char *,
 				    const char **, size_t);
+void				match_suggest(struct player *,
+				    char *, const char **, size_t);
+void				match_suggest_tree(struct player *,
+				    char *, const struct bktree *, uint32_t);
+void				match_prepare(struct matchpat *,
+				    const char *, size_t);
+int				match_distance(const struct matchpat *,
+				    const char *, size_t, int);
 
 #endif
@@ -0,0 +1,59 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "mem.h"
+
+static const char		*names[MAX_MEM_TYPES] = {
+	"objects", "rooms", "exits", "descriptions", "players", "input",
+	"output", "evsrc", "index"
+};
+
+static size_t			 _bytes[MAX_MEM_TYPES];
+static size_t			 _count[MAX_MEM_TYPES];
+
+void
+mem_inc(MemType type, size_t bytes)
+{
+	_bytes[type] += bytes;
+	_count[type]++;
+}
+
+void
+mem_dec(MemType type, size_t bytes)
+{
+	_bytes[type] -= bytes;
+	_count[type]--;
+}
+
+size_t
+mem_bytes(MemType type)
+{
+	return _bytes[type];
+}
+
+size_t
+mem_count(MemType type)
+{
+	return _count[type];
+}
+
+const char *
+mem_name(MemType type)
+{
+	return names[type];
+}
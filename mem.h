@@ -0,0 +1,51 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef MEM_H
+#define MEM_H
+
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Running totals of live heap memory per subsystem. Allocation sites
+ * report what they allocate and free, so the totals are always
+ * current and cost nothing to read.
+ */
+typedef enum mem_type {
+	MEM_OBJECT=0,		/* struct object, keys */
+	MEM_ROOM,		/* struct room */
+	MEM_EXIT,		/* exit tables, exit keys and targets */
+	MEM_DESC,		/* titles, descriptions */
+	MEM_PLAYER,		/* struct player */
+	MEM_INPUT,		/* read and here-document buffers */
+	MEM_OUTPUT,		/* fmtbuf and output buffers */
+	MEM_EVSRC,		/* event sources */
+	MEM_INDEX,		/* hash, handle and store index tables */
+	MAX_MEM_TYPES
+} MemType;
+
+#define MEM_STR(_s)		((_s) != NULL ? strlen((_s)) + 1 : 0)
+
+void				 mem_inc(MemType, size_t);
+void				 mem_dec(MemType, size_t);
+size_t				 mem_bytes(MemType);
+size_t				 mem_count(MemType);
+const char			*mem_name(MemType);
+
+#endif
@@ -0,0 +1,254 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "msgbuf.h"
+#include "mem.h"
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MSGQ_CHUNK	16
+#define MSGQ_IOV	64
+#define MSGQ_AMBIENT_MAX	4096
+
+struct msgbuf *
+msgbuf_new(const char *data, size_t len)
+{
+	struct msgbuf			*mb;
+
+	if ((mb = malloc(sizeof(*mb) + len)) == NULL)
+		return NULL;
+	mem_inc(MEM_OUTPUT, sizeof(*mb) + len);
+	mb->refs = 1;
+	mb->len = len;
+	memcpy(mb->data, data, len);
+
+	return mb;
+}
+
+struct msgbuf *
+msgbuf_ref(struct msgbuf *mb)
+{
+	mb->refs++;
+	return mb;
+}
+
+void
+msgbuf_release(struct msgbuf *mb)
+{
+	if (mb == NULL || --mb->refs > 0)
+		return;
+
+	mem_dec(MEM_OUTPUT, sizeof(*mb) + mb->len);
+	free(mb);
+}
+
+static int
+ring_push(struct msgring *r, struct msgbuf *mb, uint64_t seq)
+{
+	struct msgent			*ents;
+	size_t				 alloc, i;
+
+	if (r->n == r->alloc) {
+		alloc = r->alloc + MSGQ_CHUNK;
+		if ((ents = malloc(alloc * sizeof(*ents))) == NULL)
+			return -1;
+		for (i = 0; i < r->n; i++)
+			ents[i] = r->ents[(r->head + i) % r->alloc];
+		if (r->alloc > 0)
+			mem_dec(MEM_OUTPUT, r->alloc * sizeof(*ents));
+		mem_inc(MEM_OUTPUT, alloc * sizeof(*ents));
+		free(r->ents);
+		r->ents = ents;
+		r->alloc = alloc;
+		r->head = 0;
+	}
+
+	r->ents[(r->head + r->n) % r->alloc].mb = msgbuf_ref(mb);
+	r->ents[(r->head + r->n) % r->alloc].seq = seq;
+	r->n++;
+	r->bytes += mb->len;
+	return 0;
+}
+
+static struct msgbuf *
+ring_last(struct msgring *r)
+{
+	if (r->n == 0)
+		return NULL;
+	return r->ents[(r->head + r->n - 1) % r->alloc].mb;
+}
+
+/*
+ * Appends a reference to 'mb' to the queue of class 'cl'. While the
+ * client is congested, a system or ambient message repeating the one
+ * before it is collapsed into it, and ambient messages are dropped
+ * once enough of them are waiting.
+ */
+int
+msgq_push(struct msgq *q, MsgClass cl, struct msgbuf *mb)
+{
+	struct msgring			*r;
+	struct msgbuf			*last;
+
+	if (mb->len == 0)
+		return 0;
+
+	r = &q->ring[cl];
+	if (q->congested && (cl == MSG_SYSTEM || cl == MSG_AMBIENT)) {
+		last = ring_last(r);
+		if (last != NULL && (last == mb || (last->len == mb->len &&
+		    memcmp(last->data, mb->data, mb->len) == 0)))
+			return 0;
+		if (cl == MSG_AMBIENT && r->bytes + mb->len > MSGQ_AMBIENT_MAX) {
+			q->dropped++;
+			return 0;
+		}
+	}
+
+	if (ring_push(r, mb, q->seq++) == -1)
+		return -1;
+	q->bytes += mb->len;
+	q->pushed += mb->len;
+	return 0;
+}
+
+static void
+ring_pop(struct msgring *r)
+{
+	r->bytes -= r->ents[r->head].mb->len;
+	msgbuf_release(r->ents[r->head].mb);
+	r->head = (r->head + 1) % r->alloc;
+	r->n--;
+}
+
+/*
+ * Class of the next message to write after the first 'idx' of each
+ * class, or -1 if there is none.
+ */
+static int
+next_class(struct msgq *q, size_t *idx)
+{
+	struct msgring			*r;
+	uint64_t			 seq, bestseq;
+	int				 c, best;
+
+	best = -1;
+	bestseq = 0;
+	for (c = 0; c < MAX_MSG_CLASSES; c++) {
+		r = &q->ring[c];
+		if (idx[c] == r->n)
+			continue;
+		if (q->congested)
+			return c;
+		seq = r->ents[(r->head + idx[c]) % r->alloc].seq;
+		if (best == -1 || seq < bestseq) {
+			best = c;
+			bestseq = seq;
+		}
+	}
+
+	return best;
+}
+
+/*
+ * Writes as much of the queue to 'fd' as it takes: a partly written
+ * message first, then in order, or class by class when congested. Returns 0 when the queue was
+ * emptied, 1 if some of it is left for later and -1 on error.
+ */
+int
+msgq_flush(struct msgq *q, int fd)
+{
+	struct iovec			 iov[MSGQ_IOV];
+	MsgClass			 cls[MSGQ_IOV];
+	struct msgring			*r;
+	struct msgbuf			*mb;
+	ssize_t				 nw;
+	size_t				 idx[MAX_MSG_CLASSES];
+	size_t				 i, n, left;
+	int				 c;
+
+	while (q->bytes > 0) {
+		n = 0;
+		for (c = 0; c < MAX_MSG_CLASSES; c++)
+			idx[c] = 0;
+		if (q->off > 0) {
+			mb = q->ring[q->cur].ents[q->ring[q->cur].head].mb;
+			iov[n].iov_base = mb->data + q->off;
+			iov[n].iov_len = mb->len - q->off;
+			cls[n++] = q->cur;
+			idx[q->cur] = 1;
+		}
+		while (n < MSGQ_IOV && (c = next_class(q, idx)) != -1) {
+			r = &q->ring[c];
+			mb = r->ents[(r->head + idx[c]++) % r->alloc].mb;
+			iov[n].iov_base = mb->data;
+			iov[n].iov_len = mb->len;
+			cls[n++] = c;
+		}
+
+		if ((nw = writev(fd, iov, n)) == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN) {
+				q->congested = 1;
+				return 1;
+			}
+			return -1;
+		}
+		q->bytes -= nw;
+		for (i = 0; nw > 0; i++) {
+			r = &q->ring[cls[i]];
+			left = r->ents[r->head].mb->len - (i == 0 ? q->off : 0);
+			if ((size_t) nw < left) {
+				q->cur = cls[i];
+				q->off = (i == 0 ? q->off : 0) + nw;
+				q->congested = 1;
+				return 1;
+			}
+			nw -= left;
+			ring_pop(r);
+			q->off = 0;
+		}
+	}
+
+	q->congested = 0;
+	return 0;
+}
+
+void
+msgq_clear(struct msgq *q)
+{
+	struct msgring			*r;
+	int				 c;
+
+	for (c = 0; c < MAX_MSG_CLASSES; c++) {
+		r = &q->ring[c];
+		while (r->n > 0)
+			ring_pop(r);
+		if (r->alloc > 0)
+			mem_dec(MEM_OUTPUT, r->alloc * sizeof(*r->ents));
+		free(r->ents);
+	}
+	memset(q, 0, sizeof(*q));
+}
@@ -0,0 +1,95 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef MSGBUF_H
+#define MSGBUF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Immutable, reference counted output. A message sent to many players
+ * is rendered once and each recipient's queue holds a reference until
+ * the bytes have been written out.
+ */
+struct msgbuf {
+	uint32_t			 refs;
+	size_t				 len;
+	char				 data[];
+};
+
+/*
+ * Output classes in the order they are written when the client falls
+ * behind. Only the lowest classes are collapsed or dropped.
+ */
+typedef enum msg_class {
+	MSG_RESPONSE=0,		/* output of the player's own command */
+	MSG_SYSTEM,		/* server notices */
+	MSG_DIRECTED,		/* tells, speech and channel messages */
+	MSG_AMBIENT,		/* room changes, arrivals and departures */
+	MAX_MSG_CLASSES
+} MsgClass;
+
+struct msgent {
+	struct msgbuf			*mb;
+	uint64_t			 seq;
+};
+
+struct msgring {
+	struct msgent			*ents;
+	size_t				 head;
+	size_t				 n;
+	size_t				 alloc;
+	size_t				 bytes;		/* Queued, unwritten */
+};
+
+/*
+ * A client is congested while the last flush could not write
+ * everything. Only then is the output written by class; otherwise it
+ * goes out in the order it was queued.
+ */
+struct msgq {
+	struct msgring			 ring[MAX_MSG_CLASSES];
+	MsgClass			 cur;		/* Class of partial head */
+	size_t				 off;		/* Written of that head */
+	size_t				 bytes;
+	uint64_t			 pushed;	/* Bytes ever queued */
+	size_t				 dropped;
+	uint64_t			 seq;
+	int				 congested;
+};
+
+struct msgbuf				*msgbuf_new(
+					    const char *,
+					    size_t);
+struct msgbuf				*msgbuf_ref(
+					    struct msgbuf *);
+void					 msgbuf_release(
+					    struct msgbuf *);
+
+int					 msgq_push(
+					    struct msgq *,
+					    MsgClass,
+					    struct msgbuf *);
+int					 msgq_flush(
+					    struct msgq *,
+					    int);
+void					 msgq_clear(
+					    struct msgq *);
+
+#endif
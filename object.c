@@ -18,6 +18,13 @@
 
 #include "object.h"
 #include "room.h"
+#include "store.h"
+#include "snapshot.h"
+#include "player.h"
+#include "mem.h"
+#include "query.h"
+#include "text.h"
+#include "action.h"
 
 #include <stdlib.h>
 #include <assert.h>
@@ -25,7 +32,6 @@
 #include <limits.h>
 #include <inttypes.h>
 #include <stdio.h>
-#include <fnmatch.h>
 
 static void				 object_add_child(
 					    struct object *,
@@ -44,12 +50,61 @@ static char				*parse_key(
 					    ObjType *);
 static size_t				 hash_key(
 					    const char *);
+static struct objns			*ns_get(
+					    const char *,
+					    int);
+static int				 slot_alloc(
+					    struct object *);
+static void				 slot_release(
+					    ObjHandle);
 
 #define OBJ_HASH_SZ	8192
 
 static struct object			*_head;
 static struct object			*_hash[OBJ_HASH_SZ];
 static size_t				 _max_id[MAX_OBJ_TYPE];
+static size_t				 _nobjects;
+
+/*
+ * Secondary indexes for queries: objects are threaded on one list per
+ * type (the extra list holds keys of unknown type) and on one list per
+ * namespace, which is the key up to its last slash. Namespaces are
+ * created on first use and kept around.
+ */
+#define NS_HASH_SZ	256
+
+struct objns {
+	char				*name;
+	size_t				 len;
+	size_t				 n;
+	struct object			*first;
+	struct objns			*next_hash;
+	struct objns			*next;
+};
+
+static struct object			*_type_head[MAX_OBJ_TYPE + 1];
+static size_t				 _type_count[MAX_OBJ_TYPE + 1];
+static struct objns			*_ns_hash[NS_HASH_SZ];
+static struct objns			*_ns_head;
+
+/*
+ * Slot table behind object handles. Released slots are queued at the
+ * tail of the free list and reused from its head, so that a slot's
+ * generation wraps around as late as possible.
+ */
+#define SLOT_CHUNK	1024
+
+struct objslot {
+	struct object			*obj;
+	uint32_t			 gen;
+	uint32_t			 next_free;
+};
+
+static struct objslot			*_slots;
+static size_t				 _nslots;
+static size_t				 _alloc_slots;
+static uint32_t				 _free_head;
+static uint32_t				 _free_tail;
 
 #ifndef ARRLEN
 #define ARRLEN(_x) sizeof((_x)) / sizeof((_x)[0])
@@ -58,9 +113,14 @@ static size_t				 _max_id[MAX_OBJ_TYPE];
 void
 set_title(struct object *obj, const char *str)
 {
-	if (obj->title != NULL)
-		free(obj->title);
-	obj->title = strdup(str);
+	const char			*p;
+
+	if ((p = text_intern(str)) == NULL)
+		return;
+	text_release(obj->title);
+	obj->title = p;
+	if (IS_ROOM(obj))
+		ROOM(obj)->flags |= ROOM_DIRTY;
 }
 
 const char *
@@ -81,12 +141,159 @@ hash_key(const char *key)
 	return k;
 }
 
+static struct objns *
+ns_get(const char *key, int create)
+{
+	struct objns			*ns;
+	const char			*p;
+	size_t				 len, k;
+
+	len = (p = strrchr(key, '/')) != NULL ? (size_t) (p - key) : 0;
+	for (k = 0, p = key; p < key + len; p++)
+		k = *p + (k << 6) + (k << 16) - k;
+	k %= NS_HASH_SZ;
+
+	for (ns = _ns_hash[k]; ns != NULL; ns = ns->next_hash)
+		if (ns->len == len && memcmp(ns->name, key, len) == 0)
+			return ns;
+	if (!create)
+		return NULL;
+
+	if ((ns = calloc(1, sizeof(*ns))) == NULL)
+		return NULL;
+	if ((ns->name = strndup(key, len)) == NULL) {
+		free(ns);
+		return NULL;
+	}
+	mem_inc(MEM_INDEX, sizeof(*ns) + len + 1);
+	ns->len = len;
+	ns->next_hash = _ns_hash[k];
+	_ns_hash[k] = ns;
+	ns->next = _ns_head;
+	_ns_head = ns;
+	return ns;
+}
+
+/*
+ * Namespace of the object with 'key', if anything lives there.
+ */
+struct objns *
+object_ns(const char *key)
+{
+	return ns_get(key, 0);
+}
+
+struct objns *
+object_next_ns(struct objns *prev)
+{
+	if (prev == NULL)
+		return _ns_head;
+	else
+		return prev->next;
+}
+
+const char *
+object_ns_name(struct objns *ns)
+{
+	return ns->name;
+}
+
+size_t
+object_ns_count(struct objns *ns)
+{
+	return ns->n;
+}
+
+/*
+ * Whether namespace 'ns' is 'prefix' or lies below it.
+ */
+int
+object_ns_within(struct objns *ns, const char *prefix)
+{
+	size_t				 len;
+
+	len = strlen(prefix);
+	if (ns->len < len || memcmp(ns->name, prefix, len) != 0)
+		return 0;
+
+	return ns->len == len || ns->name[len] == '/';
+}
+
+struct object *
+object_next_in_ns(struct objns *ns, struct object *prev)
+{
+	if (prev == NULL)
+		return ns->first;
+	else
+		return prev->next_ns;
+}
+
+size_t
+object_type_count(ObjType type)
+{
+	if (type > MAX_OBJ_TYPE)
+		return 0;
+
+	return _type_count[type];
+}
+
+struct object *
+object_next_of_type(ObjType type, struct object *prev)
+{
+	if (prev != NULL)
+		return prev->next_type;
+	if (type > MAX_OBJ_TYPE)
+		return NULL;
+
+	return _type_head[type];
+}
+
+size_t
+object_count(void)
+{
+	return _nobjects;
+}
+
+size_t
+object_child_count(struct object *obj)
+{
+	return obj->nchildren;
+}
+
+static const char			*types[MAX_OBJ_TYPE] = {
+	"player", "room", "item"
+};
+
+const char *
+object_type_name(ObjType type)
+{
+	if (type >= MAX_OBJ_TYPE)
+		return "unknown";
+
+	return types[type];
+}
+
+/*
+ * Heap memory held by the object and whatever it owns.
+ */
+size_t
+object_bytes(struct object *obj)
+{
+	size_t				 bytes;
+
+	bytes = sizeof(*obj) + MEM_STR(obj->key) + text_bytes(obj->title) +
+	    action_bytes(obj);
+	if (IS_ROOM(obj))
+		bytes += room_bytes(ROOM(obj));
+	else if (IS_PLAYER(obj) && PLAYER(obj) != NULL)
+		bytes += player_bytes(PLAYER(obj));
+
+	return bytes;
+}
+
 static ObjType
 parse_type(const char *type)
 {
-	static const char		*types[MAX_OBJ_TYPE] = {
-		"player", "room", "item"
-	};
 	ObjType				 i;
 
 	for (i = 0; i < MAX_OBJ_TYPE; i++)
@@ -96,6 +303,15 @@ parse_type(const char *type)
 	return i;
 }
 
+/*
+ * Type named 'name', or MAX_OBJ_TYPE if there is no such type.
+ */
+ObjType
+object_type_parse(const char *name)
+{
+	return parse_type(name);
+}
+
 static char *
 parse_key(const char *key, ObjType *type)
 {
@@ -120,28 +336,38 @@ parse_key(const char *key, ObjType *type)
 	return id;
 }
 
-#include <stdio.h>
+/*
+ * Like object_find(), but only looks at resident objects and never
+ * creates or faults in anything.
+ */
 struct object *
-object_find(const char *key)
+object_lookup(const char *key)
 {
 	struct object			*np;
-	size_t				 k;
 
-	k = hash_key(key);
-	np = _hash[k];
-	while (np != NULL) {
-		if (strcmp(np->key, key) != 0)
-			np = np->next_hash;
-		else
+	for (np = _hash[hash_key(key)]; np != NULL; np = np->next_hash)
+		if (strcmp(np->key, key) == 0)
 			break;
-	}
+
+	return np;
+}
+
+struct object *
+object_find(const char *key)
+{
+	struct object			*np;
+
+	np = object_lookup(key);
 	if (np == NULL) {
 		/* FIXME: Always return object */
 		if ((np = object_create(key)) == NULL)
 			return NULL;
-		np->next_hash = _hash[k];
-		_hash[k] = np;
-	}
+		if (IS_ROOM(np)) {
+			store_fault(ROOM(np));
+			snapshot_fault(ROOM(np));
+		}
+	} else if (IS_ROOM(np))
+		ROOM(np)->flags |= ROOM_REF;
 
 	return np;
 }
@@ -152,6 +378,100 @@ max_object_id(ObjType type)
 	return _max_id[type];
 }
 
+/*
+ * Makes sure new object ids are not handed out below 'id', e.g. for
+ * objects that exist in the world store but are not resident.
+ */
+void
+object_reserve_id(ObjType type, size_t id)
+{
+	if (type < MAX_OBJ_TYPE && _max_id[type] < id)
+		_max_id[type] = id;
+}
+
+ObjHandle
+object_handle(struct object *obj)
+{
+	if (obj == NULL)
+		return OBJ_HANDLE_NONE;
+
+	return obj->handle;
+}
+
+struct object *
+object_deref(ObjHandle h)
+{
+	struct objslot			*slot;
+
+	if (HANDLE_INDEX(h) == 0 || HANDLE_INDEX(h) >= _nslots)
+		return NULL;
+
+	slot = &_slots[HANDLE_INDEX(h)];
+	if (slot->gen != HANDLE_GEN(h))
+		return NULL;
+
+	return slot->obj;
+}
+
+static int
+slot_alloc(struct object *obj)
+{
+	struct objslot			*slot;
+	uint32_t			 i;
+
+	if (_free_head != 0) {
+		i = _free_head;
+		_free_head = _slots[i].next_free;
+		if (_free_head == 0)
+			_free_tail = 0;
+	} else {
+		if (_nslots == 0)
+			_nslots = 1;	/* Index 0 is OBJ_HANDLE_NONE */
+		if (_nslots > OBJ_HANDLE_INDEX_MASK)
+			return -1;
+		if (_nslots >= _alloc_slots) {
+			slot = realloc(_slots, (_alloc_slots + SLOT_CHUNK) *
+			    sizeof(struct objslot));
+			if (slot == NULL)
+				return -1;
+			if (_alloc_slots > 0)
+				mem_dec(MEM_INDEX,
+				    _alloc_slots * sizeof(struct objslot));
+			mem_inc(MEM_INDEX, (_alloc_slots + SLOT_CHUNK) *
+			    sizeof(struct objslot));
+			_slots = slot;
+			_alloc_slots += SLOT_CHUNK;
+		}
+		i = _nslots++;
+		_slots[i].gen = 0;
+	}
+
+	slot = &_slots[i];
+	slot->obj = obj;
+	slot->next_free = 0;
+	obj->handle = (slot->gen << OBJ_HANDLE_INDEX_BITS) | i;
+	return 0;
+}
+
+static void
+slot_release(ObjHandle h)
+{
+	struct objslot			*slot;
+	uint32_t			 i;
+
+	i = HANDLE_INDEX(h);
+	slot = &_slots[i];
+	slot->obj = NULL;
+	slot->gen = (slot->gen + 1) & OBJ_HANDLE_GEN_MASK;
+	slot->next_free = 0;
+
+	if (_free_tail != 0)
+		_slots[_free_tail].next_free = i;
+	else
+		_free_head = i;
+	_free_tail = i;
+}
+
 struct object *
 object_create(const char *key)
 {
@@ -168,9 +488,16 @@ object_create(const char *key)
 		return NULL;
 	}
 
+	if (slot_alloc(obj) == -1) {
+		free(obj->key);
+		free(obj);
+		return NULL;
+	}
+
+	mem_inc(MEM_OBJECT, sizeof(*obj) + MEM_STR(obj->key));
+
 	id = parse_key(key, &obj->type);
-	if (_max_id[obj->type] < (size_t) atoll(id))
-		_max_id[obj->type] = (size_t) atoll(id);
+	object_reserve_id(obj->type, (size_t) atoll(id));
 
 	if (obj->type == OBJ_TYPE_ROOM)
 		room_create(obj, id);
@@ -179,25 +506,45 @@ object_create(const char *key)
 	return obj;
 }
 
+static void
+save_one(struct object *obj, void *fp)
+{
+	printf("Saving %s\n", obj->key);
+	if (obj->type == OBJ_TYPE_ROOM)
+		room_save(ROOM(obj), fp);
+}
+
+/*
+ * Goes through the query planner, so that a pattern confined to one
+ * namespace, like the rooms, only visits that namespace.
+ */
 void
 object_save_all(FILE *fp, const char *pattern)
 {
-	struct object			*obj;
+	struct query			 q;
 
-	obj = NULL;
-	while ((obj = object_next(obj)) != NULL) {
-		if (fnmatch(pattern, obj->key, 0) == FNM_NOMATCH)
-			continue;
-		printf("Saving %s\n", obj->key);
-		if (obj->type == OBJ_TYPE_ROOM)
-			room_save(ROOM(obj), fp);
-	}
+	query_init(&q);
+	q.glob = pattern;
+	query_run(&q, save_one, fp);
 }
 
+/*
+ * Children are left without environment; anything else referring to
+ * the object by handle notices it is gone on the next object_deref().
+ */
 void
 object_free(struct object *obj)
 {
+	while (obj->first_child != NULL)
+		object_reparent(obj->first_child, NULL);
+
 	object_remove(obj);
+	slot_release(obj->handle);
+	if (obj->type == OBJ_TYPE_ROOM)
+		room_free(ROOM(obj));
+	action_free_all(obj);
+	text_release(obj->title);
+	mem_dec(MEM_OBJECT, sizeof(*obj) + MEM_STR(obj->key));
 	free(obj->key);
 	free(obj);
 }
@@ -220,6 +567,18 @@ object_next_child(struct object *obj, struct object *prev)
 		return prev->next;
 }
 
+/*
+ * Like object_next_child(), but only the players.
+ */
+struct object *
+object_next_player(struct object *obj, struct object *prev)
+{
+	if (prev == NULL)
+		return obj->first_player;
+	else
+		return prev->next_player;
+}
+
 struct object *
 object_next(struct object *prev)
 {
@@ -232,14 +591,62 @@ object_next(struct object *prev)
 static void
 object_add(struct object *obj)
 {
+	struct object			**hp;
+	size_t				 k;
+
 	obj->next_all = _head;
 	_head = obj;
+	_nobjects++;
+
+	k = hash_key(obj->key);
+	obj->next_hash = _hash[k];
+	_hash[k] = obj;
+
+	hp = &_type_head[obj->type];
+	if ((obj->next_type = *hp) != NULL)
+		(*hp)->prev_type = obj;
+	*hp = obj;
+	_type_count[obj->type]++;
+
+	if ((obj->ns = ns_get(obj->key, 1)) != NULL) {
+		if ((obj->next_ns = obj->ns->first) != NULL)
+			obj->ns->first->prev_ns = obj;
+		obj->ns->first = obj;
+		obj->ns->n++;
+	}
 }
 
 static void
 object_remove(struct object *obj)
 {
 	struct object			*np, *prev = NULL;
+	struct object			**hp;
+
+	for (hp = &_hash[hash_key(obj->key)]; *hp != NULL;
+	    hp = &(*hp)->next_hash)
+		if (*hp == obj) {
+			*hp = obj->next_hash;
+			break;
+		}
+
+	if (obj->prev_type != NULL)
+		obj->prev_type->next_type = obj->next_type;
+	else
+		_type_head[obj->type] = obj->next_type;
+	if (obj->next_type != NULL)
+		obj->next_type->prev_type = obj->prev_type;
+	_type_count[obj->type]--;
+
+	if (obj->ns != NULL) {
+		if (obj->prev_ns != NULL)
+			obj->prev_ns->next_ns = obj->next_ns;
+		else
+			obj->ns->first = obj->next_ns;
+		if (obj->next_ns != NULL)
+			obj->next_ns->prev_ns = obj->prev_ns;
+		obj->ns->n--;
+	}
+	_nobjects--;
 
 	for (np = _head; np != NULL; prev = np, np = np->next_all)
 		if (np == obj) {
@@ -265,8 +672,22 @@ object_remove_child(struct object *obj, struct object *child)
 			else if (np == obj->first_child)
 				obj->first_child = np->next;
 			np->parent = NULL;
+			obj->nchildren--;
 			break;
 		}
+
+	if (IS_PLAYER(child)) {
+		if (child->prev_player != NULL)
+			child->prev_player->next_player = child->next_player;
+		else if (obj->first_player == child)
+			obj->first_player = child->next_player;
+		if (child->next_player != NULL)
+			child->next_player->prev_player = child->prev_player;
+		child->next_player = child->prev_player = NULL;
+		obj->nplayers--;
+		if (IS_ROOM(obj) && ROOM(obj) != NULL)
+			room_highlight_invalidate(ROOM(obj));
+	}
 }
 
 static void
@@ -276,5 +697,16 @@ object_add_child(struct object *obj, struct object *child)
 		child->next = obj->first_child;
 		child->parent = obj;
 		obj->first_child = child;
+		obj->nchildren++;
+
+		if (IS_PLAYER(child)) {
+			child->prev_player = NULL;
+			if ((child->next_player = obj->first_player) != NULL)
+				obj->first_player->prev_player = child;
+			obj->first_player = child;
+			obj->nplayers++;
+			if (IS_ROOM(obj) && ROOM(obj) != NULL)
+				room_highlight_invalidate(ROOM(obj));
+		}
 	}
 }
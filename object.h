@@ -20,10 +20,13 @@
 #define OBJECT_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 struct player;
 struct room;
+struct objns;
+struct actset;
 
 typedef enum objtype {
 	OBJ_TYPE_PLAYER=0,
@@ -43,6 +46,28 @@ typedef enum objtype {
 #define ENV(_x)			OBJ(_x)->parent
 #define THIS(_x)		this_player(_x)
 
+/*
+ * Object handles are the preferred way for other subsystems to refer
+ * to objects they do not own. The low bits index the object slot
+ * table and the high bits hold the generation of the slot, so a handle
+ * to a freed object is detected in O(1) by object_deref(). Handle 0
+ * never refers to any object.
+ */
+typedef uint32_t ObjHandle;
+
+#define OBJ_HANDLE_NONE		0
+#define OBJ_HANDLE_INDEX_BITS	22
+#define OBJ_HANDLE_INDEX_MASK	((1U << OBJ_HANDLE_INDEX_BITS) - 1)
+#define OBJ_HANDLE_GEN_MASK	((1U << (32 - OBJ_HANDLE_INDEX_BITS)) - 1)
+#define HANDLE_INDEX(_h)	((_h) & OBJ_HANDLE_INDEX_MASK)
+#define HANDLE_GEN(_h)		((_h) >> OBJ_HANDLE_INDEX_BITS)
+
+/*
+ * For passing handles through void * callback arguments.
+ */
+#define HANDLE_TO_PTR(_h)	((void *) (uintptr_t) (_h))
+#define PTR_TO_HANDLE(_p)	((ObjHandle) (uintptr_t) (_p))
+
 struct object {
 	ObjType				 type;
 	struct object			*parent;
@@ -51,7 +76,25 @@ struct object {
 	struct object			*next_all;
 	struct object			*next_hash;
 	char				*key;
-	char				*title;
+	const char			*title;
+	ObjHandle			 handle;
+	struct object			*next_type;
+	struct object			*prev_type;
+	struct object			*next_ns;
+	struct object			*prev_ns;
+	struct objns			*ns;
+	size_t				 nchildren;
+
+	/*
+	 * Players among the children, for broadcasts that should not
+	 * have to step over everything else lying around.
+	 */
+	struct object			*first_player;
+	struct object			*next_player;
+	struct object			*prev_player;
+	size_t				 nplayers;
+
+	struct actset			*actions;	/* See action.h */
 	union {
 		struct player		*player;
 		struct room		*room;
@@ -64,12 +107,26 @@ void					 set_title(
 const char				*title(
 					    struct object *);
 size_t					 max_object_id(ObjType);
+const char				*object_type_name(ObjType);
+ObjType					 object_type_parse(
+					    const char *);
+size_t					 object_bytes(
+					    struct object *);
+void					 object_reserve_id(
+					    ObjType,
+					    size_t);
+ObjHandle				 object_handle(
+					    struct object *);
+struct object				*object_deref(
+					    ObjHandle);
 
 void					 object_save_all(
 					    FILE *,
 					    const char *);
 struct object				*object_find(
 					    const char *);
+struct object				*object_lookup(
+					    const char *);
 struct object				*object_create(
 					    const char *);
 void					 object_free(
@@ -80,7 +137,32 @@ void					 object_reparent(
 struct object				*object_next_child(
 					    struct object *,
 					    struct object *);
+struct object				*object_next_player(
+					    struct object *,
+					    struct object *);
 struct object				*object_next(
 					    struct object *);
+size_t					 object_count(void);
+size_t					 object_child_count(
+					    struct object *);
+
+size_t					 object_type_count(ObjType);
+struct object				*object_next_of_type(
+					    ObjType,
+					    struct object *);
+struct objns				*object_ns(
+					    const char *);
+struct objns				*object_next_ns(
+					    struct objns *);
+const char				*object_ns_name(
+					    struct objns *);
+size_t					 object_ns_count(
+					    struct objns *);
+int					 object_ns_within(
+					    struct objns *,
+					    const char *);
+struct object				*object_next_in_ns(
+					    struct objns *,
+					    struct object *);
 
 #endif
@@ -16,17 +16,19 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include "utf8.h"
+
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <syslog.h>
-#include <ctype.h>
 
 size_t
 parseline(char *base, char *dst, size_t dstsz)
 {
 	char *s, *t, *separator;
-	size_t len;
+	size_t len, n;
+	uint32_t cp;
 
 	/*
 	 * Do we have a separator? If not, return NULL.
@@ -41,18 +43,37 @@ parseline(char *base, char *dst, size_t dstsz)
 	separator = s;
 
 	/*	
-	 * We had a separator. Extract the line.
+	 * We had a separator. Extract the line as UTF-8, leaving out
+	 * control characters and bytes that are not well-formed.
 	 */
 	s = base;
 	len = 0;
-	while (s != separator && ++len < dstsz - 1) {
-		if (iscntrl(*s) || !isascii(*s)) {
-			len--;
+	while (s != separator) {
+		n = utf8_printable_run(s, separator - s);
+		if (n > dstsz - 1 - len)
+			n = dstsz - 1 - len;
+		memcpy(dst + len, s, n);
+		len += n;
+		s += n;
+		if (s == separator || len == dstsz - 1)
+			break;
+
+		if ((unsigned char) *s < 0x80 ||
+		    (n = utf8_decode(s, separator - s, &cp)) == 0) {
 			s++;
-		} else
-			*dst++ = *s++;
+			continue;
+		}
+		if (cp >= 0x80 && cp < 0xa0) {
+			s += n;
+			continue;
+		}
+		if (n > dstsz - 1 - len)
+			break;
+		memcpy(dst + len, s, n);
+		len += n;
+		s += n;
 	}
-	*dst = '\0';
+	dst[len] = '\0';
 
 	/*
 	 * Overwrite old base with the remaining content, if any.
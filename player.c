@@ -22,9 +22,20 @@
 #include "command.h"
 #include "util.h"
 #include "tell.h"
+#include "mem.h"
+#include "channel.h"
+#include "room.h"
+#include "utf8.h"
+#include "cmdtrie.h"
+#include "bktree.h"
+#include "sched.h"
+#include "arena.h"
+#include "action.h"
+#include "stats.h"
 
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
 #include <inttypes.h>
 #include <ctype.h>
@@ -36,15 +47,276 @@ this_player()
 	return NULL;
 }
 
+#define NAME_HASH_SZ	1024
+#define ALIAS_DEPTH	8
+
+static struct player		*_names[NAME_HASH_SZ];
+static struct player		*_players;
+static size_t			 _nplayers;
+static struct cmdtrie		 _cmdtrie;
+static struct bktree		 _verbs;
+static struct bktree		 _namebk;	/* Rebuilt when stale */
+static int			 _namebk_stale;
+
+static size_t
+name_hash(const char *name)
+{
+	size_t				 k;
+
+	for (k = 0; *name != '\0'; name++)
+		k = tolower((unsigned char) *name) + (k << 6) + (k << 16) - k;
+
+	return k % NAME_HASH_SZ;
+}
+
+static int
+valid_name(const char *name)
+{
+	const char			*p;
+
+	if (!isalpha((unsigned char) *name) ||
+	    strlen(name) >= PLAYER_NAME_MAX)
+		return 0;
+	for (p = name; *p != '\0'; p++)
+		if (!isalnum((unsigned char) *p) && *p != '_' && *p != '-')
+			return 0;
+
+	return 1;
+}
+
+static void
+unregister(struct player *plr)
+{
+	struct player			**pp;
+
+	if (plr->name[0] == '\0')
+		return;
+
+	for (pp = &_names[name_hash(plr->name)]; *pp != NULL;
+	    pp = &(*pp)->next_name)
+		if (*pp == plr) {
+			*pp = plr->next_name;
+			break;
+		}
+	plr->name[0] = '\0';
+	_namebk_stale = 1;
+}
+
+/*
+ * Connected player called 'name', compared without case.
+ */
+struct player *
+player_find(const char *name)
+{
+	struct player			*plr;
+
+	for (plr = _names[name_hash(name)]; plr != NULL;
+	    plr = plr->next_name)
+		if (strcasecmp(plr->name, name) == 0)
+			return plr;
+
+	return NULL;
+}
+
+/*
+ * Registers or renames 'plr'. Fails if the name is taken or not a
+ * valid name.
+ */
+int
+player_set_name(struct player *plr, const char *name)
+{
+	struct player			*other;
+	size_t				 k;
+
+	if (!valid_name(name))
+		return -1;
+	if ((other = player_find(name)) != NULL && other != plr)
+		return -1;
+
+	unregister(plr);
+	snprintf(plr->name, sizeof(plr->name), "%s", name);
+	if (ENV(plr) != NULL && IS_ROOM(ENV(plr)) && ROOM(ENV(plr)) != NULL)
+		room_highlight_invalidate(ROOM(ENV(plr)));
+	k = name_hash(name);
+	plr->next_name = _names[k];
+	_names[k] = plr;
+	_namebk_stale = 1;
+	return 0;
+}
+
+/*
+ * Tells 'plr' the name that is a typo or two away from 'name', which
+ * nobody is called, if there is one.
+ */
+void
+player_suggest(struct player *plr, const char *name)
+{
+	struct bkhit			 hit;
+	struct player			*p;
+
+	if (_namebk_stale) {
+		bktree_clear(&_namebk);
+		for (p = _players; p != NULL; p = p->next_plr)
+			if (p->name[0] != '\0' &&
+			    bktree_add(&_namebk, p->name, 1) == -1)
+				warn("bktree_add");
+		_namebk_stale = 0;
+	}
+	if (bktree_search(&_namebk, name, 2, 1, &hit, 1) == 1)
+		tellpf(plr, "Try %s?\n", hit.word);
+}
+
+const char *
+player_name(struct player *plr)
+{
+	return plr->name[0] != '\0' ? plr->name : OBJ(plr)->key;
+}
+
+/*
+ * Walks the connected players.
+ */
+struct player *
+player_next(struct player *prev)
+{
+	if (prev == NULL)
+		return _players;
+	else
+		return prev->next_plr;
+}
+
+size_t
+player_count(void)
+{
+	return _nplayers;
+}
+
+static struct prop *
+find_prop(struct player *plr, int id)
+{
+	size_t				 i;
+
+	for (i = 0; i < plr->nprops; i++)
+		if (plr->props[i].id == id)
+			return &plr->props[i];
+	return NULL;
+}
+
+/*
+ * Text of property 'id', or NULL if it is not set. '*n' is its numeric
+ * value, 0 unless the text is a number. Property 0 is the name.
+ */
+const char *
+player_prop(struct player *plr, int id, int64_t *n)
+{
+	struct prop			*pr;
+	const char			*s;
+	char				*ep;
+
+	*n = 0;
+	if (id == 0) {
+		s = player_name(plr);
+		*n = strtoll(s, &ep, 10);
+		if (*ep != '\0')
+			*n = 0;
+		return s;
+	}
+	if ((pr = find_prop(plr, id)) == NULL)
+		return NULL;
+	*n = pr->n;
+	return pr->s;
+}
+
+int
+player_set_prop(struct player *plr, int id, const char *s)
+{
+	struct prop			*pr;
+	char				*ns, *ep;
+
+	if (id == 0)
+		return -1;
+	if ((ns = strdup(s)) == NULL)
+		return -1;
+	mem_inc(MEM_PLAYER, MEM_STR(ns));
+
+	if ((pr = find_prop(plr, id)) == NULL) {
+		if ((pr = realloc(plr->props,
+		    (plr->nprops + 1) * sizeof(*pr))) == NULL) {
+			mem_dec(MEM_PLAYER, MEM_STR(ns));
+			free(ns);
+			return -1;
+		}
+		mem_inc(MEM_PLAYER, sizeof(*pr));
+		plr->props = pr;
+		pr = &plr->props[plr->nprops++];
+		pr->id = id;
+	} else {
+		mem_dec(MEM_PLAYER, MEM_STR(pr->s));
+		free(pr->s);
+	}
+
+	pr->s = ns;
+	pr->n = strtoll(ns, &ep, 10);
+	if (*ep != '\0')
+		pr->n = 0;
+	return 0;
+}
+
+void
+player_unset_prop(struct player *plr, int id)
+{
+	struct prop			*pr;
+
+	if ((pr = find_prop(plr, id)) == NULL)
+		return;
+	mem_dec(MEM_PLAYER, MEM_STR(pr->s) + sizeof(*pr));
+	free(pr->s);
+	*pr = plr->props[--plr->nprops];
+}
+
+#define PLAYER_BASE_SZ \
+	(sizeof(struct player) - READ_BLOCK - sizeof(struct fmtbuf))
+
+/*
+ * Makes 'obj' a player.
+ */
+struct player *
+player_new(struct object *obj)
+{
+	struct player *plr;
+
+	if ((plr = calloc(1, sizeof(struct player))) == NULL)
+		return NULL;
+	mem_inc(MEM_PLAYER, PLAYER_BASE_SZ);
+	mem_inc(MEM_INPUT, READ_BLOCK);
+	mem_inc(MEM_OUTPUT, sizeof(struct fmtbuf));
+
+	obj->v.player = plr;
+	plr->object = obj;
+	return plr;
+}
+
 struct player *
 player_create()
 {
 	struct player *plr;
 	struct object *obj, *env;
+	char key[32], name[PLAYER_NAME_MAX];
+	size_t id;
+
+	id = max_object_id(OBJ_TYPE_PLAYER) + 1;
+	snprintf(key, sizeof(key), "player/%zu", id);
+	obj = object_create(key);
+	if ((plr = player_new(obj)) == NULL) {
+		object_free(obj);
+		return NULL;
+	}
+	snprintf(name, sizeof(name), "guest%zu", id);
+	player_set_name(plr, name);
+	if ((plr->next_plr = _players) != NULL)
+		_players->prev_plr = plr;
+	_players = plr;
+	_nplayers++;
 
-	obj = object_create("player/1");
-	plr = obj->v.player = calloc(1, sizeof(struct player));
-	plr->object = obj;
 	env = object_find("room/1");
 	printf("Found env: %ju\n", (uintmax_t) env);
 	object_reparent(obj, env);
@@ -61,9 +333,46 @@ player_env(struct player *plr)
 void
 player_free(struct player *plr)
 {
+	if (plr->herebuf != NULL)
+		mem_dec(MEM_INPUT, plr->herebuf_alloc);
+	if (plr->herebuf_cmdstr != NULL)
+		mem_dec(MEM_INPUT, MEM_STR(plr->herebuf_cmdstr));
+	free(plr->herebuf);
+	free(plr->herebuf_cmdstr);
+	msgq_clear(&plr->outq);
+	channel_leave_all(plr);
+	sched_remove(plr);
+	while (plr->nprops > 0)
+		player_unset_prop(plr, plr->props[0].id);
+	free(plr->props);
+	if (plr->aliases != NULL) {
+		cmdtrie_clear(plr->aliases);
+		mem_dec(MEM_PLAYER, sizeof(*plr->aliases));
+		free(plr->aliases);
+	}
+	unregister(plr);
+	if (_players == plr || plr->prev_plr != NULL) {
+		if (plr->prev_plr != NULL)
+			plr->prev_plr->next_plr = plr->next_plr;
+		else
+			_players = plr->next_plr;
+		if (plr->next_plr != NULL)
+			plr->next_plr->prev_plr = plr->prev_plr;
+		_nplayers--;
+	}
+	mem_dec(MEM_PLAYER, PLAYER_BASE_SZ);
+	mem_dec(MEM_INPUT, READ_BLOCK);
+	mem_dec(MEM_OUTPUT, sizeof(struct fmtbuf));
 	free(plr);
 }
 
+size_t
+player_bytes(struct player *plr)
+{
+	return sizeof(struct player) + plr->herebuf_alloc +
+	    MEM_STR(plr->herebuf_cmdstr);
+}
+
 static const struct {
 	const char *verb;
 	void (*cmd)(struct player *, char *);
@@ -77,32 +386,33 @@ static const struct {
 	{ "say", say_main, 0 },
 	{ "clear", clear_main, 0 },
 	{ "goto", goto_main, 0 },
-	{ "objects", objects_main, 0 }
+	{ "objects", objects_main, 0 },
+	{ "memory", memory_main, 0 },
+	{ "set", set_main, 0 },
+	{ "unset", unset_main, 0 },
+	{ "toggle", toggle_main, 0 },
+	{ "travel", travel_main, OBJ_TYPE_ROOM },
+	{ "where", where_main, 0 },
+	{ "who", who_main, 0 },
+	{ "tell", tell_main, 0 },
+	{ "name", name_main, 0 },
+	{ "channel", channel_main, 0 },
+	{ "alias", alias_main, 0 },
+	{ "unalias", unalias_main, 0 },
+	{ "pace", pace_main, 0 },
+	{ "action", action_main, 0 },
+	{ "stats", stats_main, 0 }
 };
 
-const char **
-mkverbs(struct player *plr, size_t *nverbs)
-{
-	static const char *verbs[ARRLEN(cmds)];
-	size_t i;
-
-	for (i = 0; i < ARRLEN(cmds); i++) {
-		if (cmds[i].env_req != 0 && ENV(plr)->type != cmds[i].env_req)
-			verbs[i] = NULL;
-		else
-			verbs[i] = cmds[i].verb;
-	}
-
-	*nverbs = ARRLEN(cmds);
-	return verbs;
-}
-
+/*
+ * Compiles the command table and the built-in aliases.
+ */
 void
-player_input(struct player *plr, char *str)
+player_init(void)
 {
 	static const struct {
 		const char *alias;
-		char *str;
+		const char *str;
 	} aliases[] = {
 		{ "n", "go north" },
 		{ "s", "go south" },
@@ -115,108 +425,240 @@ player_input(struct player *plr, char *str)
 		{ "u", "go up" },
 		{ "d", "go down" }
 	};
+	const char *names[ARRLEN(cmds)];
+	unsigned envmask;
+	size_t i;
+
+	_cmdtrie.mt = MEM_INDEX;
+	_verbs.mt = MEM_INDEX;
+	_namebk.mt = MEM_INDEX;
+	for (i = 0; i < ARRLEN(cmds); i++) {
+		envmask = cmds[i].env_req != 0 ?
+		    1U << cmds[i].env_req : CMD_ENV_ANY;
+		if (cmdtrie_add(&_cmdtrie, cmds[i].verb, NULL, i, envmask,
+		    0) == -1)
+			err(1, "cmdtrie_add");
+		if (bktree_add(&_verbs, cmds[i].verb, envmask) == -1)
+			err(1, "bktree_add");
+		names[i] = cmds[i].verb;
+	}
+	stats_init(names, ARRLEN(cmds));
+	for (i = 0; i < ARRLEN(aliases); i++)
+		if (cmdtrie_add(&_cmdtrie, aliases[i].alias, aliases[i].str,
+		    -1, CMD_ENV_ANY, 1) == -1)
+			err(1, "cmdtrie_add");
+}
+
+/*
+ * Defines or, with a NULL 'str', removes an alias of the player's own.
+ */
+int
+player_alias(struct player *plr, const char *alias, const char *str)
+{
+	if (str == NULL)
+		return plr->aliases != NULL ?
+		    cmdtrie_del(plr->aliases, alias) : -1;
+
+	if (plr->aliases == NULL) {
+		if ((plr->aliases = calloc(1, sizeof(*plr->aliases))) == NULL)
+			return -1;
+		mem_inc(MEM_PLAYER, sizeof(*plr->aliases));
+		plr->aliases->mt = MEM_PLAYER;
+	}
+	return cmdtrie_add(plr->aliases, alias, str, -1, CMD_ENV_ANY, 1);
+}
+
+struct choices {
+	struct player *plr;
+	int listing;
+};
+
+static void
+tell_choice(const struct cmdent *e, void *arg)
+{
+	struct choices *c = arg;
+
+	tellpf(c->plr, "%c%s%s", CT_TOUPPER(e->word[0]), &e->word[1],
+	    c->listing ? ".\n" : "?\n");
+}
+
+/*
+ * Runs the command line an alias stands for, with 'args' added.
+ */
+static void
+run_alias(struct player *plr, const char *expand, const char *args)
+{
+	static int depth;
+	char *p;
+
+	if (depth >= ALIAS_DEPTH) {
+		tellp(plr, "Too many aliases deep.\n");
+		return;
+	}
+
+	if (args != NULL)
+		p = arena_printf("%s %s", expand, args);
+	else
+		p = arena_strdup(expand);
+	if (p == NULL) {
+		warn("tmp buffer for alias");
+		return;
+	}
+
+	depth++;
+	player_input(plr, p);
+	depth--;
+}
+
+void
+player_input(struct player *plr, char *str)
+{
+	const struct cmdent *ent;
+	struct choices c;
+	ArenaMark mark;
 	char *p = NULL, *q;
-	size_t i, sz;
-	ssize_t m;
+	size_t sz, node;
 	size_t len;
-	const char **verbs;
-	size_t nverbs;
+	CmdMatch m;
+	ActResult res;
+	ObjType env;
+	uint64_t cpu, out;
+	int cmd = -1;
 
-	while (isspace(*str))
+	while (CT(*str, CT_SPACE))
 		str++;
 
-	verbs = mkverbs(plr, &nverbs);
-
 	/*
 	 * Herebuf processing.
 	 */
 	len = strlen(str);
 	if (len >= 2 && str[len-1] == '<' && str[len-2] == ' ') {
 		str[--len] = '\0';
-		plr->herebuf_cmdstr = strdup(str);
+		if ((plr->herebuf_cmdstr = strdup(str)) != NULL)
+			mem_inc(MEM_INPUT, MEM_STR(plr->herebuf_cmdstr));
 		return;
 	}
 	if (plr->herebuf_cmdstr != NULL) {
 		if (len == 1 && str[0] == '.') {
-			sz = plr->herebuf_sz + strlen(plr->herebuf_cmdstr) + 1;
-			str = malloc(sz * sizeof(char));
-			snprintf(str, sz, "%s%s", plr->herebuf_cmdstr,
-			    plr->herebuf);
+			mark = arena_mark();
+			str = arena_printf("%s%s", plr->herebuf_cmdstr,
+			    plr->herebuf != NULL ? plr->herebuf : "");
 
+			mem_dec(MEM_INPUT, MEM_STR(plr->herebuf_cmdstr));
 			free(plr->herebuf_cmdstr);
 			plr->herebuf_cmdstr = NULL;
+			if (plr->herebuf != NULL)
+				mem_dec(MEM_INPUT, plr->herebuf_alloc);
 			free(plr->herebuf);
 			plr->herebuf = NULL;
 			plr->herebuf_sz = 0;
 			plr->herebuf_alloc = 0;
 
-			player_input(plr, str);
-			free(str);
+			if (str != NULL)
+				player_input(plr, str);
+			else
+				warn("tmp buffer for here-document");
+			arena_release(mark);
 			return;
 		} else {
-			if (plr->herebuf_sz + len + 2 >= plr->herebuf_alloc) {
-				if (plr->herebuf_alloc == 0)
-					plr->herebuf_alloc = 512;
-				else
-					plr->herebuf_alloc *= 2;
-				plr->herebuf = realloc(plr->herebuf,
-				    plr->herebuf_alloc);
+			/*
+			 * Lines are joined with a space; grow until the
+			 * line, the space and the NUL fit.
+			 */
+			for (sz = plr->herebuf_alloc != 0 ?
+			    plr->herebuf_alloc : 512;
+			    plr->herebuf_sz + len + 2 > sz; sz *= 2)
+				;
+			if (sz != plr->herebuf_alloc) {
+				if ((p = realloc(plr->herebuf, sz)) == NULL) {
+					warn("herebuf");
+					return;
+				}
+				if (plr->herebuf_alloc != 0)
+					mem_dec(MEM_INPUT, plr->herebuf_alloc);
+				mem_inc(MEM_INPUT, sz);
+				plr->herebuf = p;
+				plr->herebuf_alloc = sz;
 			}
 			if (plr->herebuf_sz > 0)
-				plr->herebuf_sz += snprintf(
-				    &plr->herebuf[plr->herebuf_sz], len + 2,
-				    " %s", str);
-			else
-				plr->herebuf_sz += snprintf(
-				    &plr->herebuf[plr->herebuf_sz], len + 2,
-				    "%s", str);
+				plr->herebuf[plr->herebuf_sz++] = ' ';
+			memcpy(&plr->herebuf[plr->herebuf_sz], str, len + 1);
+			plr->herebuf_sz += len;
 			return;
 		}
 	}
 
 	/*
-	 * Normal command processing.
+	 * Normal command processing. Whatever the command takes from
+	 * the arena is given back once it is done.
 	 */
+	mark = arena_mark();
 	p = str;
-	while (p != NULL && isspace(*p))
+	while (p != NULL && CT(*p, CT_SPACE))
 		p++;
 	q = strchr(p, ' ');
 	if (q != NULL)
 		*q = '\0';
 
-	for (i = 0; i < ARRLEN(aliases); i++) {
-		if (strcmp(aliases[i].alias, p) == 0) {
-			if (q != NULL) {
-				sz = strlen(aliases[i].str) + 1 +
-				    strlen(q) + 1;
-				p = malloc(sz * sizeof(char));
-				if (p != NULL)
-					snprintf(p, sz, "%s %s",
-					    aliases[i].str, q);
-			} else
-				p = strdup(aliases[i].str);
-
-			if (p != NULL) {
-				player_input(plr, p);
-				free(p);
-			} else
-				warn("tmp buffer for alias");
-			return;
-		}
-	}
+	/*
+	 * The player's own aliases first, then the commands.
+	 */
+	env = ENV(plr)->type;
+	m = CMD_MISS;
+	if (plr->aliases != NULL &&
+	    cmdtrie_match(plr->aliases, p, env, &ent, &node) == CMD_UNIQUE)
+		m = CMD_UNIQUE;
+	else
+		m = cmdtrie_match(&_cmdtrie, p, env, &ent, &node);
 
-	m = match_input(plr, NULL, p, verbs, nverbs);
-	if (m >= 0) {
-		if (cmds[m].cmd != NULL)
-			cmds[m].cmd(plr, (q != NULL) ? ++q : NULL);
-		else
+	switch (m) {
+	case CMD_UNIQUE:
+		if (ent->expand != NULL)
+			run_alias(plr, ent->expand, q != NULL ? q + 1 : NULL);
+		else if (cmds[ent->cmd].cmd != NULL) {
+			cmd = ent->cmd;
+			out = plr->outq.pushed + plr->fmtbuf.j;
+			cpu = stats_cpu();
+			cmds[cmd].cmd(plr, q != NULL ? q + 1 : NULL);
+			cpu = stats_cpu() - cpu;
+		} else
+			tellp(plr, "Nothing happens.\n");
+		break;
+	case CMD_AMBIGUOUS:
+	case CMD_LIST:
+		c.plr = plr;
+		c.listing = m == CMD_LIST;
+		cmdtrie_walk(&_cmdtrie, node, env, tell_choice, &c);
+		break;
+	case CMD_MISS:
+		if (*p == '\0')
+			break;
+		if ((res = action_verb(plr, p)) == ACT_FAILED)
 			tellp(plr, "Nothing happens.\n");
+		if (res != ACT_NONE)
+			break;
+		match_suggest_tree(plr, p, &_verbs, 1U << env);
+		break;
 	}
 
 	if (q != NULL)
 		*q = ' ';
 
 	end_fmtbuf(&plr->fmtbuf);
+	arena_release(mark);
+
+	/*
+	 * The latency of a line goes to the first command it runs, once
+	 * its output is written, see stats_drained().
+	 */
+	if (cmd != -1) {
+		stats_command(cmd, cpu, plr->outq.pushed + plr->fmtbuf.j - out);
+		if (plr->line_at != 0 && plr->lat_at == 0) {
+			plr->lat_cmd = cmd;
+			plr->lat_at = plr->line_at;
+		}
+		plr->line_at = 0;
+	}
 
 	return;
 }
@@ -20,15 +20,22 @@
 #define PLAYER_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "evsrc.h"
 #include "fmtbuf.h"
+#include "tag.h"
+#include "msgbuf.h"
+#include "sched.h"
 
 #define READ_BLOCK 8096
+#define PLAYER_NAME_MAX 24
 #define WRITE_CHUNK 8096
 
+struct cmdtrie;
 struct room;
 struct object;
+struct channel;
 
 struct player {
 	char		 buf[READ_BLOCK];
@@ -63,6 +70,50 @@ struct player {
 	struct object	*object;
 
 	struct fmtbuf	fmtbuf;
+	TagSet		tags;
+
+	/*
+	 * Output waiting for the socket. Whatever has been formatted
+	 * into 'fmtbuf' is moved here before anything else is queued,
+	 * which keeps the order.
+	 */
+	struct msgq	outq;
+
+	/* Broadcast this player is excluded from, see tellrm() */
+	uint32_t	excl_gen;
+
+	/*
+	 * Connected players are registered by their unique name.
+	 * 'name' is empty for players that are not registered.
+	 */
+	char		 name[PLAYER_NAME_MAX];
+	struct player	*next_name;
+	struct player	*next_plr;
+	struct player	*prev_plr;
+
+	struct channel	**chans;
+	size_t		 nchans;
+
+	/* Aliases defined with the 'alias' command, NULL if none */
+	struct cmdtrie	*aliases;
+
+	/* Lines read but not yet run, see sched.c */
+	struct cmdq	cmdq;
+
+	/* Line being run and command waiting on output, see stats.c */
+	uint64_t	 line_at;
+	uint64_t	 lat_at;
+	int		 lat_cmd;
+
+	/* Properties set by action scripts, see prop_intern() */
+	struct prop	*props;
+	size_t		 nprops;
+};
+
+struct prop {
+	int		 id;
+	int64_t		 n;		/* Numeric value, or 0 */
+	char		*s;
 };
 
 struct room		*player_env(struct player *);
@@ -74,6 +125,39 @@ void			 	 	 player_input(
 					    char *);
 struct player				*player_create(
 					    void);
+struct player				*player_new(
+					    struct object *);
+size_t					 player_bytes(
+					    struct player *);
+const char				*player_name(
+					    struct player *);
+int					 player_set_name(
+					    struct player *,
+					    const char *);
+struct player				*player_find(
+					    const char *);
+void					 player_suggest(
+					    struct player *,
+					    const char *);
+struct player				*player_next(
+					    struct player *);
+size_t					 player_count(void);
+const char				*player_prop(
+					    struct player *,
+					    int,
+					    int64_t *);
+int					 player_set_prop(
+					    struct player *,
+					    int,
+					    const char *);
+void					 player_unset_prop(
+					    struct player *,
+					    int);
+void					 player_init(void);
+int					 player_alias(
+					    struct player *,
+					    const char *,
+					    const char *);
 void					 player_free(
 					    struct player *);
 
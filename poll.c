@@ -186,8 +186,12 @@ event_add_evsrc(struct event *ev, struct evsrc *evsrc)
 	return 0;
 }
 
+/*
+ * Waits at most 'timeout' milliseconds for events, or until there is
+ * one if 'timeout' is negative.
+ */
 int
-event_dispatch(struct event *ev)
+event_dispatch(struct event *ev, int timeout)
 {
 	int nready;	
 	int i, nevents;
@@ -197,7 +201,7 @@ event_dispatch(struct event *ev)
 #ifndef INFTIM
 #define INFTIM -1
 #endif
-	nready = poll(ev->pfd, ev->n, INFTIM);
+	nready = poll(ev->pfd, ev->n, timeout >= 0 ? timeout : INFTIM);
 	if (nready == -1 && errno == EINTR)
 		return 0;
 	else if (nready == -1)
@@ -257,7 +261,7 @@ main(int argc, char *argv[])
 		err(1, "event_add_evsrc");
 
 	for (;;)
-		if (event_dispatch(ev) == -1)
+		if (event_dispatch(ev, -1) == -1)
 			err(1, "event_dispatch");
 	
 	event_free(ev);
@@ -0,0 +1,324 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "query.h"
+#include "object.h"
+#include "room.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fnmatch.h>
+
+#define ANY_TYPE	(MAX_OBJ_TYPE + 1)
+
+static const char			*fields[] = {
+	"exits", "children"
+};
+
+static const char			*ops[] = {
+	"=", "!=", "<", "<=", ">", ">="
+};
+
+static size_t				 glob_ns(
+					    const char *,
+					    char *,
+					    size_t);
+static size_t				 ns_cost(
+					    const char *);
+
+void
+query_init(struct query *q)
+{
+	memset(q, 0, sizeof(*q));
+	q->type = ANY_TYPE;
+}
+
+/*
+ * Parses space separated terms such as "type=room in=area/3 exits<2"
+ * into 'q'. A bare term is taken as a key pattern. The query borrows
+ * from 'str'.
+ */
+int
+query_parse(struct query *q, char *str, const char **errstr)
+{
+	char				*term, *next, *name, *val, *ep;
+	size_t				 i, oplen;
+	QueryOp				 op;
+	unsigned long long		 n;
+
+	query_init(q);
+	for (term = str; term != NULL; term = next) {
+		if ((next = strchr(term, ' ')) != NULL)
+			*next++ = '\0';
+		if (*term == '\0')
+			continue;
+
+		name = term;
+		i = strcspn(term, "=!<>");
+		if (term[i] == '\0') {
+			q->glob = term;
+			continue;
+		}
+		val = &term[i];
+		/* Longest operators first */
+		for (op = QUERY_GE; ; op--) {
+			oplen = strlen(ops[op]);
+			if (strncmp(val, ops[op], oplen) == 0)
+				break;
+			if (op == QUERY_EQ) {
+				*errstr = "bad operator";
+				return -1;
+			}
+		}
+		*val = '\0';
+		val += oplen;
+
+		if (op != QUERY_EQ && (strcmp(name, "type") == 0 ||
+		    strcmp(name, "in") == 0 || strcmp(name, "parent") == 0 ||
+		    strcmp(name, "key") == 0)) {
+			*errstr = "only = is supported for that term";
+			return -1;
+		}
+
+		if (strcmp(name, "type") == 0) {
+			q->type = object_type_parse(val);
+			if (q->type == MAX_OBJ_TYPE &&
+			    strcmp(val, "unknown") != 0) {
+				*errstr = "no such type";
+				return -1;
+			}
+		} else if (strcmp(name, "in") == 0) {
+			while ((i = strlen(val)) > 0 && val[i - 1] == '/')
+				val[i - 1] = '\0';
+			q->in = val;
+		} else if (strcmp(name, "key") == 0) {
+			q->glob = val;
+		} else if (strcmp(name, "parent") == 0) {
+			q->parent = object_lookup(val);
+			q->has_parent = 1;
+		} else {
+			for (i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+				if (strcmp(name, fields[i]) == 0)
+					break;
+			if (i == sizeof(fields) / sizeof(fields[0])) {
+				*errstr = "unknown term";
+				return -1;
+			}
+			if (q->ncmp == QUERY_MAX_CMP) {
+				*errstr = "too many terms";
+				return -1;
+			}
+			n = strtoull(val, &ep, 10);
+			if (*val == '\0' || *ep != '\0') {
+				*errstr = "number expected";
+				return -1;
+			}
+			q->cmp[q->ncmp].field = i;
+			q->cmp[q->ncmp].op = op;
+			q->cmp[q->ncmp].n = n;
+			q->ncmp++;
+		}
+	}
+
+	return 0;
+}
+
+static int
+compare(QueryOp op, size_t a, size_t b)
+{
+	switch (op) {
+	case QUERY_EQ:
+		return a == b;
+	case QUERY_NE:
+		return a != b;
+	case QUERY_LT:
+		return a < b;
+	case QUERY_LE:
+		return a <= b;
+	case QUERY_GT:
+		return a > b;
+	case QUERY_GE:
+		return a >= b;
+	}
+
+	return 0;
+}
+
+int
+query_match(struct query *q, struct object *obj)
+{
+	size_t				 i, v;
+
+	if (q->type != ANY_TYPE && obj->type != q->type)
+		return 0;
+	if (q->has_parent && (q->parent == NULL || obj->parent != q->parent))
+		return 0;
+	if (q->in != NULL && (obj->ns == NULL ||
+	    !object_ns_within(obj->ns, q->in)))
+		return 0;
+	if (q->glob != NULL && fnmatch(q->glob, obj->key, 0) == FNM_NOMATCH)
+		return 0;
+
+	for (i = 0; i < q->ncmp; i++) {
+		switch (q->cmp[i].field) {
+		case QUERY_EXITS:
+			if (!IS_ROOM(obj))
+				return 0;
+			v = ROOM(obj)->nexits;
+			break;
+		case QUERY_CHILDREN:
+			v = object_child_count(obj);
+			break;
+		default:
+			return 0;
+		}
+		if (!compare(q->cmp[i].op, v, q->cmp[i].n))
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Namespace a key pattern is confined to, i.e. its literal part up to
+ * the last slash before the first wildcard, e.g. "room" for "room/" and
+ * an asterisk.
+ */
+static size_t
+glob_ns(const char *glob, char *buf, size_t sz)
+{
+	size_t				 len;
+
+	len = strcspn(glob, "*?[\\");
+	while (len > 0 && glob[len - 1] != '/')
+		len--;
+	if (len == 0 || len > sz)
+		return 0;
+
+	memcpy(buf, glob, len - 1);
+	buf[len - 1] = '\0';
+	return len;
+}
+
+static size_t
+ns_cost(const char *prefix)
+{
+	struct objns			*ns;
+	size_t				 cost;
+
+	cost = 0;
+	ns = NULL;
+	while ((ns = object_next_ns(ns)) != NULL)
+		if (object_ns_within(ns, prefix))
+			cost += object_ns_count(ns);
+
+	return cost;
+}
+
+/*
+ * Calls 'fn' for every object matching 'q' and returns their number.
+ * The candidates come from whichever index is expected to yield the
+ * fewest objects; the remaining terms are checked one by one. 'fn'
+ * must not free objects.
+ */
+size_t
+query_run(struct query *q, void (*fn)(struct object *, void *), void *arg)
+{
+	struct object			*obj;
+	struct objns			*ns;
+	char				 gns[256];
+	const char			*prefix;
+	size_t				 best, cost, n;
+	enum {
+		SCAN_ALL, SCAN_TYPE, SCAN_NS, SCAN_PARENT
+	}				 scan;
+
+	scan = SCAN_ALL;
+	best = object_count();
+	prefix = NULL;
+
+	if (q->has_parent) {
+		scan = SCAN_PARENT;
+		best = q->parent != NULL ? object_child_count(q->parent) : 0;
+	}
+	if (q->type != ANY_TYPE &&
+	    (cost = object_type_count(q->type)) < best) {
+		scan = SCAN_TYPE;
+		best = cost;
+	}
+	if (q->in != NULL && (cost = ns_cost(q->in)) < best) {
+		scan = SCAN_NS;
+		best = cost;
+		prefix = q->in;
+	}
+	if (q->glob != NULL && glob_ns(q->glob, gns, sizeof(gns)) > 0 &&
+	    (cost = ns_cost(gns)) < best) {
+		scan = SCAN_NS;
+		best = cost;
+		prefix = gns;
+	}
+
+	n = 0;
+	switch (scan) {
+	case SCAN_PARENT:
+		q->plan = "parent";
+		if (q->parent == NULL)
+			break;
+		obj = NULL;
+		while ((obj = object_next_child(q->parent, obj)) != NULL)
+			if (query_match(q, obj)) {
+				fn(obj, arg);
+				n++;
+			}
+		break;
+	case SCAN_TYPE:
+		q->plan = "type";
+		obj = NULL;
+		while ((obj = object_next_of_type(q->type, obj)) != NULL)
+			if (query_match(q, obj)) {
+				fn(obj, arg);
+				n++;
+			}
+		break;
+	case SCAN_NS:
+		q->plan = "namespace";
+		ns = NULL;
+		while ((ns = object_next_ns(ns)) != NULL) {
+			if (!object_ns_within(ns, prefix))
+				continue;
+			obj = NULL;
+			while ((obj = object_next_in_ns(ns, obj)) != NULL)
+				if (query_match(q, obj)) {
+					fn(obj, arg);
+					n++;
+				}
+		}
+		break;
+	case SCAN_ALL:
+		q->plan = "object";
+		obj = NULL;
+		while ((obj = object_next(obj)) != NULL)
+			if (query_match(q, obj)) {
+				fn(obj, arg);
+				n++;
+			}
+		break;
+	}
+
+	return n;
+}
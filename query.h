@@ -0,0 +1,76 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "object.h"
+
+#include <stddef.h>
+
+#define QUERY_MAX_CMP	8
+
+typedef enum query_field {
+	QUERY_EXITS=0,
+	QUERY_CHILDREN
+} QueryField;
+
+typedef enum query_op {
+	QUERY_EQ=0,
+	QUERY_NE,
+	QUERY_LT,
+	QUERY_LE,
+	QUERY_GT,
+	QUERY_GE
+} QueryOp;
+
+/*
+ * A conjunction of predicates over resident objects. Unset string
+ * members and a type of MAX_OBJ_TYPE + 1 match everything. Strings are
+ * borrowed and must outlive the query.
+ */
+struct query {
+	ObjType				 type;
+	const char			*in;
+	const char			*glob;
+	struct object			*parent;
+	int				 has_parent;
+	struct {
+		QueryField		 field;
+		QueryOp			 op;
+		size_t			 n;
+	}				 cmp[QUERY_MAX_CMP];
+	size_t				 ncmp;
+	const char			*plan;
+};
+
+void					 query_init(
+					    struct query *);
+int					 query_parse(
+					    struct query *,
+					    char *,
+					    const char **);
+int					 query_match(
+					    struct query *,
+					    struct object *);
+size_t					 query_run(
+					    struct query *,
+					    void (*)(struct object *, void *),
+					    void *);
+
+#endif
@@ -21,21 +21,21 @@
 #include "object.h"
 #include "message.h"
 #include "tell.h"
+#include "mem.h"
+#include "tag.h"
+#include "text.h"
+#include "route.h"
+#include "hlset.h"
+#include "action.h"
+#include "arena.h"
 #include <err.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 
-struct desc
-{
-	char			*name;
-	char			*text;
-	int			 tags;
-	size_t			 text_alloc;
-};
-
 #define DESC_CHUNK 4
+#define EXIT_CHUNK 2
 #define LOC_CHUNK 32
 
 #if 0
@@ -49,7 +49,37 @@ int nconflicts;
 
 #include <math.h>
 
-static size_t room_find_exit(struct room *room, const char *key);
+static struct desc *add_desc_quiet(struct room *, DescType, const char *);
+static void remove_variants(struct room *, const char *);
+static char *mem_strdup(MemType, const char *);
+static void mem_free(MemType, char *);
+
+#define STR_BYTES(_s)	(text_borrowed(_s) ? 0 : MEM_STR(_s))
+
+/*
+ * Strings of a mapped snapshot are used as they are, see text_borrow().
+ */
+static char *
+mem_strdup(MemType type, const char *s)
+{
+	char			*p;
+
+	if (text_borrowed(s))
+		return (char *) s;
+	if ((p = strdup(s)) != NULL)
+		mem_inc(type, MEM_STR(p));
+	return p;
+}
+
+static void
+mem_free(MemType type, char *s)
+{
+	if (s == NULL || text_borrowed(s))
+		return;
+	mem_dec(type, MEM_STR(s));
+	free(s);
+}
+
 
 /*
  * For internal usage.
@@ -83,26 +113,139 @@ simple_wrap(const char *p)
 	return out;
 }
 
+static const struct {
+	const char		*name;
+	const char		*abbrev;
+	Direction		 reverse;
+} dirs[MAX_DIRS] = {
+	{ "north", "n", DIR_SOUTH },
+	{ "south", "s", DIR_NORTH },
+	{ "east", "e", DIR_WEST },
+	{ "west", "w", DIR_EAST },
+	{ "northeast", "ne", DIR_SOUTHWEST },
+	{ "northwest", "nw", DIR_SOUTHEAST },
+	{ "southeast", "se", DIR_NORTHWEST },
+	{ "southwest", "sw", DIR_NORTHEAST },
+	{ "up", "u", DIR_DOWN },
+	{ "down", "d", DIR_UP }
+};
+
+/*
+ * Maps both the full and the abbreviated direction names to
+ * Direction. The first character narrows it down to at most three
+ * candidates.
+ */
+Direction
+dir_parse(const char *s)
+{
+	Direction		 cand[3];
+	size_t			 i, n;
+
+	n = 0;
+	switch (s[0]) {
+	case 'n':
+		cand[n++] = DIR_NORTH;
+		cand[n++] = DIR_NORTHEAST;
+		cand[n++] = DIR_NORTHWEST;
+		break;
+	case 's':
+		cand[n++] = DIR_SOUTH;
+		cand[n++] = DIR_SOUTHEAST;
+		cand[n++] = DIR_SOUTHWEST;
+		break;
+	case 'e':
+		cand[n++] = DIR_EAST;
+		break;
+	case 'w':
+		cand[n++] = DIR_WEST;
+		break;
+	case 'u':
+		cand[n++] = DIR_UP;
+		break;
+	case 'd':
+		cand[n++] = DIR_DOWN;
+		break;
+	default:
+		return DIR_CUSTOM;
+	}
+
+	for (i = 0; i < n; i++)
+		if (strcmp(s, dirs[cand[i]].abbrev) == 0 ||
+		    strcmp(s, dirs[cand[i]].name) == 0)
+			return cand[i];
+
+	return DIR_CUSTOM;
+}
+
+const char *
+dir_name(Direction dir)
+{
+	if (dir >= MAX_DIRS)
+		return NULL;
+
+	return dirs[dir].name;
+}
+
+Direction
+dir_reverse(Direction dir)
+{
+	if (dir >= MAX_DIRS)
+		return DIR_CUSTOM;
+
+	return dirs[dir].reverse;
+}
+
 void
 room_save(struct room *room, FILE *fp)
 {
+	static const char	*verbs[MAX_DESC_TYPES] = {
+		"travel", "exit", NULL, NULL, "title", NULL
+	};
+	struct exit		*e;
+	struct desc		*d;
+	char			 cond[MAX_TAGS * (TAG_NAME_MAX + 2)];
 	size_t			 i;
+	int			 j, k;
 
 	fprintf(fp, "goto %s\n", OBJ(room)->key);
+	for (j = 0; j < MAX_TAGS; j++)
+		if (room->tags & TAG_BIT(j))
+			fprintf(fp, "set rtag %s\n", tag_name(j));
 	for (i = 0; i < room->nexits; i++) {
-		fprintf(fp, "dig to:%s %s -\n", room->exit_targets[i],
-		    room->exit_keys[i]);
+		e = &room->exits[i];
+		fprintf(fp, "dig to:%s %s -\n", e->target, e->key);
 	}
-	fprintf(fp, "describe title <\n\t%s\n\t.\n",
-	    simple_wrap(title(OBJ(room))));
+	if (title(OBJ(room)) != NULL)
+		fprintf(fp, "describe title <\n\t%s\n\t.\n",
+		    simple_wrap(title(OBJ(room))));
 	for (i = 0; i < room->nexits; i++) {
-		fprintf(fp, "describe travel %s <\n\t%s\n\t.\n",
-		    room->exit_keys[i], simple_wrap(travel_desc(room,
-		    room->exit_keys[i])));
-		fprintf(fp, "describe exit %s <\n\t%s\n\t.\n",
-		    room->exit_keys[i], simple_wrap(exit_desc(room,
-		    room->exit_keys[i])));
+		e = &room->exits[i];
+		if (e->travel_desc != NULL)
+			fprintf(fp, "describe travel %s <\n\t%s\n\t.\n",
+			    e->key, simple_wrap(e->travel_desc));
+		if (e->desc != NULL)
+			fprintf(fp, "describe exit %s <\n\t%s\n\t.\n",
+			    e->key, simple_wrap(e->desc));
+	}
+	for (j = 0; j < MAX_DESC_TYPES; j++) {
+		if (verbs[j] == NULL)
+			continue;
+		for (k = 0; k < room->n_desc[j]; k++) {
+			d = &room->desc[j][k];
+			if (d->req == 0 && d->forbid == 0)
+				continue;
+			tag_format(d->req, d->forbid, cond, sizeof(cond));
+			fprintf(fp, "describe %s%s%s tag:%s <\n\t%s\n\t.\n",
+			    verbs[j], d->name != NULL ? " " : "",
+			    d->name != NULL ? d->name : "", cond,
+			    simple_wrap(d->text));
+		}
 	}
+	if (OBJ(room)->actions != NULL)
+		for (i = 0; i < OBJ(room)->actions->n; i++)
+			fprintf(fp, "action %s <\n\t%s\n\t.\n",
+			    OBJ(room)->actions->act[i].name,
+			    simple_wrap(OBJ(room)->actions->act[i].src));
 	fprintf(fp, "\n");
 }
 
@@ -112,71 +255,218 @@ room_exit_target(struct room *room, const char *key)
 	size_t			 i;
 
 	i = room_find_exit(room, key);
-	if (i == MAX_EXITS)
+	if (i == room->nexits)
 		return 0;
 
-	return room->exit_targets[i];
+	return room->exits[i].target;
+}
+
+/*
+ * Returns the object the i'th exit leads to. The object is looked up
+ * from the object table only on the first use, or after the target
+ * has been freed in the meanwhile.
+ */
+struct object *
+room_exit_object(struct room *room, size_t i)
+{
+	struct object		*obj;
+
+	if (i >= room->nexits)
+		return NULL;
+
+	if ((obj = object_deref(room->exits[i].obj)) == NULL) {
+		obj = object_find(room->exits[i].target);
+		room->exits[i].obj = object_handle(obj);
+	} else if (IS_ROOM(obj))
+		ROOM(obj)->flags |= ROOM_REF;
+
+	return obj;
+}
+
+/*
+ * Fills 'keys' with the exit names, e.g. for match_input() and
+ * highlight(). The array must have room for room->nexits entries.
+ */
+size_t
+room_exit_keys(struct room *room, const char **keys)
+{
+	size_t			 i;
+
+	for (i = 0; i < room->nexits; i++)
+		keys[i] = room->exits[i].key;
+
+	return room->nexits;
+}
+
+/*
+ * The phrases to highlight in the room's texts: its exits and the
+ * players in it. Compiled when first needed and kept until one of
+ * them changes.
+ */
+const struct hlset *
+room_highlight(struct room *room)
+{
+	struct object		*obj;
+	const char		**keys;
+	ArenaMark		 mark;
+	size_t			 n;
+
+	if (room->hl != NULL)
+		return room->hl;
+
+	mark = arena_mark();
+	if ((keys = arena_alloc((room->nexits + OBJ(room)->nplayers + 1) *
+	    sizeof(*keys))) != NULL) {
+		n = room_exit_keys(room, keys);
+		obj = NULL;
+		while ((obj = object_next_player(OBJ(room), obj)) != NULL)
+			if (PLAYER(obj) != NULL)
+				keys[n++] = player_name(PLAYER(obj));
+		room->hl = hlset_new(keys, n);
+	}
+	arena_release(mark);
+
+	return room->hl;
+}
+
+void
+room_highlight_invalidate(struct room *room)
+{
+	hlset_free(room->hl);
+	room->hl = NULL;
 }
 
+/*
+ * Returns the index of the exit, or room->nexits if there is none.
+ * Directions are looked up from the direction table; only custom
+ * exits are compared by name.
+ */
 size_t
 room_find_exit(struct room *room, const char *key)
 {
+	Direction		 dir;
 	size_t			 i;
 
+	if ((dir = dir_parse(key)) != DIR_CUSTOM) {
+		if (HAS_DIR(room, dir))
+			return room->dir_exit[dir];
+		return room->nexits;
+	}
+
 	for (i = 0; i < room->nexits; i++)
-		if (room->exit_keys[i] != NULL &&
-		    strcmp(room->exit_keys[i], key) == 0)
+		if (room->exits[i].dir == DIR_CUSTOM &&
+		    strcmp(room->exits[i].key, key) == 0)
 			break;
 
 	return i;
 }
 
-int
-room_add_exit(struct room *room, const char *key, const char *target)
+static int
+exit_append(struct room *room, const char *key, const char *target)
 {
-	size_t			 i;
+	struct exit		*e;
+	size_t			 alloc;
+	Direction		 dir;
 
 	if (room->nexits == MAX_EXITS)
 		return -1;
 	if (room_find_exit(room, key) != room->nexits)
 		return -1;
 
-	i = room->nexits++;
-	if ((room->exit_keys[i] = strdup(key)) == NULL)
+	if (room->nexits == room->alloc_exits) {
+		alloc = room->alloc_exits + EXIT_CHUNK;
+		if (alloc > MAX_EXITS)
+			alloc = MAX_EXITS;
+		e = realloc(room->exits, alloc * sizeof(struct exit));
+		if (e == NULL)
+			return -1;
+		if (room->alloc_exits > 0)
+			mem_dec(MEM_EXIT,
+			    room->alloc_exits * sizeof(struct exit));
+		mem_inc(MEM_EXIT, alloc * sizeof(struct exit));
+		room->exits = e;
+		room->alloc_exits = alloc;
+	}
+
+	e = &room->exits[room->nexits];
+	memset(e, 0, sizeof(*e));
+	dir = dir_parse(key);
+	if (dir != DIR_CUSTOM && strcmp(key, dir_name(dir)) != 0)
+		key = dir_name(dir);
+	if ((e->key = mem_strdup(MEM_EXIT, key)) == NULL)
+		return -1;
+	if ((e->target = mem_strdup(MEM_EXIT, target)) == NULL) {
+		mem_free(MEM_EXIT, e->key);
 		return -1;
-	if ((room->exit_targets[i] = strdup(target)) == NULL)
+	}
+	e->obj = OBJ_HANDLE_NONE;
+	e->dir = dir;
+	if (dir != DIR_CUSTOM) {
+		room->dirmask |= (1 << dir);
+		room->dir_exit[dir] = room->nexits;
+	}
+	room->nexits++;
+	room_highlight_invalidate(room);
+	return 0;
+}
+
+int
+room_add_exit(struct room *room, const char *key, const char *target)
+{
+	if (room_load_exit(room, key, target) == -1)
 		return -1;
+	route_invalidate();
 
-	tellrf(OBJ(room), NULL, "A way to %s appears leads to %s.", key,
-	    target);
+	tellrf(OBJ(room), NULL, "A way to %s appears leads to %s.",
+	    room->exits[room->nexits-1].key, target);
 
 	return 0;
 }
 
+/*
+ * Like room_add_exit(), but tells nobody; for loading the world.
+ */
+int
+room_load_exit(struct room *room, const char *key, const char *target)
+{
+	if (exit_append(room, key, target) == -1)
+		return -1;
+
+	room->flags |= ROOM_DIRTY;
+	return 0;
+}
+
 int
 room_remove_exit(struct room *room, const char *key)
 {
+	struct exit		*e;
 	size_t			 i;
+	int			 d;
 
 	if ((i = room_find_exit(room, key)) == room->nexits)
 		return -1;
 
+	e = &room->exits[i];
+	if (e->dir != DIR_CUSTOM)
+		room->dirmask &= ~(1 << e->dir);
+	room->flags |= ROOM_DIRTY;
+	mem_free(MEM_EXIT, e->key);
+	mem_free(MEM_EXIT, e->target);
+	text_release(e->travel_desc);
+	text_release(e->desc);
+	remove_variants(room, key);
+	room_highlight_invalidate(room);
+	route_invalidate();
+
 	room->nexits--;
 	if (room->nexits > i) {
-		if (room->exit_keys[i] != NULL)
-			free(room->exit_keys[i]);
-		if (room->exit_targets[i] != NULL)
-			free(room->exit_targets[i]);
-		memmove(&room->exit_keys[i], &room->exit_keys[i+1],
-		    sizeof(char *) * (room->nexits - i));
-		memmove(&room->exit_targets[i], &room->exit_targets[i+1],
-		    sizeof(char *) * (room->nexits - i));
-		memmove(&room->exit_travel_desc[i],
-		    &room->exit_travel_desc[i+1],
-		    sizeof(char *) * (room->nexits - i));
-		memmove(&room->exit_desc[i], &room->exit_desc[i+1],
-		    sizeof(char *) * (room->nexits - i));
+		memmove(&room->exits[i], &room->exits[i+1],
+		    sizeof(struct exit) * (room->nexits - i));
+		for (d = 0; d < MAX_DIRS; d++)
+			if (HAS_DIR(room, d) && room->dir_exit[d] > i)
+				room->dir_exit[d]--;
 	}
+
 	tellrf(OBJ(room), NULL, "A way to %s disappears.", key);
 	return 0;
 }
@@ -184,22 +474,36 @@ room_remove_exit(struct room *room, const char *key)
 struct room *
 room_create(struct object *obj, const char *id)
 {
-	obj->v.room = calloc(1, sizeof(struct room));
+	if ((obj->v.room = calloc(1, sizeof(struct room))) == NULL)
+		err(1, "calloc");
+	mem_inc(MEM_ROOM, sizeof(struct room));
 	obj->v.room->object = obj;
 
 	return obj->v.room;
 }
 
-int
+/*
+ * Heap memory held by the room, not counting the object and its title.
+ */
+size_t
 room_bytes(struct room *room)
 {
-	int i, j, bytes;
+	size_t i, bytes;
+	int j;
+	struct exit *e;
 
 	bytes = sizeof(struct room);
+	bytes += room->alloc_exits * sizeof(struct exit);
+	for (i = 0; i < room->nexits; i++) {
+		e = &room->exits[i];
+		bytes += STR_BYTES(e->key) + STR_BYTES(e->target) +
+		    text_bytes(e->travel_desc) + text_bytes(e->desc);
+	}
 	for (i = 0; i < MAX_DESC_TYPES; i++) {
 		bytes += room->alloc_desc[i] * sizeof(struct desc);
 		for (j = 0; j < room->n_desc[i]; j++) {
-			bytes += room->desc[i][j].text_alloc;
+			bytes += text_bytes(room->desc[i][j].text) +
+			    STR_BYTES(room->desc[i][j].name);
 		}
 	}
 
@@ -209,6 +513,30 @@ room_bytes(struct room *room)
 void
 room_free(struct room *room)
 {
+	size_t i;
+	int j, k;
+
+	for (i = 0; i < room->nexits; i++) {
+		mem_free(MEM_EXIT, room->exits[i].key);
+		mem_free(MEM_EXIT, room->exits[i].target);
+		text_release(room->exits[i].travel_desc);
+		text_release(room->exits[i].desc);
+	}
+	if (room->exits != NULL)
+		mem_dec(MEM_EXIT, room->alloc_exits * sizeof(struct exit));
+	free(room->exits);
+	for (j = 0; j < MAX_DESC_TYPES; j++) {
+		for (k = 0; k < room->n_desc[j]; k++) {
+			text_release(room->desc[j][k].text);
+			mem_free(MEM_DESC, room->desc[j][k].name);
+		}
+		if (room->desc[j] != NULL)
+			mem_dec(MEM_DESC,
+			    room->alloc_desc[j] * sizeof(struct desc));
+		free(room->desc[j]);
+	}
+	hlset_free(room->hl);
+	mem_dec(MEM_ROOM, sizeof(struct room));
 	free(room);
 }
 
@@ -223,11 +551,23 @@ room_desc(struct room *room, DescType type)
 
 void
 add_desc(struct room *room, DescType type, const char *str)
+{
+	add_desc_quiet(room, type, str);
+	room->flags |= ROOM_DIRTY;
+
+	tellrf(OBJ(room), NULL, "Something here seems different.");
+}
+
+static struct desc *
+add_desc_quiet(struct room *room, DescType type, const char *str)
 {
 	struct desc *d;
-	char *p;
+	const char *p;
 
 	if (room->n_desc[type] == room->alloc_desc[type]) {
+		if (room->alloc_desc[type] != 0)
+			mem_dec(MEM_DESC,
+			    sizeof(struct desc) * room->alloc_desc[type]);
 		if (room->alloc_desc[type] == 0)
 			room->alloc_desc[type] = DESC_CHUNK;
 		else
@@ -237,21 +577,175 @@ add_desc(struct room *room, DescType type, const char *str)
 		if (d == NULL) {
 			err(1, "realloc, tried +%lu bytes",
 			    sizeof(struct desc) * room->alloc_desc[type]);
-			return;
+			return NULL;
 		}
+		mem_inc(MEM_DESC, sizeof(struct desc) * room->alloc_desc[type]);
 		room->desc[type] = d;
 	}
 
-	p = strdup(str);
+	p = text_intern(str);
 	if (p == NULL) {
-		err(1, "strdup");
-		return;
+		err(1, "text_intern");
+		return NULL;
 	}
-	room->desc[type][room->n_desc[type]].text = p;
-	room->desc[type][room->n_desc[type]].text_alloc = strlen(str) + 1;
-	room->n_desc[type] = 0;
+	d = &room->desc[type][room->n_desc[type]++];
+	memset(d, 0, sizeof(*d));
+	d->text = p;
+	return d;
+}
 
+static int
+popcount(TagSet t)
+{
+	int				 n;
+
+	for (n = 0; t != 0; n++)
+		t &= t - 1;
+	return n;
+}
+
+static int
+variant_set(struct room *room, DescType type, const char *name,
+    TagSet req, TagSet forbid, const char *str)
+{
+	struct desc			*d;
+	const char			*p;
+	int				 i;
+
+	for (i = 0; i < room->n_desc[type]; i++) {
+		d = &room->desc[type][i];
+		if (d->req != req || d->forbid != forbid)
+			continue;
+		if ((d->name == NULL) != (name == NULL) ||
+		    (name != NULL && strcmp(d->name, name) != 0))
+			continue;
+		if ((p = text_intern(str)) == NULL)
+			return -1;
+		text_release(d->text);
+		d->text = p;
+		return 0;
+	}
+
+	if ((d = add_desc_quiet(room, type, str)) == NULL)
+		return -1;
+	if (name != NULL && (d->name = mem_strdup(MEM_DESC, name)) == NULL)
+		return -1;
+	d->req = req;
+	d->forbid = forbid;
+	d->spec = popcount(req | forbid);
+	return 0;
+}
+
+/*
+ * Adds a description variant shown when the viewer's tags satisfy
+ * 'req' and 'forbid', or replaces the text of one with the same
+ * condition.
+ */
+int
+room_set_variant(struct room *room, DescType type, const char *name,
+    TagSet req, TagSet forbid, const char *str)
+{
+	if (room_load_variant(room, type, name, req, forbid, str) == -1)
+		return -1;
 	tellrf(OBJ(room), NULL, "Something here seems different.");
+	return 0;
+}
+
+int
+room_load_variant(struct room *room, DescType type, const char *name,
+    TagSet req, TagSet forbid, const char *str)
+{
+	if (variant_set(room, type, name, req, forbid, str) == -1)
+		return -1;
+	room->flags |= ROOM_DIRTY;
+	return 0;
+}
+
+/*
+ * Text of the best variant of 'type' and 'name' for a viewer with tags
+ * 'have', or NULL if none applies.
+ */
+const char *
+room_variant(struct room *room, DescType type, const char *name,
+    TagSet have)
+{
+	struct desc			*d, *best;
+	int				 i;
+
+	best = NULL;
+	for (i = 0; i < room->n_desc[type]; i++) {
+		d = &room->desc[type][i];
+		if (!TAG_MATCH(have, d->req, d->forbid))
+			continue;
+		if (best != NULL && best->spec >= d->spec)
+			continue;
+		if ((d->name == NULL) != (name == NULL) ||
+		    (name != NULL && strcmp(d->name, name) != 0))
+			continue;
+		best = d;
+	}
+
+	return best != NULL ? best->text : NULL;
+}
+
+static void
+remove_variants(struct room *room, const char *name)
+{
+	struct desc			*d;
+	DescType			 type;
+	int				 i;
+
+	for (type = 0; type < MAX_DESC_TYPES; type++)
+		for (i = 0; i < room->n_desc[type]; ) {
+			d = &room->desc[type][i];
+			if (d->name == NULL || strcmp(d->name, name) != 0) {
+				i++;
+				continue;
+			}
+			text_release(d->text);
+			mem_free(MEM_DESC, d->name);
+			memmove(d, d + 1, sizeof(*d) *
+			    (room->n_desc[type] - i - 1));
+			room->n_desc[type]--;
+		}
+}
+
+const char *
+room_title(struct room *room, TagSet have)
+{
+	const char			*s;
+
+	if (room->n_desc[DESC_TITLE] > 0 &&
+	    (s = room_variant(room, DESC_TITLE, NULL, have)) != NULL)
+		return s;
+
+	return title(OBJ(room));
+}
+
+const char *
+exit_travel_text(struct room *room, size_t i, TagSet have)
+{
+	const char			*s;
+
+	if (room->n_desc[DESC_ENTER] > 0 &&
+	    (s = room_variant(room, DESC_ENTER, room->exits[i].key,
+	    have)) != NULL)
+		return s;
+
+	return room->exits[i].travel_desc;
+}
+
+const char *
+exit_text(struct room *room, size_t i, TagSet have)
+{
+	const char			*s;
+
+	if (room->n_desc[DESC_EXIT] > 0 &&
+	    (s = room_variant(room, DESC_EXIT, room->exits[i].key,
+	    have)) != NULL)
+		return s;
+
+	return room->exits[i].desc;
 }
 
 const char *
@@ -262,7 +756,7 @@ travel_desc(struct room *room, const char *dkey)
 	if ((i = room_find_exit(room, dkey)) == room->nexits)
 		return NULL;
 
-	return room->exit_travel_desc[i];
+	return room->exits[i].travel_desc;
 }
 
 const char *
@@ -273,33 +767,286 @@ exit_desc(struct room *room, const char *dkey)
 	if ((i = room_find_exit(room, dkey)) == room->nexits)
 		return NULL;
 
-	return room->exit_desc[i];
+	return room->exits[i].desc;
 }
 
 void
 set_travel_desc(struct room *room, const char *dkey, const char *str)
 {
-	size_t				 i;
+	tellrf(OBJ(room), NULL, "Something changes in %s.", dkey);
+	room_load_text(room, DESC_ENTER, dkey, str);
+}
 
+void
+set_exit_desc(struct room *room, const char *dkey, const char *str)
+{
 	tellrf(OBJ(room), NULL, "Something changes in %s.", dkey);
+	room_load_text(room, DESC_EXIT, dkey, str);
+}
+
+/*
+ * Sets the travel (DESC_ENTER) or exit (DESC_EXIT) text of exit 'dkey'
+ * without telling anybody. Returns -1 if there is no such exit.
+ */
+int
+room_load_text(struct room *room, DescType type, const char *dkey,
+    const char *str)
+{
+	const char			*p, **dst;
+	size_t				 i;
 
 	if ((i = room_find_exit(room, dkey)) == room->nexits)
-		return;
+		return -1;
 
-	if ((room->exit_travel_desc[i] = strdup(str)) == NULL)
+	dst = type == DESC_ENTER ? &room->exits[i].travel_desc :
+	    &room->exits[i].desc;
+	if ((p = text_intern(str)) == NULL)
+		return -1;
+	text_release(*dst);
+	*dst = p;
+	room->flags |= ROOM_DIRTY;
+	return 0;
+}
+
+/*
+ * Packed rooms are used by the world store. All integers are in host
+ * byte order; strings are a 16-bit length followed by the bytes, with
+ * length PACK_NULL standing for a NULL string.
+ */
+#define PACK_NULL	UINT16_MAX
+
+struct pack {
+	char			*buf;
+	size_t			 len;
+	size_t			 alloc;
+	int			 error;
+};
+
+static void
+pack_bytes(struct pack *pk, const void *p, size_t len)
+{
+	char			*np;
+	size_t			 alloc;
+
+	if (pk->error)
 		return;
+	if (pk->len + len > pk->alloc) {
+		alloc = pk->alloc == 0 ? 256 : pk->alloc;
+		while (alloc < pk->len + len)
+			alloc *= 2;
+		if ((np = realloc(pk->buf, alloc)) == NULL) {
+			pk->error = 1;
+			return;
+		}
+		pk->buf = np;
+		pk->alloc = alloc;
+	}
+	memcpy(&pk->buf[pk->len], p, len);
+	pk->len += len;
 }
 
-void
-set_exit_desc(struct room *room, const char *dkey, const char *str)
+static void
+pack_u16(struct pack *pk, uint16_t v)
 {
-	size_t				 i;
+	pack_bytes(pk, &v, sizeof(v));
+}
 
-	tellrf(OBJ(room), NULL, "Something changes in %s.", dkey);
+static void
+pack_str(struct pack *pk, const char *s)
+{
+	size_t			 len;
 
-	if ((i = room_find_exit(room, dkey)) == room->nexits)
+	if (s == NULL) {
+		pack_u16(pk, PACK_NULL);
 		return;
-
-	if ((room->exit_desc[i] = strdup(str)) == NULL)
+	}
+	len = strlen(s);
+	if (len >= PACK_NULL) {
+		pk->error = 1;
 		return;
+	}
+	pack_u16(pk, len);
+	pack_bytes(pk, s, len);
+}
+
+static int
+unpack_u16(const char **p, const char *end, uint16_t *v)
+{
+	if (end - *p < (ptrdiff_t) sizeof(*v))
+		return -1;
+	memcpy(v, *p, sizeof(*v));
+	*p += sizeof(*v);
+	return 0;
+}
+
+static int
+unpack_str(const char **p, const char *end, char **s)
+{
+	uint16_t		 len;
+
+	*s = NULL;
+	if (unpack_u16(p, end, &len) == -1)
+		return -1;
+	if (len == PACK_NULL)
+		return 0;
+	if (end - *p < len)
+		return -1;
+	if ((*s = malloc(len + 1)) == NULL)
+		return -1;
+	memcpy(*s, *p, len);
+	(*s)[len] = '\0';
+	*p += len;
+	return 0;
+}
+
+/*
+ * Returns a malloc'd buffer holding the room, or NULL on failure.
+ */
+char *
+room_pack(struct room *room, size_t *len)
+{
+	struct pack		 pk;
+	struct exit		*e;
+	struct desc		*d;
+	struct actset		*as;
+	char			 cond[MAX_TAGS * (TAG_NAME_MAX + 2)];
+	size_t			 i;
+	int			 j, k;
+
+	memset(&pk, 0, sizeof(pk));
+	pack_str(&pk, title(OBJ(room)));
+	tag_format(room->tags, 0, cond, sizeof(cond));
+	pack_str(&pk, cond);
+	pack_u16(&pk, room->nexits);
+	for (i = 0; i < room->nexits; i++) {
+		e = &room->exits[i];
+		pack_str(&pk, e->key);
+		pack_str(&pk, e->target);
+		pack_str(&pk, e->travel_desc);
+		pack_str(&pk, e->desc);
+	}
+	for (j = 0; j < MAX_DESC_TYPES; j++) {
+		pack_u16(&pk, room->n_desc[j]);
+		for (k = 0; k < room->n_desc[j]; k++) {
+			d = &room->desc[j][k];
+			tag_format(d->req, d->forbid, cond, sizeof(cond));
+			pack_str(&pk, d->name);
+			pack_str(&pk, cond);
+			pack_str(&pk, d->text);
+		}
+	}
+	as = OBJ(room)->actions;
+	pack_u16(&pk, as != NULL ? as->n : 0);
+	for (i = 0; as != NULL && i < as->n; i++) {
+		pack_str(&pk, as->act[i].name);
+		pack_str(&pk, as->act[i].src);
+	}
+
+	if (pk.error) {
+		free(pk.buf);
+		return NULL;
+	}
+	*len = pk.len;
+	return pk.buf;
+}
+
+/*
+ * Fills an empty room from a buffer made by room_pack(). No one is
+ * told about the new exits or descriptions, and the room is left
+ * clean.
+ */
+int
+room_unpack(struct room *room, const char *buf, size_t len)
+{
+	const char		*p, *end, *errstr;
+	char			*s, *key, *target, *cond;
+	struct exit		*e;
+	TagSet			 req, forbid;
+	uint16_t		 i, n;
+	int			 j;
+
+	p = buf;
+	end = buf + len;
+
+	if (unpack_str(&p, end, &s) == -1)
+		return -1;
+	if (s != NULL) {
+		set_title(OBJ(room), s);
+		free(s);
+	}
+	if (unpack_str(&p, end, &s) == -1)
+		return -1;
+	if (s != NULL) {
+		tag_parse_cond(s, &room->tags, &forbid, &errstr);
+		free(s);
+	}
+
+	if (unpack_u16(&p, end, &n) == -1)
+		return -1;
+	for (i = 0; i < n; i++) {
+		if (unpack_str(&p, end, &key) == -1)
+			return -1;
+		if (unpack_str(&p, end, &target) == -1 || key == NULL ||
+		    target == NULL || exit_append(room, key, target) == -1) {
+			free(key);
+			free(target);
+			return -1;
+		}
+		free(key);
+		free(target);
+		e = &room->exits[room->nexits-1];
+		if (unpack_str(&p, end, &s) == -1)
+			return -1;
+		e->travel_desc = text_intern(s);
+		free(s);
+		if (unpack_str(&p, end, &s) == -1)
+			return -1;
+		e->desc = text_intern(s);
+		free(s);
+	}
+
+	for (j = 0; j < MAX_DESC_TYPES; j++) {
+		if (unpack_u16(&p, end, &n) == -1)
+			return -1;
+		for (i = 0; i < n; i++) {
+			if (unpack_str(&p, end, &key) == -1)
+				return -1;
+			if (unpack_str(&p, end, &cond) == -1 ||
+			    unpack_str(&p, end, &s) == -1) {
+				free(key);
+				free(cond);
+				return -1;
+			}
+			req = forbid = 0;
+			if (s != NULL && (cond == NULL ||
+			    tag_parse_cond(cond, &req, &forbid, &errstr) == 0))
+				variant_set(room, j, key, req, forbid, s);
+			free(key);
+			free(cond);
+			free(s);
+		}
+	}
+
+	/* Rooms packed before there were actions end here. */
+	if (p < end) {
+		if (unpack_u16(&p, end, &n) == -1)
+			return -1;
+		for (i = 0; i < n; i++) {
+			if (unpack_str(&p, end, &key) == -1)
+				return -1;
+			if (unpack_str(&p, end, &s) == -1) {
+				free(key);
+				return -1;
+			}
+			if (key != NULL && s != NULL &&
+			    action_set(OBJ(room), key, s, &errstr) == -1)
+				warnx("%s: action %s: %s", OBJ(room)->key, key,
+				    errstr);
+			free(key);
+			free(s);
+		}
+	}
+
+	room->flags &= ~ROOM_DIRTY;
+	return 0;
 }
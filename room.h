@@ -20,8 +20,12 @@
 #define LOC_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
+#include "object.h"
+#include "tag.h"
+
 struct player;
 struct object;
 
@@ -36,7 +40,57 @@ typedef enum desc_type
 	MAX_DESC_TYPES
 } DescType;
 
-#define MAX_EXITS		8
+/*
+ * Cardinal and vertical directions are recognized without string
+ * comparisons. Any other exit name is a DIR_CUSTOM exit.
+ */
+typedef enum direction
+{
+	DIR_NORTH=0,
+	DIR_SOUTH,
+	DIR_EAST,
+	DIR_WEST,
+	DIR_NORTHEAST,
+	DIR_NORTHWEST,
+	DIR_SOUTHEAST,
+	DIR_SOUTHWEST,
+	DIR_UP,
+	DIR_DOWN,
+	MAX_DIRS,
+	DIR_CUSTOM=MAX_DIRS
+} Direction;
+
+/*
+ * Description variant. 'name' is the exit or detail it describes, if
+ * any. Of the variants whose condition holds for the viewer, the one
+ * with the most tags in its condition ('spec') wins.
+ */
+struct desc
+{
+	char			*name;
+	const char		*text;
+	TagSet			 req;
+	TagSet			 forbid;
+	int			 spec;
+};
+
+#define MAX_EXITS		UINT16_MAX
+
+struct exit
+{
+	char			*key;
+	char			*target;
+	const char		*travel_desc;	/* Shared, see text.h */
+	const char		*desc;
+
+	/*
+	 * Resolved target. Filled lazily by room_exit_object() and
+	 * dropped whenever the exit changes; a freed target is noticed
+	 * through its stale handle.
+	 */
+	ObjHandle		 obj;
+	uint8_t			 dir;
+};
 
 struct room
 {
@@ -44,19 +98,33 @@ struct room
 	int			 n_desc[MAX_DESC_TYPES];
 	int			 alloc_desc[MAX_DESC_TYPES];
 	size_t			 k;
-	size_t			 nexits;
-	char			*exit_keys[MAX_EXITS];
-	char			*exit_targets[MAX_EXITS];
-	char			*exit_travel_desc[MAX_EXITS];
-	char			*exit_desc[MAX_EXITS];
+	struct exit		*exits;
+	uint16_t		 nexits;
+	uint16_t		 alloc_exits;
+	uint16_t		 dirmask;
+	uint16_t		 dir_exit[MAX_DIRS];
+	uint8_t			 flags;
+	TagSet			 tags;
+	struct hlset		*hl;		/* See room_highlight() */
 	struct room		*next;
 	struct object		*object;
 };
 
+#define ROOM_REF		0x01	/* Referenced since last clock sweep */
+#define ROOM_DIRTY		0x02	/* Changed since loaded or saved */
+
+#define HAS_DIR(_r, _d)		((_r)->dirmask & (1 << (_d)))
+
+Direction			 dir_parse(const char *);
+const char			*dir_name(Direction);
+Direction			 dir_reverse(Direction);
+
 struct room			*room_create(
 				    struct object *,
 				    const char *);
 struct room			*room_find(size_t);
+void				 room_free(struct room *);
+size_t				 room_bytes(struct room *);
 
 size_t				 room_next_id(void);
 
@@ -79,19 +147,76 @@ void				 set_exit_desc(
 void				 room_save(
 				    struct room *,
 				    FILE *);
+char				*room_pack(
+				    struct room *,
+				    size_t *);
+int				 room_unpack(
+				    struct room *,
+				    const char *,
+				    size_t);
 
 const char			*room_exit_target(
 				    struct room *,
 				    const char *);
+struct object			*room_exit_object(
+				    struct room *,
+				    size_t);
+size_t				 room_find_exit(
+				    struct room *,
+				    const char *);
+size_t				 room_exit_keys(
+				    struct room *,
+				    const char **);
+const struct hlset		*room_highlight(
+				    struct room *);
+void				 room_highlight_invalidate(
+				    struct room *);
 
 int				 room_add_exit(struct room *, const char *,
 				    const char *);
 
+int				 room_load_exit(struct room *, const char *,
+				    const char *);
 int				 room_remove_exit(struct room *, const char *);
 
 const char			*room_desc(struct room *, DescType);
 
 void				 add_desc(struct room *, DescType type,
 				    const char *);
+int				 room_set_variant(
+				    struct room *,
+				    DescType,
+				    const char *,
+				    TagSet,
+				    TagSet,
+				    const char *);
+int				 room_load_variant(
+				    struct room *,
+				    DescType,
+				    const char *,
+				    TagSet,
+				    TagSet,
+				    const char *);
+int				 room_load_text(
+				    struct room *,
+				    DescType,
+				    const char *,
+				    const char *);
+const char			*room_variant(
+				    struct room *,
+				    DescType,
+				    const char *,
+				    TagSet);
+const char			*room_title(
+				    struct room *,
+				    TagSet);
+const char			*exit_travel_text(
+				    struct room *,
+				    size_t,
+				    TagSet);
+const char			*exit_text(
+				    struct room *,
+				    size_t,
+				    TagSet);
 
 #endif
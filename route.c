@@ -0,0 +1,510 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "route.h"
+#include "object.h"
+#include "room.h"
+#include "mem.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROUTE_CACHE_SZ		256
+#define ROUTE_NONE		UINT32_MAX
+
+/*
+ * Nodes are numbered by object slot index, so a room's node is found
+ * from its handle without a lookup. 'off' and 'adj' hold the outgoing
+ * edges of each node, 'roff' and 'radj' the incoming ones.
+ */
+struct graph {
+	size_t				 n;
+	size_t				 m;
+	uint32_t			*off;
+	uint32_t			*adj;
+	uint32_t			*roff;
+	uint32_t			*radj;
+	ObjHandle			*handle;
+
+	/* Search state, valid for the current 'epoch' */
+	uint32_t			 epoch;
+	uint32_t			*fmark;
+	uint32_t			*bmark;
+	uint32_t			*fpar;
+	uint32_t			*bpar;
+	uint32_t			*fdist;
+	uint32_t			*bdist;
+	uint32_t			*fq;
+	uint32_t			*bq;
+};
+
+struct route {
+	ObjHandle			 src;
+	ObjHandle			 dst;
+	ObjHandle			*path;
+	size_t				 len;
+	int				 found;
+	struct route			*prev;	/* LRU order */
+	struct route			*next;
+	struct route			*next_hash;
+};
+
+static struct graph			 _g;
+static int				 _stale = 1;
+static struct route			 _routes[ROUTE_CACHE_SZ];
+static struct route			*_rhash[ROUTE_CACHE_SZ];
+static struct route			*_lru_head;
+static struct route			*_lru_tail;
+static size_t				 _nroutes;
+
+static int				 graph_build(void);
+static void				 graph_free(void);
+static int				 graph_has(struct object *);
+static int				 path_live(const struct route *);
+static int				 search(uint32_t, uint32_t,
+				    ObjHandle **, size_t *);
+
+/*
+ * Called whenever exits are added or removed. Rooms faulted in or
+ * evicted change no edge of the world: an evicted room is skipped by
+ * the search, and a room that came in since the graph was built makes
+ * the first query that starts or ends there rebuild it.
+ */
+void
+route_invalidate(void)
+{
+	size_t				 i;
+
+	if (_stale)
+		return;
+	_stale = 1;
+
+	for (i = 0; i < _nroutes; i++) {
+		free(_routes[i].path);
+		if (_routes[i].len > 0)
+			mem_dec(MEM_INDEX,
+			    _routes[i].len * sizeof(ObjHandle));
+	}
+	memset(_routes, 0, sizeof(_routes));
+	memset(_rhash, 0, sizeof(_rhash));
+	_lru_head = _lru_tail = NULL;
+	_nroutes = 0;
+}
+
+static size_t
+route_hash(ObjHandle src, ObjHandle dst)
+{
+	return (src * 2654435761U ^ dst) % ROUTE_CACHE_SZ;
+}
+
+static void
+lru_unlink(struct route *r)
+{
+	if (r->prev != NULL)
+		r->prev->next = r->next;
+	else
+		_lru_head = r->next;
+	if (r->next != NULL)
+		r->next->prev = r->prev;
+	else
+		_lru_tail = r->prev;
+	r->prev = r->next = NULL;
+}
+
+static void
+lru_push(struct route *r)
+{
+	r->prev = NULL;
+	if ((r->next = _lru_head) != NULL)
+		_lru_head->prev = r;
+	else
+		_lru_tail = r;
+	_lru_head = r;
+}
+
+/*
+ * Takes the least recently used entry out of the cache for reuse.
+ */
+static struct route *
+route_evict(void)
+{
+	struct route			*r, **rp;
+
+	if (_nroutes < ROUTE_CACHE_SZ)
+		return &_routes[_nroutes++];
+
+	r = _lru_tail;
+	lru_unlink(r);
+	for (rp = &_rhash[route_hash(r->src, r->dst)]; *rp != NULL;
+	    rp = &(*rp)->next_hash)
+		if (*rp == r) {
+			*rp = r->next_hash;
+			break;
+		}
+	free(r->path);
+	if (r->len > 0)
+		mem_dec(MEM_INDEX, r->len * sizeof(ObjHandle));
+	memset(r, 0, sizeof(*r));
+	return r;
+}
+
+/*
+ * Finds a shortest route from room 'from' to room 'to'. On success
+ * '*path' holds the rooms to pass through, ending with 'to', and
+ * stays valid until the next call. Returns -1 if there is no route.
+ */
+int
+route_find(struct object *from, struct object *to, const ObjHandle **path,
+    size_t *len)
+{
+	struct route			*r;
+	size_t				 k;
+	uint32_t			 s, t;
+
+	if (from == NULL || to == NULL || !IS_ROOM(from) || !IS_ROOM(to))
+		return -1;
+
+	if (!graph_has(from) || !graph_has(to))
+		route_invalidate();
+	if (_stale) {
+		if (graph_build() == -1)
+			return -1;
+		_stale = 0;
+	}
+	if (!graph_has(from) || !graph_has(to))
+		return -1;
+	s = HANDLE_INDEX(from->handle);
+	t = HANDLE_INDEX(to->handle);
+
+	k = route_hash(from->handle, to->handle);
+	for (r = _rhash[k]; r != NULL; r = r->next_hash)
+		if (r->src == from->handle && r->dst == to->handle)
+			break;
+
+	if (r != NULL && !path_live(r)) {
+		/* A room on the way was evicted; search again. */
+		free(r->path);
+		if (r->len > 0)
+			mem_dec(MEM_INDEX, r->len * sizeof(ObjHandle));
+		r->found = search(s, t, &r->path, &r->len) == 0;
+		if (r->len > 0)
+			mem_inc(MEM_INDEX, r->len * sizeof(ObjHandle));
+		lru_unlink(r);
+	} else if (r == NULL) {
+		r = route_evict();
+		r->src = from->handle;
+		r->dst = to->handle;
+		r->found = search(s, t, &r->path, &r->len) == 0;
+		if (r->len > 0)
+			mem_inc(MEM_INDEX, r->len * sizeof(ObjHandle));
+		r->next_hash = _rhash[k];
+		_rhash[k] = r;
+	} else
+		lru_unlink(r);
+	lru_push(r);
+
+	if (!r->found)
+		return -1;
+	*path = r->path;
+	*len = r->len;
+	return 0;
+}
+
+/*
+ * Key of the exit in 'room' that leads to room 'next', if any.
+ */
+const char *
+route_exit(struct room *room, ObjHandle next)
+{
+	struct object			*obj;
+	size_t				 i;
+
+	if ((obj = object_deref(next)) == NULL)
+		return NULL;
+
+	for (i = 0; i < room->nexits; i++)
+		if (room->exits[i].obj == next ||
+		    strcmp(room->exits[i].target, obj->key) == 0)
+			return room->exits[i].key;
+
+	return NULL;
+}
+
+/*
+ * Whether the room is a node of the current graph.
+ */
+static int
+graph_has(struct object *obj)
+{
+	return HANDLE_INDEX(obj->handle) < _g.n &&
+	    _g.handle[HANDLE_INDEX(obj->handle)] == obj->handle;
+}
+
+static int
+path_live(const struct route *r)
+{
+	size_t				 i;
+
+	for (i = 0; i < r->len; i++)
+		if (object_deref(r->path[i]) == NULL)
+			return 0;
+	return 1;
+}
+
+static void
+graph_free(void)
+{
+	size_t				 n;
+
+	n = _g.n;
+	if (n > 0)
+		mem_dec(MEM_INDEX, (n * 11 + 2) * sizeof(uint32_t) +
+		    _g.m * 2 * sizeof(uint32_t));
+	free(_g.off);
+	free(_g.adj);
+	free(_g.roff);
+	free(_g.radj);
+	free(_g.handle);
+	free(_g.fmark);
+	free(_g.bmark);
+	free(_g.fpar);
+	free(_g.bpar);
+	free(_g.fdist);
+	free(_g.bdist);
+	free(_g.fq);
+	free(_g.bq);
+	memset(&_g, 0, sizeof(_g));
+}
+
+static int
+graph_build(void)
+{
+	struct object			*obj, *dest;
+	struct room			*room;
+	struct exit			*e;
+	uint32_t			*src = NULL, *dst = NULL, *p;
+	size_t				 n, m, alloc, i;
+
+	graph_free();
+
+	/*
+	 * Gather the edges first; targets are only looked up among the
+	 * resident objects, nothing is faulted in.
+	 */
+	n = 0;
+	m = alloc = 0;
+	obj = NULL;
+	while ((obj = object_next_of_type(OBJ_TYPE_ROOM, obj)) != NULL) {
+		if (HANDLE_INDEX(obj->handle) + 1 > n)
+			n = HANDLE_INDEX(obj->handle) + 1;
+		room = ROOM(obj);
+		for (i = 0; i < room->nexits; i++) {
+			e = &room->exits[i];
+			if ((dest = object_deref(e->obj)) == NULL) {
+				if ((dest = object_lookup(e->target)) == NULL)
+					continue;
+				e->obj = object_handle(dest);
+			}
+			if (!IS_ROOM(dest))
+				continue;
+			if (m == alloc) {
+				alloc = alloc == 0 ? 1024 : alloc * 2;
+				if ((p = realloc(src, alloc *
+				    sizeof(uint32_t))) == NULL)
+					goto fail;
+				src = p;
+				if ((p = realloc(dst, alloc *
+				    sizeof(uint32_t))) == NULL)
+					goto fail;
+				dst = p;
+			}
+			src[m] = HANDLE_INDEX(obj->handle);
+			dst[m] = HANDLE_INDEX(dest->handle);
+			m++;
+		}
+	}
+	if (n == 0)
+		n = 1;
+
+	_g.n = n;
+	_g.m = m;
+	_g.off = calloc(n + 1, sizeof(uint32_t));
+	_g.roff = calloc(n + 1, sizeof(uint32_t));
+	_g.adj = malloc((m + 1) * sizeof(uint32_t));
+	_g.radj = malloc((m + 1) * sizeof(uint32_t));
+	_g.handle = calloc(n, sizeof(ObjHandle));
+	_g.fmark = calloc(n, sizeof(uint32_t));
+	_g.bmark = calloc(n, sizeof(uint32_t));
+	_g.fpar = malloc(n * sizeof(uint32_t));
+	_g.bpar = malloc(n * sizeof(uint32_t));
+	_g.fdist = malloc(n * sizeof(uint32_t));
+	_g.bdist = malloc(n * sizeof(uint32_t));
+	_g.fq = malloc(n * sizeof(uint32_t));
+	_g.bq = malloc(n * sizeof(uint32_t));
+	mem_inc(MEM_INDEX, (n * 11 + 2) * sizeof(uint32_t) +
+	    m * 2 * sizeof(uint32_t));
+	if (_g.off == NULL || _g.roff == NULL || _g.adj == NULL ||
+	    _g.radj == NULL || _g.handle == NULL || _g.fmark == NULL ||
+	    _g.bmark == NULL || _g.fpar == NULL || _g.bpar == NULL ||
+	    _g.fdist == NULL || _g.bdist == NULL || _g.fq == NULL || _g.bq == NULL)
+		goto fail;
+
+	obj = NULL;
+	while ((obj = object_next_of_type(OBJ_TYPE_ROOM, obj)) != NULL)
+		_g.handle[HANDLE_INDEX(obj->handle)] = obj->handle;
+
+	/* Counting sort of the edges by source and by destination */
+	for (i = 0; i < m; i++) {
+		_g.off[src[i] + 1]++;
+		_g.roff[dst[i] + 1]++;
+	}
+	for (i = 0; i < n; i++) {
+		_g.off[i + 1] += _g.off[i];
+		_g.roff[i + 1] += _g.roff[i];
+	}
+	for (i = 0; i < m; i++) {
+		_g.adj[_g.off[src[i]]++] = dst[i];
+		_g.radj[_g.roff[dst[i]]++] = src[i];
+	}
+	for (i = n; i > 0; i--) {
+		_g.off[i] = _g.off[i - 1];
+		_g.roff[i] = _g.roff[i - 1];
+	}
+	_g.off[0] = _g.roff[0] = 0;
+
+	free(src);
+	free(dst);
+	return 0;
+fail:
+	free(src);
+	free(dst);
+	graph_free();
+	return -1;
+}
+
+/*
+ * Bidirectional breadth-first search, always growing the smaller of
+ * the two frontiers by a whole level. Once the searches touch, the
+ * best of the meeting points seen in that level gives a shortest
+ * route.
+ */
+static int
+search(uint32_t s, uint32_t t, ObjHandle **path, size_t *len)
+{
+	uint32_t			 fh, ft, bh, bt, lvl_end;
+	uint32_t			 u, v, meet, best, i, k;
+	size_t				 flen, blen;
+	ObjHandle			*pp;
+
+	*path = NULL;
+	*len = 0;
+	if (_g.handle[s] == OBJ_HANDLE_NONE ||
+	    _g.handle[t] == OBJ_HANDLE_NONE)
+		return -1;
+	if (s == t)
+		return 0;
+
+	if (++_g.epoch == 0) {
+		memset(_g.fmark, 0, _g.n * sizeof(uint32_t));
+		memset(_g.bmark, 0, _g.n * sizeof(uint32_t));
+		_g.epoch = 1;
+	}
+
+	fh = ft = bh = bt = 0;
+	_g.fq[ft++] = s;
+	_g.fmark[s] = _g.epoch;
+	_g.fpar[s] = ROUTE_NONE;
+	_g.fdist[s] = 0;
+	_g.bq[bt++] = t;
+	_g.bmark[t] = _g.epoch;
+	_g.bpar[t] = ROUTE_NONE;
+	_g.bdist[t] = 0;
+
+	meet = ROUTE_NONE;
+	best = UINT32_MAX;
+	while (meet == ROUTE_NONE && fh < ft && bh < bt) {
+		if (ft - fh <= bt - bh) {
+			for (lvl_end = ft; fh < lvl_end; fh++) {
+				u = _g.fq[fh];
+				for (k = _g.off[u]; k < _g.off[u + 1]; k++) {
+					v = _g.adj[k];
+					if (_g.fmark[v] == _g.epoch)
+						continue;
+					_g.fmark[v] = _g.epoch;
+					if (object_deref(_g.handle[v]) == NULL)
+						continue;
+					_g.fpar[v] = u;
+					_g.fdist[v] = _g.fdist[u] + 1;
+					_g.fq[ft++] = v;
+					if (_g.bmark[v] == _g.epoch &&
+					    _g.fdist[v] + _g.bdist[v] < best) {
+						best = _g.fdist[v] +
+						    _g.bdist[v];
+						meet = v;
+					}
+				}
+			}
+		} else {
+			for (lvl_end = bt; bh < lvl_end; bh++) {
+				u = _g.bq[bh];
+				for (k = _g.roff[u]; k < _g.roff[u + 1]; k++) {
+					v = _g.radj[k];
+					if (_g.bmark[v] == _g.epoch)
+						continue;
+					_g.bmark[v] = _g.epoch;
+					if (object_deref(_g.handle[v]) == NULL)
+						continue;
+					_g.bpar[v] = u;
+					_g.bdist[v] = _g.bdist[u] + 1;
+					_g.bq[bt++] = v;
+					if (_g.fmark[v] == _g.epoch &&
+					    _g.fdist[v] + _g.bdist[v] < best) {
+						best = _g.fdist[v] +
+						    _g.bdist[v];
+						meet = v;
+					}
+				}
+			}
+		}
+	}
+	if (meet == ROUTE_NONE)
+		return -1;
+
+	flen = 0;
+	for (v = meet; v != s; v = _g.fpar[v])
+		flen++;
+	blen = 0;
+	for (v = meet; v != t; v = _g.bpar[v])
+		blen++;
+
+	if ((pp = malloc((flen + blen) * sizeof(ObjHandle))) == NULL)
+		return -1;
+	i = flen;
+	for (v = meet; v != s; v = _g.fpar[v])
+		pp[--i] = _g.handle[v];
+	i = flen;
+	for (v = meet; v != t; ) {
+		v = _g.bpar[v];
+		pp[i++] = _g.handle[v];
+	}
+
+	*path = pp;
+	*len = flen + blen;
+	return 0;
+}
@@ -0,0 +1,43 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ROUTE_H
+#define ROUTE_H
+
+#include <stddef.h>
+
+#include "object.h"
+
+/*
+ * Shortest routes over the exits of resident rooms. The exit graph is
+ * kept as a compressed adjacency snapshot that is rebuilt on the first
+ * query after exits have been added or removed, or that involves a
+ * room the snapshot does not know yet; recent routes are remembered
+ * until then.
+ */
+void				 route_invalidate(void);
+int				 route_find(
+				    struct object *,
+				    struct object *,
+				    const ObjHandle **,
+				    size_t *);
+const char			*route_exit(
+				    struct room *,
+				    ObjHandle);
+
+#endif
@@ -0,0 +1,258 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "sched.h"
+#include "player.h"
+#include "tell.h"
+#include "mem.h"
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <err.h>
+
+static struct player		*_runq;		/* Head of the run queue */
+static struct player		*_runq_tail;
+static size_t			 _nrun;
+
+static uint64_t
+now_ms(void)
+{
+	struct timespec			 ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		err(1, "clock_gettime");
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void
+link_run(struct player *plr)
+{
+	struct cmdq			*q = &plr->cmdq;
+
+	if (q->running)
+		return;
+	q->running = 1;
+	q->next_run = NULL;
+	q->prev_run = _runq_tail;
+	if (_runq_tail != NULL)
+		_runq_tail->cmdq.next_run = plr;
+	else
+		_runq = plr;
+	_runq_tail = plr;
+	_nrun++;
+}
+
+static void
+unlink_run(struct player *plr)
+{
+	struct cmdq			*q = &plr->cmdq;
+
+	if (!q->running)
+		return;
+	if (q->prev_run != NULL)
+		q->prev_run->cmdq.next_run = q->next_run;
+	else
+		_runq = q->next_run;
+	if (q->next_run != NULL)
+		q->next_run->cmdq.prev_run = q->prev_run;
+	else
+		_runq_tail = q->prev_run;
+	q->next_run = q->prev_run = NULL;
+	q->running = 0;
+	_nrun--;
+}
+
+static int
+grow(struct cmdq *q)
+{
+	struct cmdline			*p;
+	size_t				 alloc, i;
+
+	if (q->n < q->alloc)
+		return 0;
+
+	alloc = q->alloc == 0 ? 8 : q->alloc * 2;
+	if ((p = malloc(alloc * sizeof(*p))) == NULL)
+		return -1;
+	for (i = 0; i < q->n; i++)
+		p[i] = q->line[(q->head + i) % q->alloc];
+	if (q->alloc > 0)
+		mem_dec(MEM_INPUT, q->alloc * sizeof(*p));
+	mem_inc(MEM_INPUT, alloc * sizeof(*p));
+	free(q->line);
+	q->line = p;
+	q->alloc = alloc;
+	q->head = 0;
+	return 0;
+}
+
+static char *
+queue_line(struct player *plr, const char *str)
+{
+	struct cmdq			*q = &plr->cmdq;
+	char				*line;
+
+	if (q->n >= CMDQ_MAX) {
+		if (q->dropped++ == 0) {
+			tellp(plr, "Too many commands at once, "
+			    "the rest are ignored.\n");
+			end_fmtbuf(&plr->fmtbuf);
+		}
+		return NULL;
+	}
+	if (grow(q) == -1 || (line = strdup(str)) == NULL) {
+		warn("sched_push");
+		return NULL;
+	}
+	mem_inc(MEM_INPUT, MEM_STR(line));
+	return line;
+}
+
+/*
+ * Queues a line sent by 'plr' to be run after what it has waiting.
+ */
+int
+sched_push(struct player *plr, const char *str)
+{
+	struct cmdq			*q = &plr->cmdq;
+	char				*line;
+
+	if ((line = queue_line(plr, str)) == NULL)
+		return -1;
+	q->line[(q->head + q->n) % q->alloc].str = line;
+	q->line[(q->head + q->n) % q->alloc].at = stats_now();
+	q->n++;
+	link_run(plr);
+	return 0;
+}
+
+/*
+ * Queues a line to be run next, for commands that continue over
+ * several turns.
+ */
+int
+sched_push_front(struct player *plr, const char *str)
+{
+	struct cmdq			*q = &plr->cmdq;
+	char				*line;
+
+	if ((line = queue_line(plr, str)) == NULL)
+		return -1;
+	q->head = (q->head + q->alloc - 1) % q->alloc;
+	q->line[q->head].str = line;
+	q->line[q->head].at = 0;
+	q->n++;
+	link_run(plr);
+	return 0;
+}
+
+/*
+ * Takes 'plr' off the run queue and forgets what it has waiting.
+ */
+void
+sched_remove(struct player *plr)
+{
+	struct cmdq			*q = &plr->cmdq;
+	char				*line;
+
+	unlink_run(plr);
+	while (q->n > 0) {
+		line = q->line[q->head].str;
+		q->head = (q->head + 1) % q->alloc;
+		q->n--;
+		mem_dec(MEM_INPUT, MEM_STR(line));
+		free(line);
+	}
+	if (q->alloc > 0)
+		mem_dec(MEM_INPUT, q->alloc * sizeof(*q->line));
+	free(q->line);
+	q->line = NULL;
+	q->alloc = 0;
+	q->head = 0;
+}
+
+/*
+ * Runs one round: every player that was on the run queue gets to run
+ * up to SCHED_BURST lines, or one if it is paced and it is time.
+ */
+void
+sched_run(void)
+{
+	struct player			*plr;
+	struct cmdq			*q;
+	char				*line;
+	uint64_t			 now;
+	size_t				 i, n, k;
+
+	now = now_ms();
+	for (i = 0, n = _nrun; i < n && _runq != NULL; i++) {
+		plr = _runq;
+		q = &plr->cmdq;
+		unlink_run(plr);
+
+		for (k = 0; k < SCHED_BURST && q->n > 0; k++) {
+			if (q->pace > 0) {
+				if (now < q->next_at)
+					break;
+				q->next_at = now + q->pace;
+			}
+			line = q->line[q->head].str;
+			plr->line_at = q->line[q->head].at;
+			q->head = (q->head + 1) % q->alloc;
+			q->n--;
+			player_input(plr, line);
+			plr->line_at = 0;
+			mem_dec(MEM_INPUT, MEM_STR(line));
+			free(line);
+			if (plr->outq.bytes == 0 && plr->fmtbuf.j == 0)
+				stats_drained(plr);
+		}
+
+		if (q->n > 0)
+			link_run(plr);
+		else
+			q->dropped = 0;
+	}
+}
+
+/*
+ * Milliseconds until sched_run() has something to do, or -1 if there
+ * is nothing waiting.
+ */
+int
+sched_timeout(void)
+{
+	struct player			*plr;
+	uint64_t			 now, wait, min;
+
+	if (_runq == NULL)
+		return -1;
+
+	now = now_ms();
+	min = PACE_MAX;
+	for (plr = _runq; plr != NULL; plr = plr->cmdq.next_run) {
+		if (plr->cmdq.pace == 0 || plr->cmdq.next_at <= now)
+			return 0;
+		wait = plr->cmdq.next_at - now;
+		if (wait < min)
+			min = wait;
+	}
+	return min;
+}
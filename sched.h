@@ -0,0 +1,67 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct player;
+
+#define CMDQ_MAX	256	/* Lines a player may have waiting */
+#define SCHED_BURST	4	/* Lines run per player per round */
+#define PACE_MAX	10000	/* Longest pace, in milliseconds */
+
+/*
+ * Lines a player has sent but that have not been run yet. Players
+ * with lines waiting are on the run queue, which is gone through in
+ * rounds: each player gets to run a few lines per round, or one line
+ * per 'pace' milliseconds if the player has set a pace, so nobody
+ * waits for more than a round however much somebody else sends.
+ */
+struct cmdline {
+	char				*str;
+	uint64_t			 at;		/* Read, see stats_now() */
+};
+
+struct cmdq {
+	struct cmdline			*line;
+	size_t				 head;
+	size_t				 n;
+	size_t				 alloc;
+	size_t				 dropped;
+	int				 pace;		/* ms, or 0 */
+	uint64_t			 next_at;	/* Paced: ms */
+	struct player			*next_run;
+	struct player			*prev_run;
+	int				 running;	/* On run queue */
+};
+
+int					 sched_push(
+					    struct player *,
+					    const char *);
+int					 sched_push_front(
+					    struct player *,
+					    const char *);
+void					 sched_remove(
+					    struct player *);
+void					 sched_run(void);
+int					 sched_timeout(void);
+
+#endif
@@ -0,0 +1,881 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "snapshot.h"
+#include "object.h"
+#include "room.h"
+#include "action.h"
+#include "tag.h"
+#include "text.h"
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * The snapshot file is laid out as:
+ *
+ *   header
+ *   rooms		struct snap_room sorted by key, the index
+ *   exits		struct snap_exit, those of a room in a run
+ *   descs		struct snap_desc, likewise
+ *   actions		struct snap_act, likewise
+ *   strings		NUL terminated strings, each stored once
+ *
+ * Strings are referred to by their offset in the string table, offset
+ * 0 standing for NULL. Tags are numbered by the table of tag names in
+ * the header and mapped to the tags of the server when the snapshot
+ * is opened. Sections start at multiples of 8 bytes. Integers are in
+ * host byte order.
+ *
+ * Nothing is read from the file when it is opened but the header: a
+ * room is filled from the mapping when object_find() first creates
+ * it, with its strings pointing into the mapping. Saving writes a new
+ * snapshot and maps that instead. Every string a resident object has
+ * from the old mapping is in the new one too, so the objects are
+ * pointed there and the old mapping is unmapped.
+ */
+#define SNAP_MAGIC		"TFMUDSS1"
+#define SNAP_VERSION		1
+#define SNAP_ALIGN(_x)		(((_x) + 7) & ~(uint64_t) 7)
+
+enum snap_sect_type {
+	SECT_ROOMS=0,
+	SECT_EXITS,
+	SECT_DESCS,
+	SECT_ACTS,
+	SECT_STRINGS,
+	MAX_SECTS
+};
+
+struct snap_sect {
+	uint64_t		 off;
+	uint64_t		 n;
+};
+
+struct snap_hdr {
+	char			 magic[8];
+	uint32_t		 version;
+	uint32_t		 ntags;
+	uint64_t		 size;
+	struct snap_sect	 sect[MAX_SECTS];
+	uint32_t		 tags[MAX_TAGS];
+	uint64_t		 max_id[MAX_OBJ_TYPE];
+};
+
+struct snap_room {
+	uint32_t		 key;
+	uint32_t		 title;
+	TagSet			 tags;
+	uint32_t		 exit;		/* First of the room's */
+	uint32_t		 desc;
+	uint32_t		 act;
+	uint16_t		 nexits;
+	uint16_t		 ndescs;
+	uint16_t		 nacts;
+	uint16_t		 reserved[3];
+};
+
+struct snap_exit {
+	uint32_t		 key;
+	uint32_t		 target;
+	uint32_t		 travel;
+	uint32_t		 desc;
+};
+
+struct snap_desc {
+	uint32_t		 name;
+	uint32_t		 text;
+	TagSet			 req;
+	TagSet			 forbid;
+	uint32_t		 type;
+	uint32_t		 reserved;
+};
+
+struct snap_act {
+	uint32_t		 name;
+	uint32_t		 src;
+};
+
+/*
+ * A snapshot being written. Strings are found again through an open
+ * addressing hash of their offsets.
+ */
+struct writer {
+	struct snap_room	*rooms;
+	size_t			 nrooms;
+	size_t			 arooms;
+	struct snap_exit	*exits;
+	size_t			 nexits;
+	size_t			 aexits;
+	struct snap_desc	*descs;
+	size_t			 ndescs;
+	size_t			 adescs;
+	struct snap_act		*acts;
+	size_t			 nacts;
+	size_t			 aacts;
+	char			*strs;
+	size_t			 nstrs;
+	size_t			 astrs;
+	uint32_t		*slots;
+	size_t			 nslots;
+	size_t			 used;
+	int			 error;
+};
+
+static const size_t		 _sectsz[MAX_SECTS] = {
+	sizeof(struct snap_room), sizeof(struct snap_exit),
+	sizeof(struct snap_desc), sizeof(struct snap_act), 1
+};
+
+static char			*_path;
+static const char		*_base;		/* Mapping in use */
+static size_t			 _size;
+static const struct snap_hdr	*_hdr;
+static TagSet			 _tagmap[MAX_TAGS];
+
+#define SECT(_type, _i) \
+	((const _type *) (_base + _hdr->sect[(_i)].off))
+
+static const char *
+str(uint32_t off)
+{
+	if (off == 0 || off >= _hdr->sect[SECT_STRINGS].n)
+		return NULL;
+
+	return _base + _hdr->sect[SECT_STRINGS].off + off;
+}
+
+static int
+in_sect(int i, uint64_t first, uint64_t n)
+{
+	return first <= _hdr->sect[i].n && n <= _hdr->sect[i].n - first;
+}
+
+/*
+ * Tags of the snapshot as tags of the server.
+ */
+static TagSet
+map_tags(TagSet t)
+{
+	TagSet				 r;
+	int				 i;
+
+	for (r = 0, i = 0; t != 0; i++, t >>= 1)
+		if (t & 1)
+			r |= _tagmap[i];
+	return r;
+}
+
+static int
+valid(const struct snap_hdr *hdr, const char *base, uint64_t size)
+{
+	const struct snap_sect		*s;
+	int				 i;
+
+	if (memcmp(hdr->magic, SNAP_MAGIC, sizeof(hdr->magic)) != 0 ||
+	    hdr->version != SNAP_VERSION || hdr->size != size ||
+	    hdr->ntags > MAX_TAGS)
+		return 0;
+	for (i = 0; i < MAX_SECTS; i++) {
+		s = &hdr->sect[i];
+		if (s->off % 8 != 0 || s->off > size ||
+		    s->n > (size - s->off) / _sectsz[i])
+			return 0;
+	}
+	s = &hdr->sect[SECT_STRINGS];
+	return s->n > 0 && base[s->off + s->n - 1] == '\0';
+}
+
+/*
+ * Maps the snapshot open in 'fd' and makes it the one in use.
+ */
+static int
+map(int fd)
+{
+	const struct snap_hdr		*hdr;
+	const char			*name;
+	struct stat			 st;
+	void				*p;
+	uint32_t			 i;
+	ObjType				 t;
+	int				 tag;
+
+	if (fstat(fd, &st) == -1) {
+		warn("%s", _path);
+		close(fd);
+		return -1;
+	}
+	if ((size_t) st.st_size < sizeof(*hdr)) {
+		warnx("%s: not a world snapshot", _path);
+		close(fd);
+		return -1;
+	}
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		warn("%s", _path);
+		return -1;
+	}
+	hdr = p;
+	if (!valid(hdr, p, st.st_size)) {
+		warnx("%s: not a world snapshot", _path);
+		munmap(p, st.st_size);
+		return -1;
+	}
+	if (text_borrow((char *) p + hdr->sect[SECT_STRINGS].off,
+	    hdr->sect[SECT_STRINGS].n) == -1) {
+		munmap(p, st.st_size);
+		return -1;
+	}
+	posix_madvise(p, st.st_size, POSIX_MADV_RANDOM);
+
+	_base = p;
+	_size = st.st_size;
+	_hdr = hdr;
+	memset(_tagmap, 0, sizeof(_tagmap));
+	for (i = 0; i < hdr->ntags; i++) {
+		if ((name = str(hdr->tags[i])) == NULL ||
+		    (tag = tag_intern(name)) == -1)
+			warnx("%s: cannot use tag %u", _path, i);
+		else
+			_tagmap[i] = TAG_BIT(tag);
+	}
+	for (t = 0; t < MAX_OBJ_TYPE; t++)
+		object_reserve_id(t, hdr->max_id[t]);
+
+	return 0;
+}
+
+int
+snapshot_open(const char *path)
+{
+	int				 fd;
+
+	if ((_path = strdup(path)) == NULL)
+		return -1;
+
+	if ((fd = open(path, O_RDONLY)) == -1) {
+		if (errno == ENOENT)
+			return 0;	/* Created by the first save */
+		warn("%s", path);
+		return -1;
+	}
+
+	return map(fd);
+}
+
+int
+snapshot_active(void)
+{
+	return _path != NULL;
+}
+
+static const struct snap_room *
+find(const char *key)
+{
+	const struct snap_room		*rooms;
+	const char			*k;
+	size_t				 lo, hi, mid;
+	int				 cmp;
+
+	if (_base == NULL)
+		return NULL;
+
+	rooms = SECT(struct snap_room, SECT_ROOMS);
+	lo = 0;
+	hi = _hdr->sect[SECT_ROOMS].n;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if ((k = str(rooms[mid].key)) == NULL)
+			return NULL;
+		cmp = strcmp(k, key);
+		if (cmp == 0)
+			return &rooms[mid];
+		else if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return NULL;
+}
+
+/*
+ * Called for every room created by object_find(). If the snapshot has
+ * the room, the room is filled from it and left clean.
+ */
+int
+snapshot_fault(struct room *room)
+{
+	const struct snap_room		*r;
+	const struct snap_exit		*e;
+	const struct snap_desc		*d;
+	const struct snap_act		*a;
+	const char			*errstr;
+	struct exit			*ex;
+	size_t				 i;
+
+	if ((r = find(OBJ(room)->key)) == NULL)
+		return 0;
+	if (!in_sect(SECT_EXITS, r->exit, r->nexits) ||
+	    !in_sect(SECT_DESCS, r->desc, r->ndescs) ||
+	    !in_sect(SECT_ACTS, r->act, r->nacts)) {
+		warnx("%s: %s: corrupted room", _path, OBJ(room)->key);
+		return -1;
+	}
+
+	if (str(r->title) != NULL)
+		set_title(OBJ(room), str(r->title));
+	room->tags = map_tags(r->tags);
+
+	e = SECT(struct snap_exit, SECT_EXITS) + r->exit;
+	for (i = 0; i < r->nexits; i++, e++) {
+		if (str(e->key) == NULL || str(e->target) == NULL ||
+		    room_load_exit(room, str(e->key), str(e->target)) == -1)
+			continue;
+		ex = &room->exits[room->nexits-1];
+		ex->travel_desc = text_intern(str(e->travel));
+		ex->desc = text_intern(str(e->desc));
+	}
+
+	d = SECT(struct snap_desc, SECT_DESCS) + r->desc;
+	for (i = 0; i < r->ndescs; i++, d++)
+		if (d->type < MAX_DESC_TYPES && str(d->text) != NULL)
+			room_load_variant(room, d->type, str(d->name),
+			    map_tags(d->req), map_tags(d->forbid),
+			    str(d->text));
+
+	a = SECT(struct snap_act, SECT_ACTS) + r->act;
+	for (i = 0; i < r->nacts; i++, a++)
+		if (str(a->name) != NULL && str(a->src) != NULL &&
+		    action_set(OBJ(room), str(a->name), str(a->src),
+		    &errstr) == -1)
+			warnx("%s: action %s: %s", OBJ(room)->key,
+			    str(a->name), errstr);
+
+	room->flags &= ~ROOM_DIRTY;
+	return 0;
+}
+
+static int
+grow(void *pp, size_t *alloc, size_t want, size_t size)
+{
+	void				*p;
+	size_t				 n;
+
+	if (want <= *alloc)
+		return 0;
+	for (n = *alloc == 0 ? 256 : *alloc; n < want; n *= 2)
+		;
+	if ((p = realloc(*(void **) pp, n * size)) == NULL)
+		return -1;
+	*(void **) pp = p;
+	*alloc = n;
+	return 0;
+}
+
+static void *
+w_push(struct writer *w, void *pp, size_t *n, size_t *alloc, size_t size)
+{
+	char				*p;
+
+	if (w->error || grow(pp, alloc, *n + 1, size) == -1) {
+		w->error = 1;
+		return NULL;
+	}
+	p = *(char **) pp + (*n)++ * size;
+	memset(p, 0, size);
+	return p;
+}
+
+static uint32_t
+hash(const char *s)
+{
+	uint32_t			 h;
+
+	for (h = 2166136261U; *s != '\0'; s++)
+		h = (h ^ (unsigned char) *s) * 16777619U;
+	return h;
+}
+
+static int
+w_rehash(struct writer *w)
+{
+	uint32_t			*slots;
+	size_t				 n, i, j;
+
+	n = w->nslots == 0 ? 1024 : w->nslots * 2;
+	if ((slots = calloc(n, sizeof(*slots))) == NULL)
+		return -1;
+	for (i = 0; i < w->nslots; i++) {
+		if (w->slots[i] == 0)
+			continue;
+		for (j = hash(&w->strs[w->slots[i]]) & (n - 1); slots[j] != 0;
+		    j = (j + 1) & (n - 1))
+			;
+		slots[j] = w->slots[i];
+	}
+	free(w->slots);
+	w->slots = slots;
+	w->nslots = n;
+	return 0;
+}
+
+/*
+ * Offset of 's' in the string table, adding it if it is not there.
+ */
+static uint32_t
+w_str(struct writer *w, const char *s)
+{
+	size_t				 i, len;
+	uint32_t			 off;
+
+	if (s == NULL || w->error)
+		return 0;
+	if (w->used * 2 >= w->nslots && w_rehash(w) == -1) {
+		w->error = 1;
+		return 0;
+	}
+
+	for (i = hash(s) & (w->nslots - 1); (off = w->slots[i]) != 0;
+	    i = (i + 1) & (w->nslots - 1))
+		if (strcmp(&w->strs[off], s) == 0)
+			return off;
+
+	len = strlen(s) + 1;
+	if (w->nstrs + len > UINT32_MAX ||
+	    grow(&w->strs, &w->astrs, w->nstrs + len, 1) == -1) {
+		w->error = 1;
+		return 0;
+	}
+	off = w->nstrs;
+	memcpy(&w->strs[off], s, len);
+	w->nstrs += len;
+	w->slots[i] = off;
+	w->used++;
+	return off;
+}
+
+/*
+ * Offset of 's' in the string table, or 0 if it is not there.
+ */
+static uint32_t
+w_find(const struct writer *w, const char *s)
+{
+	size_t				 i;
+	uint32_t			 off;
+
+	if (s == NULL || w->nslots == 0)
+		return 0;
+	for (i = hash(s) & (w->nslots - 1); (off = w->slots[i]) != 0;
+	    i = (i + 1) & (w->nslots - 1))
+		if (strcmp(&w->strs[off], s) == 0)
+			return off;
+	return 0;
+}
+
+static void
+w_room(struct writer *w, struct room *room)
+{
+	struct snap_room		*sr;
+	struct snap_exit		*se;
+	struct snap_desc		*sd;
+	struct snap_act			*sa;
+	struct actset			*as;
+	struct desc			*d;
+	size_t				 i;
+	int				 j, k;
+
+	if ((sr = w_push(w, &w->rooms, &w->nrooms, &w->arooms,
+	    sizeof(*sr))) == NULL)
+		return;
+	sr->key = w_str(w, OBJ(room)->key);
+	sr->title = w_str(w, title(OBJ(room)));
+	sr->tags = room->tags;
+
+	sr->exit = w->nexits;
+	sr->nexits = room->nexits;
+	for (i = 0; i < room->nexits; i++) {
+		if ((se = w_push(w, &w->exits, &w->nexits, &w->aexits,
+		    sizeof(*se))) == NULL)
+			return;
+		se->key = w_str(w, room->exits[i].key);
+		se->target = w_str(w, room->exits[i].target);
+		se->travel = w_str(w, room->exits[i].travel_desc);
+		se->desc = w_str(w, room->exits[i].desc);
+	}
+
+	sr->desc = w->ndescs;
+	for (j = 0; j < MAX_DESC_TYPES; j++)
+		for (k = 0; k < room->n_desc[j]; k++) {
+			if ((sd = w_push(w, &w->descs, &w->ndescs,
+			    &w->adescs, sizeof(*sd))) == NULL)
+				return;
+			d = &room->desc[j][k];
+			sd->name = w_str(w, d->name);
+			sd->text = w_str(w, d->text);
+			sd->req = d->req;
+			sd->forbid = d->forbid;
+			sd->type = j;
+		}
+	if (w->ndescs - sr->desc > UINT16_MAX) {
+		w->error = 1;
+		return;
+	}
+	sr->ndescs = w->ndescs - sr->desc;
+
+	sr->act = w->nacts;
+	as = OBJ(room)->actions;
+	for (i = 0; as != NULL && i < as->n; i++) {
+		if ((sa = w_push(w, &w->acts, &w->nacts, &w->aacts,
+		    sizeof(*sa))) == NULL)
+			return;
+		sa->name = w_str(w, as->act[i].name);
+		sa->src = w_str(w, as->act[i].src);
+	}
+	if (w->nacts - sr->act > UINT16_MAX) {
+		w->error = 1;
+		return;
+	}
+	sr->nacts = w->nacts - sr->act;
+}
+
+/*
+ * Copies a room that is not resident over from the mapping.
+ */
+static void
+w_mapped(struct writer *w, const struct snap_room *r)
+{
+	const struct snap_exit		*e;
+	const struct snap_desc		*d;
+	const struct snap_act		*a;
+	struct snap_room		*sr;
+	struct snap_exit		*se;
+	struct snap_desc		*sd;
+	struct snap_act			*sa;
+	size_t				 i;
+
+	if (!in_sect(SECT_EXITS, r->exit, r->nexits) ||
+	    !in_sect(SECT_DESCS, r->desc, r->ndescs) ||
+	    !in_sect(SECT_ACTS, r->act, r->nacts)) {
+		warnx("%s: %s: corrupted room", _path, str(r->key));
+		return;
+	}
+	if ((sr = w_push(w, &w->rooms, &w->nrooms, &w->arooms,
+	    sizeof(*sr))) == NULL)
+		return;
+	sr->key = w_str(w, str(r->key));
+	sr->title = w_str(w, str(r->title));
+	sr->tags = map_tags(r->tags);
+
+	sr->exit = w->nexits;
+	sr->nexits = r->nexits;
+	e = SECT(struct snap_exit, SECT_EXITS) + r->exit;
+	for (i = 0; i < r->nexits; i++, e++) {
+		if ((se = w_push(w, &w->exits, &w->nexits, &w->aexits,
+		    sizeof(*se))) == NULL)
+			return;
+		se->key = w_str(w, str(e->key));
+		se->target = w_str(w, str(e->target));
+		se->travel = w_str(w, str(e->travel));
+		se->desc = w_str(w, str(e->desc));
+	}
+
+	sr->desc = w->ndescs;
+	sr->ndescs = r->ndescs;
+	d = SECT(struct snap_desc, SECT_DESCS) + r->desc;
+	for (i = 0; i < r->ndescs; i++, d++) {
+		if ((sd = w_push(w, &w->descs, &w->ndescs, &w->adescs,
+		    sizeof(*sd))) == NULL)
+			return;
+		sd->name = w_str(w, str(d->name));
+		sd->text = w_str(w, str(d->text));
+		sd->req = map_tags(d->req);
+		sd->forbid = map_tags(d->forbid);
+		sd->type = d->type;
+	}
+
+	sr->act = w->nacts;
+	sr->nacts = r->nacts;
+	a = SECT(struct snap_act, SECT_ACTS) + r->act;
+	for (i = 0; i < r->nacts; i++, a++) {
+		if ((sa = w_push(w, &w->acts, &w->nacts, &w->aacts,
+		    sizeof(*sa))) == NULL)
+			return;
+		sa->name = w_str(w, str(a->name));
+		sa->src = w_str(w, str(a->src));
+	}
+}
+
+/*
+ * Where string 's' is in the mapping in use if it points into the
+ * 'len' bytes of strings at 'old'. Sets '*ok' to 0 if it is missing.
+ */
+static const char *
+moved(const struct writer *w, const char *s, const char *old, size_t len,
+    int *ok)
+{
+	const char			*p;
+
+	if (s == NULL || s < old || s >= old + len)
+		return s;
+	if ((p = str(w_find(w, s))) == NULL) {
+		*ok = 0;
+		return s;
+	}
+	return p;
+}
+
+/*
+ * Points the strings the resident objects have from the old strings
+ * at 'old' to the mapping in use. Returns -1 if one of them is not in
+ * the new snapshot, and the old mapping must then be kept.
+ */
+static int
+repoint(const struct writer *w, const char *old, size_t len)
+{
+	struct object			*obj;
+	struct room			*room;
+	struct exit			*e;
+	struct desc			*d;
+	size_t				 i;
+	int				 j, k, ok;
+	ObjType				 t;
+
+	ok = 1;
+	for (t = 0; t < MAX_OBJ_TYPE; t++) {
+		obj = NULL;
+		while ((obj = object_next_of_type(t, obj)) != NULL) {
+			obj->title = moved(w, obj->title, old, len, &ok);
+			if (!IS_ROOM(obj))
+				continue;
+			room = ROOM(obj);
+			for (i = 0; i < room->nexits; i++) {
+				e = &room->exits[i];
+				e->key = (char *) moved(w, e->key, old, len,
+				    &ok);
+				e->target = (char *) moved(w, e->target, old,
+				    len, &ok);
+				e->travel_desc = moved(w, e->travel_desc, old,
+				    len, &ok);
+				e->desc = moved(w, e->desc, old, len, &ok);
+			}
+			for (j = 0; j < MAX_DESC_TYPES; j++)
+				for (k = 0; k < room->n_desc[j]; k++) {
+					d = &room->desc[j][k];
+					d->name = (char *) moved(w, d->name,
+					    old, len, &ok);
+					d->text = moved(w, d->text, old, len,
+					    &ok);
+				}
+		}
+	}
+
+	return ok ? 0 : -1;
+}
+
+static int
+compare_keys(const void *a, const void *b)
+{
+	return strcmp((*(struct object * const *) a)->key,
+	    (*(struct object * const *) b)->key);
+}
+
+static int
+w_file(struct writer *w, const char *path)
+{
+	struct snap_hdr			 hdr;
+	const void			*data[MAX_SECTS];
+	uint64_t			 off;
+	int				 fd, i;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, SNAP_MAGIC, sizeof(hdr.magic));
+	hdr.version = SNAP_VERSION;
+	for (i = 0; i < MAX_TAGS && tag_name(i) != NULL; i++)
+		hdr.tags[i] = w_str(w, tag_name(i));
+	hdr.ntags = i;
+	for (i = 0; i < MAX_OBJ_TYPE; i++)
+		hdr.max_id[i] = max_object_id(i);
+	if (w->error)
+		return -1;
+
+	data[SECT_ROOMS] = w->rooms;
+	data[SECT_EXITS] = w->exits;
+	data[SECT_DESCS] = w->descs;
+	data[SECT_ACTS] = w->acts;
+	data[SECT_STRINGS] = w->strs;
+	hdr.sect[SECT_ROOMS].n = w->nrooms;
+	hdr.sect[SECT_EXITS].n = w->nexits;
+	hdr.sect[SECT_DESCS].n = w->ndescs;
+	hdr.sect[SECT_ACTS].n = w->nacts;
+	hdr.sect[SECT_STRINGS].n = w->nstrs;
+	off = sizeof(hdr);
+	for (i = 0; i < MAX_SECTS; i++) {
+		hdr.sect[i].off = off = SNAP_ALIGN(off);
+		off += hdr.sect[i].n * _sectsz[i];
+	}
+	hdr.size = off;
+
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+		warn("%s", path);
+		return -1;
+	}
+	for (i = 0; i < MAX_SECTS; i++)
+		if (hdr.sect[i].n > 0 && pwrite(fd, data[i],
+		    hdr.sect[i].n * _sectsz[i], hdr.sect[i].off) !=
+		    (ssize_t) (hdr.sect[i].n * _sectsz[i]))
+			goto fail;
+	if (pwrite(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+	    fsync(fd) == -1)
+		goto fail;
+	return close(fd);
+fail:
+	warn("%s", path);
+	close(fd);
+	return -1;
+}
+
+/*
+ * Writes a new snapshot that has the resident rooms as they are now
+ * and the rest copied over from the old snapshot, replaces the old
+ * one with it and goes on from the new one.
+ */
+int
+snapshot_save(void)
+{
+	struct writer			 w;
+	struct object			**res = NULL, **p, *obj;
+	const struct snap_room		*rooms;
+	const char			*obase, *ostrs = NULL;
+	size_t				 nres, ares, nmap, r, m;
+	size_t				 osize, olen = 0;
+	char				*tmp = NULL;
+	size_t				 len;
+	int				 cmp, fd, ret = -1;
+	ObjType				 t;
+
+	if (!snapshot_active())
+		return -1;
+
+	memset(&w, 0, sizeof(w));
+	nres = ares = 0;
+	obj = NULL;
+	while ((obj = object_next_of_type(OBJ_TYPE_ROOM, obj)) != NULL) {
+		if (grow(&res, &ares, nres + 1, sizeof(*res)) == -1)
+			goto out;
+		res[nres++] = obj;
+	}
+	qsort(res, nres, sizeof(*res), compare_keys);
+
+	/*
+	 * The string table starts with the empty string, so that no
+	 * string is at offset 0.
+	 */
+	if (grow(&w.strs, &w.astrs, 1, 1) == -1)
+		goto out;
+	w.strs[w.nstrs++] = '\0';
+
+	rooms = _base != NULL ? SECT(struct snap_room, SECT_ROOMS) : NULL;
+	nmap = _base != NULL ? _hdr->sect[SECT_ROOMS].n : 0;
+	r = m = 0;
+	while ((r < nres || m < nmap) && !w.error) {
+		if (m < nmap && str(rooms[m].key) == NULL) {
+			m++;
+			continue;
+		}
+		if (r == nres)
+			cmp = 1;
+		else if (m == nmap)
+			cmp = -1;
+		else
+			cmp = strcmp(res[r]->key, str(rooms[m].key));
+
+		if (cmp <= 0) {
+			w_room(&w, ROOM(res[r++]));
+			if (cmp == 0)
+				m++;
+		} else
+			w_mapped(&w, &rooms[m++]);
+	}
+
+	/* Titles of other objects may be borrowed too; keep them. */
+	for (t = 0; t < MAX_OBJ_TYPE; t++) {
+		obj = NULL;
+		while (t != OBJ_TYPE_ROOM &&
+		    (obj = object_next_of_type(t, obj)) != NULL)
+			if (obj->title != NULL && text_borrowed(obj->title))
+				w_str(&w, obj->title);
+	}
+
+	len = strlen(_path) + sizeof(".tmp");
+	if ((tmp = malloc(len)) == NULL)
+		goto out;
+	snprintf(tmp, len, "%s.tmp", _path);
+	if (w_file(&w, tmp) == -1) {
+		unlink(tmp);
+		goto out;
+	}
+	if (rename(tmp, _path) == -1) {
+		warn("rename %s", tmp);
+		unlink(tmp);
+		goto out;
+	}
+
+	for (p = res; p < res + nres; p++)
+		ROOM(*p)->flags &= ~ROOM_DIRTY;
+	if ((fd = open(_path, O_RDONLY)) == -1) {
+		warn("%s", _path);
+		goto out;
+	}
+	obase = _base;
+	osize = _size;
+	if (obase != NULL) {
+		ostrs = _base + _hdr->sect[SECT_STRINGS].off;
+		olen = _hdr->sect[SECT_STRINGS].n;
+	}
+	if ((ret = map(fd)) == -1 || obase == NULL)
+		goto out;
+	if (repoint(&w, ostrs, olen) == -1) {
+		warnx("%s: old snapshot kept in use", _path);
+		goto out;
+	}
+	text_unborrow(ostrs);
+	munmap((void *) obase, osize);
+out:
+	if (ret == -1)
+		warnx("%s: save failed", _path);
+	free(tmp);
+	free(res);
+	free(w.rooms);
+	free(w.exits);
+	free(w.descs);
+	free(w.acts);
+	free(w.strs);
+	free(w.slots);
+	return ret;
+}
@@ -0,0 +1,162 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "stats.h"
+#include "player.h"
+
+#include <err.h>
+#include <time.h>
+
+static struct cmdstats			 _stats[STATS_MAX_CMDS];
+static const char			*_names[STATS_MAX_CMDS];
+static size_t				 _ncmds;
+
+/*
+ * Names the commands, by their index in the command table.
+ */
+void
+stats_init(const char **names, size_t n)
+{
+	size_t				 i;
+
+	if (n > STATS_MAX_CMDS)
+		n = STATS_MAX_CMDS;
+	for (i = 0; i < n; i++)
+		_names[i] = names[i];
+	_ncmds = n;
+}
+
+static uint64_t
+clock_us(clockid_t id)
+{
+	struct timespec			 ts;
+
+	if (clock_gettime(id, &ts) == -1)
+		err(1, "clock_gettime");
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint64_t
+stats_now(void)
+{
+	return clock_us(CLOCK_MONOTONIC);
+}
+
+uint64_t
+stats_cpu(void)
+{
+	return clock_us(CLOCK_THREAD_CPUTIME_ID);
+}
+
+void
+hist_add(struct hist *h, uint64_t v)
+{
+	uint64_t			 max;
+	int				 b;
+
+	b = v == 0 ? 0 : 64 - __builtin_clzll(v);
+	if (b >= HIST_BUCKETS)
+		b = HIST_BUCKETS - 1;
+
+	atomic_fetch_add_explicit(&h->b[b], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&h->sum, v, memory_order_relaxed);
+	max = atomic_load_explicit(&h->max, memory_order_relaxed);
+	while (v > max && !atomic_compare_exchange_weak_explicit(&h->max,
+	    &max, v, memory_order_relaxed, memory_order_relaxed))
+		;
+	atomic_fetch_add_explicit(&h->n, 1, memory_order_relaxed);
+}
+
+/*
+ * Upper bound of the bucket the 'q' quantile falls in, but no more
+ * than the largest value seen.
+ */
+uint64_t
+hist_quantile(const struct hist *h, double q)
+{
+	uint64_t			 n, want, seen, max, v;
+	int				 b;
+
+	n = atomic_load_explicit(&h->n, memory_order_relaxed);
+	max = atomic_load_explicit(&h->max, memory_order_relaxed);
+	if (n == 0)
+		return 0;
+
+	want = q * n;
+	if (want < q * n || want < 1)
+		want++;
+	for (b = 0, seen = 0; b < HIST_BUCKETS; b++) {
+		seen += atomic_load_explicit(&h->b[b], memory_order_relaxed);
+		if (seen >= want)
+			break;
+	}
+	v = b == 0 ? 0 : b >= 64 ? UINT64_MAX : ((uint64_t) 1 << b) - 1;
+	return v < max ? v : max;
+}
+
+/*
+ * Records a run of command 'cmd' that used 'cpu' microseconds and
+ * queued 'bytes' of output.
+ */
+void
+stats_command(int cmd, uint64_t cpu, uint64_t bytes)
+{
+	if (cmd < 0 || (size_t) cmd >= _ncmds)
+		return;
+	hist_add(&_stats[cmd].cpu, cpu);
+	hist_add(&_stats[cmd].bytes, bytes);
+}
+
+void
+stats_latency(int cmd, uint64_t us)
+{
+	if (cmd < 0 || (size_t) cmd >= _ncmds)
+		return;
+	hist_add(&_stats[cmd].latency, us);
+}
+
+/*
+ * The player's output has all been written: the command waiting for
+ * that gets its latency recorded.
+ */
+void
+stats_drained(struct player *plr)
+{
+	if (plr->lat_at == 0)
+		return;
+	stats_latency(plr->lat_cmd, stats_now() - plr->lat_at);
+	plr->lat_at = 0;
+}
+
+size_t
+stats_count(void)
+{
+	return _ncmds;
+}
+
+const char *
+stats_name(int cmd)
+{
+	return _names[cmd];
+}
+
+const struct cmdstats *
+stats_get(int cmd)
+{
+	return &_stats[cmd];
+}
@@ -0,0 +1,79 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct player;
+
+#define HIST_BUCKETS	40
+#define STATS_MAX_CMDS	64
+
+/*
+ * A histogram of values in power of two buckets: bucket 0 counts
+ * zeros and bucket b the values from 2^(b-1) up to 2^b - 1. Updates
+ * are relaxed atomic adds, so recording needs no lock whichever
+ * thread does it, and a reader sees each counter whole.
+ */
+struct hist {
+	_Atomic uint64_t		 n;
+	_Atomic uint64_t		 sum;
+	_Atomic uint64_t		 max;
+	_Atomic uint64_t		 b[HIST_BUCKETS];
+};
+
+/*
+ * Per command: the handler's CPU time and the bytes of output it
+ * queued for the player, and the time from reading the line until the
+ * last byte of the output was written, all in microseconds.
+ */
+struct cmdstats {
+	struct hist			 cpu;
+	struct hist			 bytes;
+	struct hist			 latency;
+};
+
+void					 stats_init(
+					    const char **,
+					    size_t);
+uint64_t				 stats_now(void);
+uint64_t				 stats_cpu(void);
+void					 stats_command(
+					    int,
+					    uint64_t,
+					    uint64_t);
+void					 stats_latency(
+					    int,
+					    uint64_t);
+void					 stats_drained(
+					    struct player *);
+size_t					 stats_count(void);
+const char				*stats_name(int);
+const struct cmdstats			*stats_get(int);
+void					 hist_add(
+					    struct hist *,
+					    uint64_t);
+uint64_t				 hist_quantile(
+					    const struct hist *,
+					    double);
+
+#endif
@@ -0,0 +1,536 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "store.h"
+#include "object.h"
+#include "room.h"
+#include "mem.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * The store file consists of pages of STORE_PAGE_SZ bytes:
+ *
+ *   page 0		header
+ *   pages 1..		room records made by room_pack(), sorted by key.
+ *			A record never straddles a page boundary unless
+ *			it is larger than a page.
+ *   index pages	sorted array of struct store_ent, STORE_ENTS
+ *			per page.
+ *
+ * The first key of each index page is kept in memory, so that a
+ * lookup is a binary search in memory followed by a single page read,
+ * i.e. a two-level B+tree with the root always resident.
+ *
+ * Integers are in host byte order.
+ */
+#define STORE_MAGIC		"TFMUDWS1"
+#define STORE_VERSION		2
+#define STORE_PAGE_SZ		4096
+#define STORE_KEY_SZ		48
+#define STORE_ENTS		(STORE_PAGE_SZ / sizeof(struct store_ent))
+#define DEFAULT_CAPACITY	10000
+#define RING_CHUNK		1024
+
+#define PAGE_ROUNDUP(_x) \
+	(((_x) + STORE_PAGE_SZ - 1) / STORE_PAGE_SZ * STORE_PAGE_SZ)
+
+struct store_hdr {
+	char			 magic[8];
+	uint32_t		 version;
+	uint32_t		 page_sz;
+	uint64_t		 nrecords;
+	uint64_t		 index_page;
+	uint64_t		 max_id[MAX_OBJ_TYPE];
+};
+
+struct store_ent {
+	char			 key[STORE_KEY_SZ];
+	uint64_t		 off;
+	uint32_t		 len;
+	uint32_t		 reserved;
+};
+
+static int			 load_index(void);
+static int			 lookup(const char *, struct store_ent *);
+static int			 admit(struct room *);
+static int			 compare_keys(const void *, const void *);
+static int			 write_record(int, uint64_t *, const char *,
+				    const char *, size_t, struct store_ent **,
+				    size_t *, size_t *);
+
+static char			*_path;
+static int			 _fd = -1;
+static uint64_t			 _nrecords;
+static uint64_t			 _index_page;
+static char			(*_fence)[STORE_KEY_SZ];
+static size_t			 _nfence;
+
+/*
+ * Resident rooms in the order they were admitted, swept by the clock
+ * hand in store_evict().
+ */
+static ObjHandle		*_ring;
+static size_t			 _nring;
+static size_t			 _alloc_ring;
+static size_t			 _hand;
+static size_t			 _capacity = DEFAULT_CAPACITY;
+
+int
+store_open(const char *path)
+{
+	if ((_path = strdup(path)) == NULL)
+		return -1;
+
+	if ((_fd = open(path, O_RDWR)) == -1) {
+		if (errno == ENOENT)
+			return 0;	/* Created by the first save */
+		warn("%s", path);
+		return -1;
+	}
+
+	return load_index();
+}
+
+void
+store_close(void)
+{
+	if (_fd != -1)
+		close(_fd);
+	_fd = -1;
+	free(_path);
+	_path = NULL;
+	if (_fence != NULL)
+		mem_dec(MEM_INDEX, _nfence * STORE_KEY_SZ + 1);
+	free(_fence);
+	_fence = NULL;
+	_nfence = 0;
+	_nrecords = 0;
+}
+
+int
+store_active(void)
+{
+	return _path != NULL;
+}
+
+/*
+ * Whether a room by this key can be kept in the store. Longer keys
+ * could be neither saved nor looked up again.
+ */
+int
+store_key_ok(const char *key)
+{
+	return !store_active() || strlen(key) < STORE_KEY_SZ;
+}
+
+void
+store_set_capacity(size_t capacity)
+{
+	_capacity = capacity;
+}
+
+static int
+load_index(void)
+{
+	struct store_hdr		 hdr;
+	struct store_ent		 ent;
+	size_t				 i;
+	ObjType				 t;
+	void				*p;
+
+	if (pread(_fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+	    memcmp(hdr.magic, STORE_MAGIC, sizeof(hdr.magic)) != 0 ||
+	    hdr.version != STORE_VERSION || hdr.page_sz != STORE_PAGE_SZ) {
+		warnx("%s: not a world store", _path);
+		return -1;
+	}
+	_nrecords = hdr.nrecords;
+	_index_page = hdr.index_page;
+	for (t = 0; t < MAX_OBJ_TYPE; t++)
+		object_reserve_id(t, hdr.max_id[t]);
+
+	if (_fence != NULL)
+		mem_dec(MEM_INDEX, _nfence * STORE_KEY_SZ + 1);
+	_nfence = (_nrecords + STORE_ENTS - 1) / STORE_ENTS;
+	if ((p = realloc(_fence, _nfence * STORE_KEY_SZ + 1)) == NULL) {
+		free(_fence);
+		_fence = NULL;
+		_nfence = 0;
+		return -1;
+	}
+	mem_inc(MEM_INDEX, _nfence * STORE_KEY_SZ + 1);
+	_fence = p;
+	for (i = 0; i < _nfence; i++) {
+		if (pread(_fd, &ent, sizeof(ent),
+		    (_index_page + i) * STORE_PAGE_SZ) != sizeof(ent)) {
+			warn("%s: index", _path);
+			return -1;
+		}
+		memcpy(_fence[i], ent.key, STORE_KEY_SZ);
+	}
+
+	return 0;
+}
+
+static int
+lookup(const char *key, struct store_ent *ent)
+{
+	struct store_ent		 page[STORE_ENTS];
+	size_t				 lo, hi, mid, n;
+	ssize_t				 nr;
+	int				 cmp;
+
+	if (_fd == -1 || _nfence == 0 || strlen(key) >= STORE_KEY_SZ)
+		return -1;
+
+	/*
+	 * Last index page whose first key is <= key.
+	 */
+	lo = 0;
+	hi = _nfence;
+	while (hi - lo > 1) {
+		mid = (lo + hi) / 2;
+		if (strcmp(_fence[mid], key) <= 0)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	n = _nrecords - lo * STORE_ENTS;
+	if (n > STORE_ENTS)
+		n = STORE_ENTS;
+	nr = pread(_fd, page, n * sizeof(struct store_ent),
+	    (_index_page + lo) * STORE_PAGE_SZ);
+	if (nr != (ssize_t) (n * sizeof(struct store_ent)))
+		return -1;
+
+	lo = 0;
+	hi = n;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		cmp = strcmp(page[mid].key, key);
+		if (cmp == 0) {
+			*ent = page[mid];
+			return 0;
+		} else if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return -1;
+}
+
+static int
+admit(struct room *room)
+{
+	ObjHandle			*p;
+
+	if (_nring == _alloc_ring) {
+		p = realloc(_ring, (_alloc_ring + RING_CHUNK) *
+		    sizeof(ObjHandle));
+		if (p == NULL)
+			return -1;
+		if (_alloc_ring > 0)
+			mem_dec(MEM_INDEX, _alloc_ring * sizeof(ObjHandle));
+		mem_inc(MEM_INDEX, (_alloc_ring + RING_CHUNK) *
+		    sizeof(ObjHandle));
+		_ring = p;
+		_alloc_ring += RING_CHUNK;
+	}
+	_ring[_nring++] = object_handle(OBJ(room));
+	room->flags |= ROOM_REF;
+	return 0;
+}
+
+/*
+ * Called for every room created by object_find(). If the store has a
+ * record for the room, the room is filled from it.
+ */
+int
+store_fault(struct room *room)
+{
+	struct store_ent		 ent;
+	char				*buf;
+	int				 ret;
+
+	if (!store_active())
+		return 0;
+
+	if (admit(room) == -1)
+		return -1;
+
+	if (lookup(OBJ(room)->key, &ent) == -1)
+		return 0;
+
+	if ((buf = malloc(ent.len)) == NULL)
+		return -1;
+	if (pread(_fd, buf, ent.len, ent.off) != (ssize_t) ent.len) {
+		warn("%s: %s", _path, OBJ(room)->key);
+		free(buf);
+		return -1;
+	}
+	ret = room_unpack(room, buf, ent.len);
+	if (ret == -1)
+		warnx("%s: %s: corrupted record", _path, OBJ(room)->key);
+	free(buf);
+	return ret;
+}
+
+/*
+ * Faults in the neighbours of a room a player has just entered, so
+ * that the next move does not have to wait for the disk.
+ */
+void
+store_prefetch(struct room *room)
+{
+	size_t				 i;
+
+	if (!store_active())
+		return;
+
+	for (i = 0; i < room->nexits; i++)
+		room_exit_object(room, i);
+}
+
+/*
+ * Clock sweep over the resident rooms. Rooms with something inside
+ * them or with unsaved changes are never evicted. Called between
+ * commands, so that no command sees a room vanish underneath it.
+ */
+void
+store_evict(void)
+{
+	struct object			*obj;
+	struct room			*room;
+	size_t				 scanned;
+
+	if (!store_active())
+		return;
+
+	for (scanned = 0; _nring > _capacity && scanned < 2 * _nring;
+	    scanned++) {
+		if (_hand >= _nring)
+			_hand = 0;
+		obj = object_deref(_ring[_hand]);
+		if (obj == NULL || !IS_ROOM(obj)) {
+			_ring[_hand] = _ring[--_nring];
+			continue;
+		}
+		room = ROOM(obj);
+		if (room->flags & ROOM_REF) {
+			room->flags &= ~ROOM_REF;
+			_hand++;
+		} else if (obj->first_child == NULL &&
+		    !(room->flags & ROOM_DIRTY)) {
+			_ring[_hand] = _ring[--_nring];
+			object_free(obj);
+		} else
+			_hand++;
+	}
+}
+
+static int
+compare_keys(const void *a, const void *b)
+{
+	return strcmp((*(struct object * const *) a)->key,
+	    (*(struct object * const *) b)->key);
+}
+
+static int
+write_record(int fd, uint64_t *pos, const char *key, const char *buf,
+    size_t len, struct store_ent **ents, size_t *nents, size_t *alloc)
+{
+	struct store_ent		*ent;
+
+	if (*nents == *alloc) {
+		*alloc = *alloc == 0 ? STORE_ENTS : *alloc * 2;
+		if ((ent = realloc(*ents, *alloc * sizeof(**ents))) == NULL)
+			return -1;
+		*ents = ent;
+	}
+
+	if (len > STORE_PAGE_SZ ||
+	    *pos % STORE_PAGE_SZ + len > STORE_PAGE_SZ)
+		*pos = PAGE_ROUNDUP(*pos);
+	if (pwrite(fd, buf, len, *pos) != (ssize_t) len)
+		return -1;
+
+	ent = &(*ents)[(*nents)++];
+	memset(ent, 0, sizeof(*ent));
+	snprintf(ent->key, sizeof(ent->key), "%s", key);
+	ent->off = *pos;
+	ent->len = len;
+	*pos += len;
+	return 0;
+}
+
+/*
+ * Writes a new store that has the resident rooms as they are now and
+ * everything else copied over from the old store, then replaces the
+ * old store with it.
+ */
+int
+store_save(void)
+{
+	struct store_hdr		 hdr;
+	struct store_ent		 page[STORE_ENTS], *ents = NULL;
+	struct object			**res = NULL, *obj;
+	size_t				 nres, ares, nents, aents, r, o, n;
+	size_t				 pg;
+	uint64_t			 pos;
+	char				*tmp = NULL, *buf;
+	size_t				 len;
+	int				 fd = -1, cmp, ret = -1;
+	ObjType				 t;
+
+	if (!store_active())
+		return -1;
+
+	nres = ares = 0;
+	obj = NULL;
+	while ((obj = object_next_of_type(OBJ_TYPE_ROOM, obj)) != NULL) {
+		if (!store_key_ok(obj->key)) {
+			warnx("%s: key too long for the store", obj->key);
+			goto out;
+		}
+		if (nres == ares) {
+			ares = ares == 0 ? RING_CHUNK : ares * 2;
+			if ((buf = realloc(res, ares * sizeof(*res))) == NULL)
+				goto out;
+			res = (struct object **) buf;
+		}
+		res[nres++] = obj;
+	}
+	qsort(res, nres, sizeof(*res), compare_keys);
+
+	len = strlen(_path) + sizeof(".tmp");
+	if ((tmp = malloc(len)) == NULL)
+		goto out;
+	snprintf(tmp, len, "%s.tmp", _path);
+	if ((fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644)) == -1) {
+		warn("%s", tmp);
+		goto out;
+	}
+
+	/*
+	 * Merge the sorted resident rooms with the sorted old index.
+	 */
+	pos = STORE_PAGE_SZ;
+	nents = aents = 0;
+	r = o = n = 0;
+	pg = SIZE_MAX;
+	while (r < nres || o < _nrecords) {
+		if (o < _nrecords && o / STORE_ENTS != pg) {
+			pg = o / STORE_ENTS;
+			n = _nrecords - o;
+			if (n > STORE_ENTS)
+				n = STORE_ENTS;
+			if (pread(_fd, page, n * sizeof(struct store_ent),
+			    (_index_page + pg) * STORE_PAGE_SZ) !=
+			    (ssize_t) (n * sizeof(struct store_ent)))
+				goto out;
+		}
+		if (r == nres)
+			cmp = 1;
+		else if (o == _nrecords)
+			cmp = -1;
+		else
+			cmp = strcmp(res[r]->key, page[o % STORE_ENTS].key);
+
+		if (cmp <= 0) {
+			if ((buf = room_pack(ROOM(res[r]), &len)) == NULL)
+				goto out;
+			if (write_record(fd, &pos, res[r]->key, buf, len,
+			    &ents, &nents, &aents) == -1) {
+				free(buf);
+				goto out;
+			}
+			free(buf);
+			r++;
+			if (cmp == 0)
+				o++;
+		} else {
+			len = page[o % STORE_ENTS].len;
+			if ((buf = malloc(len)) == NULL)
+				goto out;
+			if (pread(_fd, buf, len, page[o % STORE_ENTS].off) !=
+			    (ssize_t) len ||
+			    write_record(fd, &pos, page[o % STORE_ENTS].key,
+			    buf, len, &ents, &nents, &aents) == -1) {
+				free(buf);
+				goto out;
+			}
+			free(buf);
+			o++;
+		}
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, STORE_MAGIC, sizeof(hdr.magic));
+	hdr.version = STORE_VERSION;
+	hdr.page_sz = STORE_PAGE_SZ;
+	hdr.nrecords = nents;
+	hdr.index_page = PAGE_ROUNDUP(pos) / STORE_PAGE_SZ;
+	for (t = 0; t < MAX_OBJ_TYPE; t++)
+		hdr.max_id[t] = max_object_id(t);
+
+	if (nents > 0 && pwrite(fd, ents, nents * sizeof(*ents),
+	    hdr.index_page * STORE_PAGE_SZ) !=
+	    (ssize_t) (nents * sizeof(*ents)))
+		goto out;
+	if (pwrite(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+	    fsync(fd) == -1)
+		goto out;
+
+	if (rename(tmp, _path) == -1) {
+		warn("rename %s", tmp);
+		goto out;
+	}
+	if (_fd != -1)
+		close(_fd);
+	_fd = fd;
+	fd = -1;
+	if (load_index() == -1)
+		goto out;
+
+	for (r = 0; r < nres; r++)
+		ROOM(res[r])->flags &= ~ROOM_DIRTY;
+	ret = 0;
+out:
+	if (ret == -1)
+		warnx("%s: save failed", _path);
+	if (fd != -1) {
+		close(fd);
+		unlink(tmp);
+	}
+	free(tmp);
+	free(ents);
+	free(res);
+	return ret;
+}
@@ -0,0 +1,43 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef STORE_H
+#define STORE_H
+
+#include <stddef.h>
+
+struct room;
+
+/*
+ * Paged on-disk world store. When a store is open, rooms are faulted
+ * in from the store file the first time they are looked up and rooms
+ * that have not been used lately are evicted again, so that only a
+ * working set of the world needs to be resident.
+ */
+int				 store_open(const char *);
+void				 store_close(void);
+int				 store_active(void);
+int				 store_key_ok(const char *);
+void				 store_set_capacity(size_t);
+
+int				 store_fault(struct room *);
+void				 store_prefetch(struct room *);
+void				 store_evict(void);
+int				 store_save(void);
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "tag.h"
+#include "player.h"
+#include "object.h"
+#include "room.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+static char				 names[MAX_TAGS][TAG_NAME_MAX];
+static int				 ntags;
+static TagSet				 global_tags;
+
+static const char			*scopes[] = {
+	"rtag", "ptag", "gtag"
+};
+
+/*
+ * Bit of tag 'name', or -1 if there is no such tag.
+ */
+int
+tag_find(const char *name)
+{
+	int				 i;
+
+	for (i = 0; i < ntags; i++)
+		if (strcmp(names[i], name) == 0)
+			return i;
+
+	return -1;
+}
+
+/*
+ * Bit of tag 'name', allocating one if needed. Returns -1 if the name
+ * is not a valid tag name or if all bits are taken.
+ */
+int
+tag_intern(const char *name)
+{
+	const char			*p;
+	int				 i;
+
+	if ((i = tag_find(name)) != -1)
+		return i;
+
+	if (*name == '\0' || strlen(name) >= TAG_NAME_MAX)
+		return -1;
+	for (p = name; *p != '\0'; p++)
+		if (!isalnum((unsigned char) *p) && *p != '_' && *p != '-')
+			return -1;
+	if (ntags == MAX_TAGS)
+		return -1;
+
+	snprintf(names[ntags], sizeof(names[0]), "%s", name);
+	return ntags++;
+}
+
+const char *
+tag_name(int i)
+{
+	if (i < 0 || i >= ntags)
+		return NULL;
+
+	return names[i];
+}
+
+/*
+ * Parses a condition such as "night,!cloudy" into the required and
+ * forbidden tag sets. Modifies 'spec'.
+ */
+int
+tag_parse_cond(char *spec, TagSet *req, TagSet *forbid, const char **errstr)
+{
+	char				*name, *next;
+	int				 i, neg;
+
+	*req = *forbid = 0;
+	for (name = spec; name != NULL; name = next) {
+		if ((next = strchr(name, ',')) != NULL)
+			*next++ = '\0';
+		if ((neg = (*name == '!')))
+			name++;
+		if (*name == '\0')
+			continue;
+		if ((i = tag_intern(name)) == -1) {
+			*errstr = ntags == MAX_TAGS ? "too many tags" :
+			    "bad tag name";
+			return -1;
+		}
+		if (neg)
+			*forbid |= TAG_BIT(i);
+		else
+			*req |= TAG_BIT(i);
+	}
+
+	if ((*req & *forbid) != 0) {
+		*errstr = "condition can never hold";
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Inverse of tag_parse_cond(). Returns the length the condition would
+ * have, like snprintf(3).
+ */
+size_t
+tag_format(TagSet req, TagSet forbid, char *buf, size_t sz)
+{
+	size_t				 len;
+	int				 i;
+
+	len = 0;
+	if (sz > 0)
+		*buf = '\0';
+	for (i = 0; i < ntags; i++) {
+		if (!((req | forbid) & TAG_BIT(i)))
+			continue;
+		len += snprintf(len < sz ? &buf[len] : NULL,
+		    len < sz ? sz - len : 0, "%s%s%s", len > 0 ? "," : "",
+		    (forbid & TAG_BIT(i)) ? "!" : "", names[i]);
+	}
+
+	return len;
+}
+
+int
+tag_scope_parse(const char *name)
+{
+	size_t				 i;
+
+	if (strcmp(name, "atag") == 0)
+		return TAG_PLAYER;
+	for (i = 0; i < MAX_TAG_SCOPES; i++)
+		if (strcmp(scopes[i], name) == 0)
+			return i;
+
+	return -1;
+}
+
+const char *
+tag_scope_name(TagScope scope)
+{
+	return scopes[scope];
+}
+
+/*
+ * The tags 'plr' sees in 'scope', or NULL if there are none, e.g. for
+ * room tags when not in a room.
+ */
+TagSet *
+tag_scope(TagScope scope, struct player *plr)
+{
+	switch (scope) {
+	case TAG_ROOM:
+		if (plr == NULL || ENV(plr) == NULL || !IS_ROOM(ENV(plr)))
+			return NULL;
+		return &player_env(plr)->tags;
+	case TAG_PLAYER:
+		return plr != NULL ? &plr->tags : NULL;
+	case TAG_GLOBAL:
+		return &global_tags;
+	default:
+		return NULL;
+	}
+}
+
+/*
+ * Everything description variants are selected against.
+ */
+TagSet
+tag_view(struct player *plr)
+{
+	TagSet				 have;
+
+	have = global_tags | plr->tags;
+	if (ENV(plr) != NULL && IS_ROOM(ENV(plr)))
+		have |= player_env(plr)->tags;
+
+	return have;
+}
@@ -0,0 +1,71 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef TAG_H
+#define TAG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct player;
+
+/*
+ * Tag names are interned to bit positions when first seen, so a set of
+ * tags is a single word and testing a condition against it is two ANDs
+ * and two compares.
+ */
+typedef uint64_t TagSet;
+
+#define MAX_TAGS		64
+#define TAG_NAME_MAX		32
+#define TAG_BIT(_i)		((TagSet) 1 << (_i))
+
+/*
+ * A condition holds when all of 'req' and none of 'forbid' are set.
+ */
+#define TAG_MATCH(_have, _req, _forbid) \
+	(((_have) & (_req)) == (_req) && ((_have) & (_forbid)) == 0)
+
+typedef enum tag_scope {
+	TAG_ROOM=0,
+	TAG_PLAYER,
+	TAG_GLOBAL,
+	MAX_TAG_SCOPES
+} TagScope;
+
+int				 tag_intern(const char *);
+int				 tag_find(const char *);
+const char			*tag_name(int);
+int				 tag_parse_cond(
+				    char *,
+				    TagSet *,
+				    TagSet *,
+				    const char **);
+size_t				 tag_format(
+				    TagSet,
+				    TagSet,
+				    char *,
+				    size_t);
+int				 tag_scope_parse(const char *);
+const char			*tag_scope_name(TagScope);
+TagSet				*tag_scope(
+				    TagScope,
+				    struct player *);
+TagSet				 tag_view(struct player *);
+
+#endif
@@ -23,6 +23,9 @@
 #include "object.h"
 #include "room.h"
 #include "fmtbuf.h"
+#include "msgbuf.h"
+#include "arena.h"
+#include "stats.h"
 
 #include <stddef.h>
 #include <stdlib.h>
@@ -30,7 +33,13 @@
 #include <unistd.h>
 #include <err.h>
 
+#define TELL_PROFILES	8
+
 static int	client_write(struct evsrc *src, void *data);
+static void	seal_fmtbuf(struct player *);
+static int	want_write(struct player *);
+static void	tellp_msgbuf(struct player *, MsgClass, struct msgbuf *);
+static struct msgbuf	*render(struct fmtbuf *, const char *);
 
 static void				 tellpfv(
 					    struct player *,
@@ -175,21 +184,87 @@ wrap_buf(char *buf)
 }
 #endif
 
-static int
-client_write(struct evsrc *src, void *data)
+/*
+ * Moves what has been formatted so far to the output queue.
+ */
+static void
+seal_fmtbuf(struct player *plr)
 {
-	struct player *plr = (struct player *) data;
+	struct msgbuf			*mb;
+
+	if (plr->fmtbuf.j == 0)
+		return;
 
-	write(plr->evsrc->value, plr->fmtbuf.outbuf,
-	    strlen(plr->fmtbuf.outbuf));
+	if ((mb = msgbuf_new(plr->fmtbuf.outbuf, plr->fmtbuf.j)) != NULL) {
+		if (msgq_push(&plr->outq, MSG_RESPONSE, mb) == -1)
+			warn("msgq_push");
+		msgbuf_release(mb);
+	} else
+		warn("msgbuf_new");
 	plr->fmtbuf.j = 0;
+	plr->fmtbuf.outbuf[0] = '\0';
+}
+
+/*
+ * Queues a rendered paragraph shared with other players. A paragraph
+ * the player is in the middle of is ended first.
+ */
+static void
+tellp_msgbuf(struct player *plr, MsgClass cl, struct msgbuf *mb)
+{
+	if (want_write(plr) == -1)
+		return;
+
+	if (plr->fmtbuf.len > 0 || plr->fmtbuf.state != BEGIN_WORD)
+		end_fmtbuf(&plr->fmtbuf);
+	seal_fmtbuf(plr);
+	if (msgq_push(&plr->outq, cl, mb) == -1)
+		warn("msgq_push");
+}
+
+static int
+client_write(struct evsrc *src, void *data)
+{
+	struct player *plr;
+	struct object *obj;
+	struct msgbuf *mb;
+	char note[64];
+	int rv;
+
+	if ((obj = object_deref(PTR_TO_HANDLE(data))) == NULL ||
+	    !IS_PLAYER(obj))
+		return -1;
+	plr = PLAYER(obj);
+
+	seal_fmtbuf(plr);
+	rv = msgq_flush(&plr->outq, plr->evsrc->value);
+	if (rv == 0 && plr->outq.dropped > 0) {
+		snprintf(note, sizeof(note), "(%zu messages were skipped.)",
+		    plr->outq.dropped);
+		plr->outq.dropped = 0;
+		if ((mb = render(&plr->fmtbuf, note)) != NULL) {
+			msgq_push(&plr->outq, MSG_SYSTEM, mb);
+			msgbuf_release(mb);
+		}
+		rv = msgq_flush(&plr->outq, plr->evsrc->value);
+	}
+	switch (rv) {
+	case -1:
+		warn("write");
+		msgq_clear(&plr->outq);
+		plr->lat_at = 0;
+		break;
+	case 0:
+		stats_drained(plr);
+		break;
+	case 1:
+		event_add_evsrc(plr->evsrc->ev, plr->evwrite);
+		break;
+	}
 	plr->fmtbuf.len = 0;
 	plr->fmtbuf.state = BEGIN_WORD;
 	plr->fmtbuf.upper = 0;
 
-	/*
-	 * TODO: Add back the support for partial writes.
-	 */
 #if 0
 	if (plr->outbuf == NULL)
 		return 0;
@@ -220,35 +295,66 @@ client_write(struct evsrc *src, void *data)
 	return 0;
 }
 
-void
-tellp(struct player *plr, const char *msg)
+static int
+want_write(struct player *plr)
 {
-	if (msg == NULL || plr->evsrc == NULL)
-		return;
+	if (plr->evsrc == NULL)
+		return -1;
 
 	if (plr->evwrite == NULL) {
 		plr->evwrite = evsrc_create_write_fd(plr->evsrc->value,
-		    client_write, plr);
+		    client_write, HANDLE_TO_PTR(object_handle(OBJ(plr))));
 		if (plr->evwrite == NULL) {
 			warn("evsrc_create_write_fd");
-			return;
+			return -1;
 		}
 	}
 	event_add_evsrc(plr->evsrc->ev, plr->evwrite);
+	return 0;
+}
+
+void
+tellp(struct player *plr, const char *msg)
+{
+	if (msg == NULL || want_write(plr) == -1)
+		return;
 
 	add_fmtbuf(&plr->fmtbuf, msg);
 }
 
+void
+tellp_raw(struct player *plr, const char *msg)
+{
+	if (msg == NULL || want_write(plr) == -1)
+		return;
+
+	add_fmtbuf_raw(&plr->fmtbuf, msg);
+}
+
+/*
+ * For descriptions and titles; see add_fmtbuf_text().
+ */
+void
+tellp_text(struct player *plr, const char *text)
+{
+	if (text == NULL || want_write(plr) == -1)
+		return;
+
+	add_fmtbuf_text(&plr->fmtbuf, text);
+}
+
 static void
 tellpfv(struct player *plr, const char *fmt, va_list ap)
 {
-	static char			 buf[8192];
-	size_t				 n;
+	ArenaMark			 mark;
+	char				*buf;
 
-	n = vsnprintf(buf, sizeof(buf), fmt, ap);
-	if (n >= sizeof(buf))
-		warn("too long message in tellpfv");
-	tellp(plr, buf);
+	mark = arena_mark();
+	if ((buf = arena_vprintf(fmt, ap)) != NULL)
+		tellp(plr, buf);
+	else
+		warn("tellpfv");
+	arena_release(mark);
 }
 
 void
@@ -261,23 +367,127 @@ tellpf(struct player *plr, const char *fmt, ...)
 	va_end(ap);
 }
 
-void
-tellrm(struct object *room, struct player **excl, const char *buf)
+/*
+ * Renders 'buf' as a paragraph for players formatting like 'fb'.
+ */
+static struct msgbuf *
+render(struct fmtbuf *fb, const char *buf)
+{
+	static struct fmtbuf		 scratch;
+
+	memset(&scratch, 0, sizeof(scratch));
+	scratch.width = fb->width;
+	scratch.nocolor = fb->nocolor;
+	add_fmtbuf(&scratch, buf);
+	end_fmtbuf(&scratch);
+
+	return msgbuf_new(scratch.outbuf, scratch.j);
+}
+
+/*
+ * Fan-out of one message to many players. The message is formatted
+ * once per distinct width and color setting among the recipients and
+ * the result is shared by their queues.
+ */
+struct fanout {
+	const char			*buf;
+	MsgClass			 cl;
+	size_t				 nprof;
+	struct {
+		size_t			 width;
+		int			 nocolor;
+		struct msgbuf		*mb;
+	}				 prof[TELL_PROFILES];
+};
+
+static void
+fanout_send(struct fanout *fo, struct player *plr)
 {
+	struct fmtbuf			*fb;
+	struct msgbuf			*mb;
+	size_t				 i;
+
+	fb = &plr->fmtbuf;
+	for (i = 0; i < fo->nprof; i++)
+		if (fo->prof[i].width == FB_WIDTH(fb) &&
+		    fo->prof[i].nocolor == fb->nocolor) {
+			tellp_msgbuf(plr, fo->cl, fo->prof[i].mb);
+			return;
+		}
+
+	if ((mb = render(fb, fo->buf)) == NULL)
+		return;
+	tellp_msgbuf(plr, fo->cl, mb);
+	if (fo->nprof < TELL_PROFILES) {
+		fo->prof[fo->nprof].width = FB_WIDTH(fb);
+		fo->prof[fo->nprof].nocolor = fb->nocolor;
+		fo->prof[fo->nprof++].mb = mb;
+	} else
+		msgbuf_release(mb);
+}
+
+static void
+fanout_end(struct fanout *fo)
+{
+	size_t				 i;
+
+	for (i = 0; i < fo->nprof; i++)
+		msgbuf_release(fo->prof[i].mb);
+	fo->nprof = 0;
+}
+
+/*
+ * Room broadcasts are ambient unless said otherwise; see tellrfc().
+ */
+static void
+tellrmc(struct object *room, struct player **excl, MsgClass cl,
+    const char *buf)
+{
+	static uint32_t			 gen;
+	struct fanout			 fo;
 	struct object			*obj;
+	struct player			*plr, **ep;
 
+	/*
+	 * Excluded players are stamped with this broadcast's generation
+	 * so that checking a recipient is a single compare.
+	 */
+	if (++gen == 0)
+		gen = 1;
+	for (ep = excl; ep != NULL && *ep != NULL; ep++)
+		(*ep)->excl_gen = gen;
+
+	fo.buf = buf;
+	fo.cl = cl;
+	fo.nprof = 0;
 	obj = NULL;
-	while ((obj = object_next_child(room, obj)) != NULL)
-		if (IS_PLAYER(obj)) {
-			if (excl != NULL)
-				for (; *excl != NULL; excl++)
-					if (*excl == PLAYER(obj))
-						break;
-			if (excl == NULL || *excl == NULL) {
-				tellp(PLAYER(obj), buf);
-				end_fmtbuf(&PLAYER(obj)->fmtbuf);
-			}
-		}
+	while ((obj = object_next_player(room, obj)) != NULL)
+		if ((plr = PLAYER(obj)) != NULL && plr->excl_gen != gen)
+			fanout_send(&fo, plr);
+	fanout_end(&fo);
+}
+
+void
+tellrm(struct object *room, struct player **excl, const char *buf)
+{
+	tellrmc(room, excl, MSG_AMBIENT, buf);
+}
+
+/*
+ * Tells the 'n' players in 'plrs', e.g. the subscribers of a channel.
+ */
+void
+tellpm(struct player **plrs, size_t n, const char *buf)
+{
+	struct fanout			 fo;
+	size_t				 i;
+
+	fo.buf = buf;
+	fo.cl = MSG_DIRECTED;
+	fo.nprof = 0;
+	for (i = 0; i < n; i++)
+		fanout_send(&fo, plrs[i]);
+	fanout_end(&fo);
 }
 
 void
@@ -289,15 +499,18 @@ tellr(struct object *room, struct player *plr, const char *buf)
 }
 
 static void
-tellrfv(struct object *room, struct player **excl, const char *fmt, va_list ap)
+tellrfv(struct object *room, struct player **excl, MsgClass cl,
+    const char *fmt, va_list ap)
 {
-	static char			 buf[8192];
-	size_t				 n;
+	ArenaMark			 mark;
+	char				*buf;
 
-	n = vsnprintf(buf, sizeof(buf), fmt, ap);
-	if (n >= sizeof(buf))
-		warn("too long message in tellrfv");
-	tellrm(room, excl, buf);
+	mark = arena_mark();
+	if ((buf = arena_vprintf(fmt, ap)) != NULL)
+		tellrmc(room, excl, cl, buf);
+	else
+		warn("tellrfv");
+	arena_release(mark);
 }
 
 void
@@ -306,7 +519,7 @@ tellrfm(struct object *room, struct player **excl, const char *fmt, ...)
 	va_list				 ap;
 
 	va_start(ap, fmt);
-	tellrfv(room, excl, fmt, ap);
+	tellrfv(room, excl, MSG_AMBIENT, fmt, ap);
 	va_end(ap);
 }
 
@@ -317,6 +530,18 @@ tellrf(struct object *room, struct player *plr, const char *fmt, ...)
 	struct player			*excl[] = { plr, NULL };
 
 	va_start(ap, fmt);
-	tellrfv(room, excl, fmt, ap);
+	tellrfv(room, excl, MSG_AMBIENT, fmt, ap);
+	va_end(ap);
+}
+
+void
+tellrfc(struct object *room, struct player *plr, MsgClass cl,
+    const char *fmt, ...)
+{
+	va_list				 ap;
+	struct player			*excl[] = { plr, NULL };
+
+	va_start(ap, fmt);
+	tellrfv(room, excl, cl, fmt, ap);
 	va_end(ap);
 }
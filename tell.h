@@ -20,6 +20,9 @@
 #define TELL_H
 
 #include <stdarg.h>
+#include <stddef.h>
+
+#include "msgbuf.h"
 
 struct player;
 struct room;
@@ -27,19 +30,37 @@ struct object;
 
 /*
  * tellp:	tell player
+ * tellp_raw:	tell player	(preformatted, no word wrapping)
+ * tellp_text:	tell player	(long lived text, formatting is cached)
  * tellpf:	tell player	(formated)
+ * tellpm:	tell players	(list of players, shared output)
  * tellr:	tell room	(single exclude)
  * tellrm:	tell room	(multiple exclude)
  * tellrf:	tell room	(formated, single exclude)
  * tellrfm:	tell room	(formated, multiple exclude)
+ * tellrfc:	tell room	(formated, single exclude, not ambient)
+ *
+ * Room messages are ambient and go out last to a congested client;
+ * tellpm() messages are directed and the player's own output is a
+ * response.
  */
 void					 tellp(
 					    struct player *,
 					    const char *);
+void					 tellp_raw(
+					    struct player *,
+					    const char *);
+void					 tellp_text(
+					    struct player *,
+					    const char *);
 void					 tellpf(
 					    struct player *,
 					    const char *,
 					    ...);
+void					 tellpm(
+					    struct player **,
+					    size_t,
+					    const char *);
 void					 tellr(
 					    struct object *,
 					    struct player *,
@@ -58,5 +79,11 @@ void					 tellrfm(
 					    struct player **,
 					    const char *,
 					    ...);
+void					 tellrfc(
+					    struct object *,
+					    struct player *,
+					    MsgClass,
+					    const char *,
+					    ...);
 
 #endif
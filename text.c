@@ -0,0 +1,200 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "text.h"
+#include "fmtbuf.h"
+#include "mem.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEXT_HASH_SZ	16384
+#define MAX_BORROWED	2	/* The snapshot in use and its successor */
+
+struct text {
+	struct text			*next;
+	uint32_t			 hash;
+	uint32_t			 refs;
+	size_t				 len;
+	char				 s[];
+};
+
+#define TEXT(_s) \
+	((struct text *) ((char *) (_s) - offsetof(struct text, s)))
+
+struct range {
+	const char			*base;
+	size_t				 len;
+};
+
+static struct text			*_hash[TEXT_HASH_SZ];
+static size_t				 _ntexts;
+static struct range			 _borrowed[MAX_BORROWED];
+
+static uint32_t
+text_hash(const char *s, size_t len)
+{
+	uint32_t			 h;
+	size_t				 i;
+
+	h = 2166136261U;
+	for (i = 0; i < len; i++)
+		h = (h ^ (unsigned char) s[i]) * 16777619U;
+
+	return h;
+}
+
+/*
+ * Returns the shared copy of 's', or NULL if out of memory.
+ */
+const char *
+text_intern(const char *s)
+{
+	struct text			*t;
+	uint32_t			 h;
+	size_t				 len;
+
+	if (s == NULL)
+		return NULL;
+	if (text_borrowed(s))
+		return s;
+
+	len = strlen(s);
+	h = text_hash(s, len);
+	for (t = _hash[h % TEXT_HASH_SZ]; t != NULL; t = t->next)
+		if (t->hash == h && t->len == len &&
+		    memcmp(t->s, s, len) == 0 && t->refs < UINT32_MAX) {
+			t->refs++;
+			return t->s;
+		}
+
+	if ((t = malloc(sizeof(*t) + len + 1)) == NULL)
+		return NULL;
+	mem_inc(MEM_DESC, sizeof(*t) + len + 1);
+	t->hash = h;
+	t->refs = 1;
+	t->len = len;
+	memcpy(t->s, s, len + 1);
+	t->next = _hash[h % TEXT_HASH_SZ];
+	_hash[h % TEXT_HASH_SZ] = t;
+	_ntexts++;
+
+	return t->s;
+}
+
+const char *
+text_ref(const char *s)
+{
+	if (s == NULL || text_borrowed(s))
+		return s;
+	if (TEXT(s)->refs == UINT32_MAX)
+		return text_intern(s);
+
+	TEXT(s)->refs++;
+	return s;
+}
+
+void
+text_release(const char *s)
+{
+	struct text			*t, **tp;
+
+	if (s == NULL || text_borrowed(s))
+		return;
+
+	t = TEXT(s);
+	if (--t->refs > 0)
+		return;
+
+	for (tp = &_hash[t->hash % TEXT_HASH_SZ]; *tp != NULL;
+	    tp = &(*tp)->next)
+		if (*tp == t) {
+			*tp = t->next;
+			break;
+		}
+	fmtcache_invalidate(t->s);
+	mem_dec(MEM_DESC, sizeof(*t) + t->len + 1);
+	_ntexts--;
+	free(t);
+}
+
+/*
+ * Share of the text's memory held by one reference.
+ */
+size_t
+text_bytes(const char *s)
+{
+	if (s == NULL || text_borrowed(s))
+		return 0;
+
+	return (sizeof(struct text) + TEXT(s)->len + 1) / TEXT(s)->refs;
+}
+
+size_t
+text_count(void)
+{
+	return _ntexts;
+}
+
+/*
+ * Makes the NUL terminated strings in the 'len' bytes at 'base' texts
+ * that need no copy. The range must stay valid until given back with
+ * text_unborrow(). Returns -1 if MAX_BORROWED ranges are borrowed.
+ */
+int
+text_borrow(const char *base, size_t len)
+{
+	size_t				 i;
+
+	for (i = 0; i < MAX_BORROWED; i++)
+		if (_borrowed[i].base == NULL) {
+			_borrowed[i].base = base;
+			_borrowed[i].len = len;
+			return 0;
+		}
+	return -1;
+}
+
+/*
+ * Gives back a range once nothing points into it any more.
+ */
+void
+text_unborrow(const char *base)
+{
+	size_t				 i;
+
+	for (i = 0; i < MAX_BORROWED; i++)
+		if (_borrowed[i].base == base) {
+			fmtcache_invalidate_range(base, _borrowed[i].len);
+			_borrowed[i].base = NULL;
+			_borrowed[i].len = 0;
+		}
+}
+
+int
+text_borrowed(const char *s)
+{
+	size_t				 i;
+
+	for (i = 0; i < MAX_BORROWED; i++)
+		if (s >= _borrowed[i].base &&
+		    s < _borrowed[i].base + _borrowed[i].len)
+			return 1;
+	return 0;
+}
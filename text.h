@@ -0,0 +1,44 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <stddef.h>
+
+/*
+ * Shared immutable texts for titles and descriptions. Equal strings
+ * are stored once and reference counted; a text must be released as
+ * many times as it was interned or referenced.
+ *
+ * Strings inside a borrowed range, such as a mapped world snapshot,
+ * are texts as they are: interning or referencing one returns it and
+ * releasing one does nothing.
+ */
+const char				*text_intern(const char *);
+const char				*text_ref(const char *);
+void					 text_release(const char *);
+size_t					 text_bytes(const char *);
+size_t					 text_count(void);
+int					 text_borrow(
+					    const char *,
+					    size_t);
+void					 text_unborrow(const char *);
+int					 text_borrowed(const char *);
+
+#endif
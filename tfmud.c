@@ -24,6 +24,10 @@
 #include "match.h"
 #include "player.h"
 #include "command.h"
+#include "store.h"
+#include "snapshot.h"
+#include "sched.h"
+#include "loader.h"
 #include "util.h"
 
 #include <err.h>
@@ -95,7 +99,8 @@ server_accept(struct evsrc *src, void *data)
 		return -1;
 	}
 
-	plrsrc = evsrc_create_fd(fd, client_read, plr);
+	plrsrc = evsrc_create_fd(fd, client_read,
+	    HANDLE_TO_PTR(object_handle(OBJ(plr))));
 	if (plrsrc == NULL) {
 		warn("evsrc_create_fd");
 		return -1;
@@ -115,14 +120,19 @@ server_accept(struct evsrc *src, void *data)
 static int
 client_read(struct evsrc *src, void *data)
 {
-	struct player *plr = (struct player *) data;
-
-	printf("Got event\n");
-
+	struct player *plr;
+	struct object *obj;
 	int n;
 	int len;
 	char dst[READ_BLOCK];
 
+	printf("Got event\n");
+
+	if ((obj = object_deref(PTR_TO_HANDLE(data))) == NULL ||
+	    !IS_PLAYER(obj))
+		return -1;
+	plr = PLAYER(obj);
+
 	if (sizeof(plr->buf) - 1 - plr->sz <= 0) {
 		warnx("discarded %d bytes; too long line", plr->sz);
 		plr->sz = 0;
@@ -134,11 +144,12 @@ client_read(struct evsrc *src, void *data)
 		plr->buf[plr->sz] = '\0';
 		while ((len = parseline(plr->buf, dst, sizeof(dst)))
 		    != -1) {
-			player_input(plr, dst);
+			sched_push(plr, dst);
 			plr->sz -= len;
 		}
 	} else if (n < 0 || n == 0) {
-		object_free(OBJ(plr));
+		object_free(obj);
+		player_free(plr);
 		return -1;
 	}
 
@@ -152,32 +163,11 @@ timercb(struct evsrc *evsrc, void *data)
 }
 
 static void
-load_world(const char *file)
+usage(void)
 {
-	FILE				*fp;
-	struct object			*obj, *env;
-	struct player			*plr;
-	char				 buf[512];
-
-	fp = fopen(file, "r");
-	if (fp == NULL) {
-		warn("%s", file);
-		return;
-	}
-
-	obj = object_create("player/digger");
-	plr = obj->v.player = calloc(1, sizeof(struct player));
-	plr->object = obj;
-	env = object_find("room/1");
-	object_reparent(obj, env);
-	tellp(plr, "Digging");
-	while (fgets(buf, sizeof(buf), fp) != NULL) {
-		buf[strcspn(buf, "\r\n")] = '\0';
-		player_input(plr, buf);
-	}
-
-	fclose(fp);
-	object_free(obj);
+	fprintf(stderr, "usage: tfmud [-c rooms] [-S snapshot | -s store] "
+	    "[-w world]\n");
+	exit(1);
 }
 
 int
@@ -185,7 +175,45 @@ main(int argc, char *argv[])
 {
 	struct event			*ev;
 	struct evsrc			*fdsrc, *timersrc;
-	int				 fd;
+	int				 fd, ch;
+	const char			*store = NULL, *snapshot = NULL;
+	const char			**worlds = NULL, **p;
+	size_t				 nworlds = 0;
+	long long			 capacity;
+	char				*ep;
+
+	while ((ch = getopt(argc, argv, "c:S:s:w:")) != -1) {
+		switch (ch) {
+		case 'c':
+			capacity = strtoll(optarg, &ep, 10);
+			if (*optarg == '\0' || *ep != '\0' || capacity < 1)
+				errx(1, "invalid capacity: %s", optarg);
+			store_set_capacity(capacity);
+			break;
+		case 'S':
+			snapshot = optarg;
+			break;
+		case 's':
+			store = optarg;
+			break;
+		case 'w':
+			if ((p = realloc(worlds, (nworlds + 1) *
+			    sizeof(*worlds))) == NULL)
+				err(1, "realloc");
+			worlds = p;
+			worlds[nworlds++] = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || (store != NULL && snapshot != NULL))
+		usage();
+	if (nworlds == 0) {
+		if ((worlds = malloc(sizeof(*worlds))) == NULL)
+			err(1, "malloc");
+		worlds[nworlds++] = "rooms.txt";
+	}
 
 	fd = tcpbind("*", 4000);
 
@@ -207,11 +235,48 @@ main(int argc, char *argv[])
 	if (event_add_evsrc(ev, timersrc) != 0)
 		err(1, "event_add_evsrc");
 
-	load_world("rooms.txt");
-
-	for (;;)
-		if (event_dispatch(ev) == -1)
+	player_init();
+
+	/*
+	 * A new store or snapshot is populated from the world files;
+	 * afterwards it is the world.
+	 */
+	if (snapshot != NULL && access(snapshot, F_OK) == 0) {
+		if (snapshot_open(snapshot) == -1)
+			errx(1, "%s: cannot open world snapshot", snapshot);
+	} else if (snapshot != NULL) {
+		if (snapshot_open(snapshot) == -1)
+			errx(1, "%s: cannot create world snapshot", snapshot);
+		if (loader_load(worlds, nworlds) == -1)
+			errx(1, "%s: world files not loaded, not saved",
+			    snapshot);
+		if (snapshot_save() == -1)
+			errx(1, "%s: cannot create world snapshot", snapshot);
+	} else if (store != NULL && access(store, F_OK) == 0) {
+		if (store_open(store) == -1)
+			errx(1, "%s: cannot open world store", store);
+	} else if (store != NULL) {
+		if (store_open(store) == -1)
+			errx(1, "%s: cannot create world store", store);
+		if (loader_load(worlds, nworlds) == -1)
+			errx(1, "%s: world files not loaded, not saved",
+			    store);
+		if (store_save() == -1)
+			errx(1, "%s: cannot create world store", store);
+	} else
+		loader_load(worlds, nworlds);
+	free(worlds);
+
+	/*
+	 * Commands are not run as they are read but a round at a time,
+	 * with input from everyone read in between.
+	 */
+	for (;;) {
+		if (event_dispatch(ev, sched_timeout()) == -1)
 			err(1, "event_dispatch");
+		sched_run();
+		store_evict();
+	}
 
 	evsrc_free(fdsrc);
 	evsrc_free(timersrc);
@@ -0,0 +1,285 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "utf8.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const uint8_t ctab[256] = {
+	0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02,	/* 00 */
+	0x02, 0x03, 0x03, 0x03, 0x03, 0x03, 0x02, 0x02,	/* 08 */
+	0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02,	/* 10 */
+	0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02,	/* 18 */
+	0x01, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	/* 20 */
+	0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x04, 0x00,	/* 28 */
+	0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,	/* 30 */
+	0x20, 0x20, 0x08, 0x08, 0x00, 0x00, 0x00, 0x04,	/* 38 */
+	0x00, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,	/* 40 */
+	0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,	/* 48 */
+	0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,	/* 50 */
+	0x90, 0x90, 0x90, 0x00, 0x00, 0x00, 0x00, 0x00,	/* 58 */
+	0x00, 0x50, 0x50, 0x50, 0x50, 0x50, 0x50, 0x50,	/* 60 */
+	0x50, 0x50, 0x50, 0x50, 0x50, 0x50, 0x50, 0x50,	/* 68 */
+	0x50, 0x50, 0x50, 0x50, 0x50, 0x50, 0x50, 0x50,	/* 70 */
+	0x50, 0x50, 0x50, 0x00, 0x00, 0x00, 0x00, 0x02,	/* 78 */
+};
+
+/*
+ * Display widths other than one column: combining marks and other
+ * zero width characters, and East Asian wide characters.
+ */
+static const struct {
+	uint32_t			 lo;
+	uint32_t			 hi;
+	int				 width;
+} widths[] = {
+	{ 0x0300, 0x036f, 0 },
+	{ 0x0483, 0x0489, 0 },
+	{ 0x0591, 0x05bd, 0 },
+	{ 0x0610, 0x061a, 0 },
+	{ 0x064b, 0x065f, 0 },
+	{ 0x0670, 0x0670, 0 },
+	{ 0x06d6, 0x06dc, 0 },
+	{ 0x06df, 0x06e4, 0 },
+	{ 0x0e31, 0x0e31, 0 },
+	{ 0x0e34, 0x0e3a, 0 },
+	{ 0x0e47, 0x0e4e, 0 },
+	{ 0x1100, 0x115f, 2 },
+	{ 0x1ab0, 0x1aff, 0 },
+	{ 0x1dc0, 0x1dff, 0 },
+	{ 0x200b, 0x200f, 0 },
+	{ 0x20d0, 0x20ff, 0 },
+	{ 0x2e80, 0x303e, 2 },
+	{ 0x3041, 0x33ff, 2 },
+	{ 0x3400, 0x4dbf, 2 },
+	{ 0x4e00, 0x9fff, 2 },
+	{ 0xa000, 0xa4cf, 2 },
+	{ 0xac00, 0xd7a3, 2 },
+	{ 0xf900, 0xfaff, 2 },
+	{ 0xfe00, 0xfe0f, 0 },
+	{ 0xfe20, 0xfe2f, 0 },
+	{ 0xfe30, 0xfe4f, 2 },
+	{ 0xff00, 0xff60, 2 },
+	{ 0xffe0, 0xffe6, 2 },
+	{ 0x1f300, 0x1f64f, 2 },
+	{ 0x1f900, 0x1f9ff, 2 },
+	{ 0x20000, 0x2fffd, 2 },
+	{ 0x30000, 0x3fffd, 2 },
+};
+
+#define NWIDTHS		(sizeof(widths) / sizeof(widths[0]))
+
+/*
+ * Decodes the character at 's', of at most 'len' bytes. Returns its
+ * length, or 0 if it is not well-formed UTF-8: overlong forms,
+ * surrogates and code points above U+10FFFF are refused.
+ */
+size_t
+utf8_decode(const char *s, size_t len, uint32_t *cp)
+{
+	const unsigned char		*u = (const unsigned char *) s;
+	uint32_t			 c, min;
+	size_t				 n, i;
+
+	if (len == 0)
+		return 0;
+	if (u[0] < 0x80) {
+		*cp = u[0];
+		return 1;
+	}
+
+	if (u[0] >= 0xc2 && u[0] <= 0xdf) {
+		n = 2;
+		c = u[0] & 0x1f;
+		min = 0x80;
+	} else if (u[0] >= 0xe0 && u[0] <= 0xef) {
+		n = 3;
+		c = u[0] & 0x0f;
+		min = 0x800;
+	} else if (u[0] >= 0xf0 && u[0] <= 0xf4) {
+		n = 4;
+		c = u[0] & 0x07;
+		min = 0x10000;
+	} else
+		return 0;
+
+	if (len < n)
+		return 0;
+	for (i = 1; i < n; i++) {
+		if ((u[i] & 0xc0) != 0x80)
+			return 0;
+		c = (c << 6) | (u[i] & 0x3f);
+	}
+	if (c < min || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff))
+		return 0;
+
+	*cp = c;
+	return n;
+}
+
+/*
+ * Writes 'cp' to 'out', which must have room for four bytes. Returns
+ * the length.
+ */
+size_t
+utf8_encode(uint32_t cp, char *out)
+{
+	if (cp < 0x80) {
+		out[0] = cp;
+		return 1;
+	} else if (cp < 0x800) {
+		out[0] = 0xc0 | (cp >> 6);
+		out[1] = 0x80 | (cp & 0x3f);
+		return 2;
+	} else if (cp < 0x10000) {
+		out[0] = 0xe0 | (cp >> 12);
+		out[1] = 0x80 | ((cp >> 6) & 0x3f);
+		out[2] = 0x80 | (cp & 0x3f);
+		return 3;
+	}
+	out[0] = 0xf0 | (cp >> 18);
+	out[1] = 0x80 | ((cp >> 12) & 0x3f);
+	out[2] = 0x80 | ((cp >> 6) & 0x3f);
+	out[3] = 0x80 | (cp & 0x3f);
+	return 4;
+}
+
+/*
+ * Number of leading bytes of 's' that are printable ASCII, checked 16
+ * at a time where possible.
+ */
+size_t
+utf8_printable_run(const char *s, size_t len)
+{
+	size_t				 i;
+
+	i = 0;
+#ifdef __SSE2__
+	for (; i + 16 <= len; i += 16) {
+		__m128i			 v, m;
+		unsigned		 mask;
+
+		/* Signed: bytes from 0x80 up compare below ' ' too */
+		v = _mm_loadu_si128((const __m128i *) (s + i));
+		m = _mm_or_si128(_mm_cmplt_epi8(v, _mm_set1_epi8(' ')),
+		    _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7f)));
+		if ((mask = _mm_movemask_epi8(m)) != 0)
+			return i + __builtin_ctz(mask);
+	}
+#endif
+	for (; i < len; i++)
+		if ((unsigned char) s[i] >= 0x80 || CT(s[i], CT_CNTRL))
+			break;
+
+	return i;
+}
+
+int
+utf8_width(uint32_t cp)
+{
+	size_t				 lo, hi, mid;
+
+	if (cp < widths[0].lo)
+		return 1;
+
+	lo = 0;
+	hi = NWIDTHS;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (cp < widths[mid].lo)
+			hi = mid;
+		else if (cp > widths[mid].hi)
+			lo = mid + 1;
+		else
+			return widths[mid].width;
+	}
+
+	return 1;
+}
+
+/*
+ * Display columns taken by 'len' bytes of 's'. A byte that does not
+ * start a well-formed character counts as one column.
+ */
+size_t
+utf8_columns(const char *s, size_t len)
+{
+	uint32_t			 cp;
+	size_t				 i, n, cols;
+
+	for (i = 0; i < len && (unsigned char) s[i] < 0x80; i++)
+		;
+	if (i == len)
+		return len;
+
+	for (cols = i; i < len; i += n) {
+		if ((unsigned char) s[i] < 0x80) {
+			cols++;
+			n = 1;
+		} else if ((n = utf8_decode(s + i, len - i, &cp)) == 0) {
+			cols++;
+			n = 1;
+		} else
+			cols += utf8_width(cp);
+	}
+
+	return cols;
+}
+
+/*
+ * Upper case of 'cp' for the scripts that have case and are common in
+ * play: Latin, Greek, Cyrillic and Armenian.
+ */
+uint32_t
+utf8_toupper(uint32_t cp)
+{
+	if (cp < 0x80)
+		return CT_TOUPPER(cp);
+	if (cp >= 0xe0 && cp <= 0xfe && cp != 0xf7)
+		return cp - 0x20;
+	if (cp == 0xff)
+		return 0x178;
+	if ((cp >= 0x100 && cp <= 0x137) || (cp >= 0x14a && cp <= 0x177))
+		return cp & 1 ? cp - 1 : cp;
+	if ((cp >= 0x139 && cp <= 0x148) || (cp >= 0x179 && cp <= 0x17e))
+		return cp & 1 ? cp : cp - 1;
+	if (cp == 0x3c2)
+		return 0x3a3;
+	if ((cp >= 0x3b1 && cp <= 0x3c1) || (cp >= 0x3c3 && cp <= 0x3cb))
+		return cp - 0x20;
+	if (cp == 0x3ac)
+		return 0x386;
+	if (cp >= 0x3ad && cp <= 0x3af)
+		return cp - 0x25;
+	if (cp == 0x3cc)
+		return 0x38c;
+	if (cp == 0x3cd || cp == 0x3ce)
+		return cp - 0x3f;
+	if (cp >= 0x430 && cp <= 0x44f)
+		return cp - 0x20;
+	if (cp >= 0x450 && cp <= 0x45f)
+		return cp - 0x50;
+	if (cp >= 0x561 && cp <= 0x586)
+		return cp - 0x30;
+	if (cp >= 0xff41 && cp <= 0xff5a)
+		return cp - 0x20;
+
+	return cp;
+}
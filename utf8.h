@@ -0,0 +1,65 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Character classes of bytes, in place of <ctype.h>. Only ASCII is
+ * classified; bytes of multibyte characters have no class, so they
+ * are always part of a word.
+ */
+#define CT_SPACE	0x01
+#define CT_CNTRL	0x02
+#define CT_SENT		0x04	/* Ends a sentence */
+#define CT_PUNCT	0x08	/* Other punctuation that ends a word */
+#define CT_ALPHA	0x10
+#define CT_DIGIT	0x20
+#define CT_LOWER	0x40
+#define CT_UPPER	0x80
+
+extern const uint8_t			 ctab[256];
+
+#define CT(_c, _m)		(ctab[(unsigned char) (_c)] & (_m))
+#define CT_TOUPPER(_c) \
+	(CT((_c), CT_LOWER) ? (_c) - 'a' + 'A' : (_c))
+#define CT_TOLOWER(_c) \
+	(CT((_c), CT_UPPER) ? (_c) - 'A' + 'a' : (_c))
+
+size_t					 utf8_decode(
+					    const char *,
+					    size_t,
+					    uint32_t *);
+size_t					 utf8_encode(
+					    uint32_t,
+					    char *);
+size_t					 utf8_printable_run(
+					    const char *,
+					    size_t);
+int					 utf8_width(
+					    uint32_t);
+size_t					 utf8_columns(
+					    const char *,
+					    size_t);
+uint32_t				 utf8_toupper(
+					    uint32_t);
+
+#endif